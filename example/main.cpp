@@ -27,9 +27,12 @@ int main(int /*argc*/, char */*argv*/[])
     Transform w2o;
 
     uint32_t maxDepth = 3;
-    Bounds2i pixelRange{Point2i(0, 0), Point2i(view_cam->getFilm().height, view_cam->getFilm().width)};
-    Sampler sampler;
-    WhittedIntegrator integrator(maxDepth, pixelRange, sampler);
+    Bounds2i pixelRange{Point2i(0, 0), Point2i(view_cam->getFilm().width, view_cam->getFilm().height)};
+    const RenderOptions &options = mScene->getRenderOptions();
+    std::unique_ptr<Sampler> sampler = createSampler(options.samplerType,
+                                                     options.samplesPerPixel,
+                                                     options.seed);
+    WhittedIntegrator integrator(maxDepth, pixelRange, *sampler);
     integrator.render(*mScene);
     //progBar.complete();
     endT = clock();
@@ -0,0 +1,73 @@
+#include "Accel/AccelCache.h"
+#include "Math/RNG.h"
+
+namespace Kaguya
+{
+
+namespace AccelCache
+{
+
+uint64_t hashPrimitives(const std::vector<Geometry*> &prims,
+						const std::vector<uint64_t> &buildParams)
+{
+	auto floatBits = [](Float val)
+	{
+		uint64_t bits = 0;
+		std::memcpy(&bits, &val, sizeof(Float));
+		return bits;
+	};
+	uint64_t hash = hashValues(prims.size(), sVersion);
+	for (auto param : buildParams)
+	{
+		hash = hashValues(hash, param);
+	}
+	for (auto prim : prims)
+	{
+		const Bounds3f &primBound = prim->getWorldBounding();
+		hash = hashValues(hash, floatBits(primBound.pMin.x), floatBits(primBound.pMin.y));
+		hash = hashValues(hash, floatBits(primBound.pMin.z), floatBits(primBound.pMax.x));
+		hash = hashValues(hash, floatBits(primBound.pMax.y), floatBits(primBound.pMax.z));
+	}
+	return hash;
+}
+
+bool write(const std::string &filename,
+		   AccelType accelType, uint64_t contentHash,
+		   const Bounds3f &bounds,
+		   const void* nodes, size_t nodeSize, size_t nodeCount,
+		   const SharedBuffer<int> &indices)
+{
+	AccelCacheHeader header = {};
+	std::memcpy(header.magic, "KGYACCEL", 8);
+	header.version = sVersion;
+	header.accelType = static_cast<uint32_t>(accelType);
+	header.contentHash = contentHash;
+	header.floatSize = sizeof(Float);
+	header.nodeSize = static_cast<uint32_t>(nodeSize);
+	header.nodeCount = nodeCount;
+	header.indexCount = indices.size();
+
+	// Write aside and rename, readers never see a partial file
+	std::string tmpFilename = filename + ".tmp";
+	std::FILE* fp = std::fopen(tmpFilename.c_str(), "wb");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	bool isWritten = std::fwrite(&header, sizeof(AccelCacheHeader), 1, fp) == 1
+		&& std::fwrite(nodes, nodeSize, nodeCount, fp) == nodeCount
+		&& std::fwrite(indices.data(), sizeof(int), indices.size(), fp) == indices.size()
+		&& std::fwrite(&bounds, sizeof(Bounds3f), 1, fp) == 1;
+	isWritten = (std::fclose(fp) == 0) && isWritten;
+	if (!isWritten)
+	{
+		std::remove(tmpFilename.c_str());
+		return false;
+	}
+	std::remove(filename.c_str());
+	return std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+}
+
+}
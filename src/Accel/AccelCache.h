@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Accel/Bounds.h"
+#include "Geometry/Geometry.h"
+#include "Core/MappedFile.h"
+
+namespace Kaguya
+{
+
+// Binary cache of in-house acceleration structures.
+// Layout: AccelCacheHeader, node array, primitive index array.
+// The node array starts 64 bytes in, so nodes and indices are used in place
+// from the mapped file.
+namespace AccelCache
+{
+
+// Bump whenever a node layout or a builder changes
+static const uint32_t sVersion = 1;
+
+enum class AccelType : uint32_t
+{
+	KD_TREE = 1,
+	BVH4 = 2
+};
+
+struct AccelCacheHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t accelType;
+	uint64_t contentHash;
+	uint32_t floatSize;
+	uint32_t nodeSize;
+	uint64_t nodeCount;
+	uint64_t indexCount;
+	uint8_t  padding[16];
+};
+static_assert(sizeof(AccelCacheHeader) == 64, "Accel cache header is 64 bytes");
+
+// Trees only depend on primitive bounds and build settings
+uint64_t hashPrimitives(const std::vector<Geometry*> &prims,
+						const std::vector<uint64_t> &buildParams);
+
+bool write(const std::string &filename,
+		   AccelType accelType, uint64_t contentHash,
+		   const Bounds3f &bounds,
+		   const void* nodes, size_t nodeSize, size_t nodeCount,
+		   const SharedBuffer<int> &indices);
+
+// Returns false on a missing, stale or foreign file
+template <typename Node>
+bool read(const std::string &filename,
+		  AccelType accelType, uint64_t contentHash,
+		  Bounds3f &bounds,
+		  SharedBuffer<Node> &nodes,
+		  SharedBuffer<int> &indices)
+{
+	auto file = std::make_shared<const MappedFile>(filename);
+	if (!file->isValid() || file->size() < sizeof(AccelCacheHeader) + sizeof(Bounds3f))
+	{
+		return false;
+	}
+	AccelCacheHeader header;
+	std::memcpy(&header, file->data(), sizeof(AccelCacheHeader));
+	if (std::memcmp(header.magic, "KGYACCEL", 8) != 0
+		|| header.version != sVersion
+		|| header.accelType != static_cast<uint32_t>(accelType)
+		|| header.contentHash != contentHash
+		|| header.floatSize != sizeof(Float)
+		|| header.nodeSize != sizeof(Node)
+		|| file->size() != sizeof(AccelCacheHeader) + header.nodeCount * sizeof(Node)
+						  + header.indexCount * sizeof(int) + sizeof(Bounds3f))
+	{
+		return false;
+	}
+	const char* ptr = file->data() + sizeof(AccelCacheHeader);
+	nodes = SharedBuffer<Node>(file, reinterpret_cast<const Node*>(ptr), header.nodeCount);
+	ptr += header.nodeCount * sizeof(Node);
+	indices = SharedBuffer<int>(file, reinterpret_cast<const int*>(ptr), header.indexCount);
+	ptr += header.indexCount * sizeof(int);
+	std::memcpy(&bounds, ptr, sizeof(Bounds3f));
+	return true;
+}
+
+}
+
+}
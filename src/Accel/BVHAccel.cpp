@@ -0,0 +1,433 @@
+#include "Accel/BVHAccel.h"
+#include "Accel/AccelCache.h"
+#include "Tracer/Ray.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace Kaguya
+{
+
+BVHAccel::BVHAccel(const std::vector<Geometry*> &prims, int mp,
+				   const std::string &cacheFile)
+	: maxPrims(std::max(mp, 1))
+	, primitives(prims)
+{
+	if (!cacheFile.empty() && loadCache(cacheFile))
+	{
+		return;
+	}
+	build();
+	if (!cacheFile.empty() && !saveCache(cacheFile))
+	{
+		std::cout << "Failed to write BVH cache " << cacheFile << std::endl;
+	}
+}
+
+BVHAccel::~BVHAccel()
+{
+}
+
+uint64_t BVHAccel::contentHash() const
+{
+	return AccelCache::hashPrimitives(primitives,
+									  { static_cast<uint64_t>(maxPrims),
+										static_cast<uint64_t>(sBinCount) });
+}
+
+bool BVHAccel::saveCache(const std::string &filename) const
+{
+	return AccelCache::write(filename, AccelCache::AccelType::BVH4, contentHash(),
+							 treeBound, nodes.data(), sizeof(BVHNode4), nodes.size(),
+							 orderedPrims);
+}
+
+bool BVHAccel::loadCache(const std::string &filename)
+{
+	return AccelCache::read(filename, AccelCache::AccelType::BVH4, contentHash(),
+							treeBound, nodes, orderedPrims);
+}
+
+void BVHAccel::build()
+{
+	int np = primitives.size();
+	if (np == 0)
+	{
+		return;
+	}
+	std::vector<BuildPrim> buildPrims(np);
+	for (int i = 0; i < np; ++i)
+	{
+		const Bounds3f &primBound = primitives[i]->getWorldBounding();
+		buildPrims[i].primIndex = i;
+		buildPrims[i].bounds = primBound;
+		buildPrims[i].centroid = primBound.pMin + (primBound.pMax - primBound.pMin) * 0.5;
+	}
+
+	std::vector<BuildNode> buildNodes;
+	buildNodes.reserve(np * 2);
+	buildRecursive(buildNodes, buildPrims, 0, np, 0);
+	treeBound = buildNodes[0].bounds;
+
+	std::vector<int> leafPrims(np);
+	for (int i = 0; i < np; ++i)
+	{
+		leafPrims[i] = buildPrims[i].primIndex;
+	}
+	orderedPrims = std::move(leafPrims);
+	nodes = SharedBuffer<BVHNode4>();
+	nodes.vector().reserve(buildNodes.size() / 2 + 1);
+	flatten(buildNodes, 0);
+}
+
+int BVHAccel::buildRecursive(std::vector<BuildNode> &buildNodes,
+							 std::vector<BuildPrim> &buildPrims,
+							 int begin, int end, int depth)
+{
+	int nodeNum = buildNodes.size();
+	buildNodes.emplace_back();
+
+	Bounds3f bound = buildPrims[begin].bounds;
+	Bounds3f centroidBound(buildPrims[begin].centroid);
+	for (int i = begin + 1; i < end; ++i)
+	{
+		bound.Union(buildPrims[i].bounds);
+		centroidBound.Union(buildPrims[i].centroid);
+	}
+	buildNodes[nodeNum].bounds = bound;
+	buildNodes[nodeNum].children[0] = buildNodes[nodeNum].children[1] = -1;
+	buildNodes[nodeNum].primOffset = begin;
+	buildNodes[nodeNum].primCount = end - begin;
+
+	int np = end - begin;
+	int axis = centroidBound.maxExtent();
+	Float extent = centroidBound.pMax[axis] - centroidBound.pMin[axis];
+	// Coincident centroids can't be split, and every binary level may
+	// cost a wide level in traversal
+	if (np <= 1 || extent <= 0 || depth >= sMaxDepth)
+	{
+		return nodeNum;
+	}
+
+	// Bin centroids along the longest axis and sweep the bin boundaries
+	struct Bin
+	{
+		int      count = 0;
+		Bounds3f bounds;
+	};
+	Bin bins[sBinCount];
+	Float binScale = sBinCount / extent;
+	auto binIndex = [&](const BuildPrim &prim)
+	{
+		return clamp(static_cast<int>((prim.centroid[axis] - centroidBound.pMin[axis]) * binScale),
+					 0, sBinCount - 1);
+	};
+	for (int i = begin; i < end; ++i)
+	{
+		Bin &bin = bins[binIndex(buildPrims[i])];
+		bin.bounds = bin.count == 0 ? buildPrims[i].bounds : Union(bin.bounds, buildPrims[i].bounds);
+		++bin.count;
+	}
+
+	// Cost of a split after bin i, relative to one primitive test
+	Float costs[sBinCount - 1];
+	{
+		Bounds3f belowBound;
+		int nBelow = 0;
+		for (int i = 0; i < sBinCount - 1; ++i)
+		{
+			if (bins[i].count > 0)
+			{
+				belowBound = nBelow == 0 ? bins[i].bounds : Union(belowBound, bins[i].bounds);
+				nBelow += bins[i].count;
+			}
+			costs[i] = nBelow * (nBelow > 0 ? belowBound.surfaceArea() : 0);
+		}
+		Bounds3f aboveBound;
+		int nAbove = 0;
+		for (int i = sBinCount - 1; i > 0; --i)
+		{
+			if (bins[i].count > 0)
+			{
+				aboveBound = nAbove == 0 ? bins[i].bounds : Union(aboveBound, bins[i].bounds);
+				nAbove += bins[i].count;
+			}
+			costs[i - 1] += nAbove * (nAbove > 0 ? aboveBound.surfaceArea() : 0);
+		}
+	}
+	int bestSplit = 0;
+	for (int i = 1; i < sBinCount - 1; ++i)
+	{
+		if (costs[i] < costs[bestSplit])
+		{
+			bestSplit = i;
+		}
+	}
+	// Traversal step costs 1/8 of a primitive test
+	Float splitCost = 0.125 + costs[bestSplit] / bound.surfaceArea();
+	if (np <= maxPrims && splitCost >= np)
+	{
+		return nodeNum;
+	}
+
+	BuildPrim* mid = std::partition(
+		&buildPrims[begin], &buildPrims[end - 1] + 1,
+		[&](const BuildPrim &prim) { return binIndex(prim) <= bestSplit; });
+	int midIndex = static_cast<int>(mid - &buildPrims[0]);
+	if (midIndex == begin || midIndex == end)
+	{
+		return nodeNum;
+	}
+
+	int below = buildRecursive(buildNodes, buildPrims, begin, midIndex, depth + 1);
+	int above = buildRecursive(buildNodes, buildPrims, midIndex, end, depth + 1);
+	buildNodes[nodeNum].children[0] = below;
+	buildNodes[nodeNum].children[1] = above;
+	buildNodes[nodeNum].primCount = 0;
+	return nodeNum;
+}
+
+void BVHAccel::setChild(BVHNode4 &node, int slot, const BuildNode &buildNode) const
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		node.bounds[0][axis][slot] = static_cast<float>(buildNode.bounds.pMin[axis]);
+		node.bounds[1][axis][slot] = static_cast<float>(buildNode.bounds.pMax[axis]);
+	}
+	node.child[slot] = buildNode.primOffset;
+	node.primCount[slot] = buildNode.primCount;
+}
+
+int BVHAccel::flatten(const std::vector<BuildNode> &buildNodes, int buildIndex)
+{
+	// Open the largest inner children until the node holds 4 of them
+	int slots[4] = { buildIndex, -1, -1, -1 };
+	int slotCount = 1;
+	while (slotCount < 4)
+	{
+		int largest = -1;
+		Float largestArea = -1;
+		for (int i = 0; i < slotCount; ++i)
+		{
+			const BuildNode &candidate = buildNodes[slots[i]];
+			if (candidate.primCount == 0 && candidate.bounds.surfaceArea() > largestArea)
+			{
+				largest = i;
+				largestArea = candidate.bounds.surfaceArea();
+			}
+		}
+		if (largest == -1)
+		{
+			break;
+		}
+		const BuildNode &opened = buildNodes[slots[largest]];
+		slots[largest] = opened.children[0];
+		slots[slotCount++] = opened.children[1];
+	}
+
+	std::vector<BVHNode4> &flatNodes = nodes.vector();
+	int nodeNum = flatNodes.size();
+	flatNodes.emplace_back();
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			flatNodes[nodeNum].bounds[0][axis][i] = std::numeric_limits<float>::infinity();
+			flatNodes[nodeNum].bounds[1][axis][i] = -std::numeric_limits<float>::infinity();
+		}
+		flatNodes[nodeNum].child[i] = -1;
+		flatNodes[nodeNum].primCount[i] = 0;
+	}
+	for (int i = 0; i < slotCount; ++i)
+	{
+		const BuildNode &buildNode = buildNodes[slots[i]];
+		setChild(flatNodes[nodeNum], i, buildNode);
+		if (buildNode.primCount == 0)
+		{
+			int childNum = flatten(buildNodes, slots[i]);
+			flatNodes[nodeNum].child[i] = childNum;
+		}
+	}
+	return nodeNum;
+}
+
+int BVHAccel::intersectChildren(const BVHNode4 &node,
+								const float org[3], const float invDir[3],
+								const int dirIsNeg[3],
+								float tMin, float tMax, float tNear[4]) const
+{
+#ifdef __SSE__
+	__m128 t0 = _mm_set1_ps(tMin);
+	__m128 t1 = _mm_set1_ps(tMax);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		__m128 o = _mm_set1_ps(org[axis]);
+		__m128 inv = _mm_set1_ps(invDir[axis]);
+		__m128 slabNear = _mm_mul_ps(_mm_sub_ps(
+			_mm_load_ps(node.bounds[dirIsNeg[axis]][axis]), o), inv);
+		__m128 slabFar = _mm_mul_ps(_mm_sub_ps(
+			_mm_load_ps(node.bounds[1 - dirIsNeg[axis]][axis]), o), inv);
+		// NaN slabs (0 * inf) leave t0 and t1 unchanged
+		t0 = _mm_max_ps(slabNear, t0);
+		t1 = _mm_min_ps(slabFar, t1);
+	}
+	_mm_storeu_ps(tNear, t0);
+	return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		float t0 = tMin, t1 = tMax;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float slabNear = (node.bounds[dirIsNeg[axis]][axis][i] - org[axis]) * invDir[axis];
+			float slabFar = (node.bounds[1 - dirIsNeg[axis]][axis][i] - org[axis]) * invDir[axis];
+			t0 = slabNear > t0 ? slabNear : t0;
+			t1 = slabFar < t1 ? slabFar : t1;
+		}
+		tNear[i] = t0;
+		mask |= (t0 <= t1) << i;
+	}
+	return mask;
+#endif
+}
+
+bool BVHAccel::intersect(const Ray &inRay,
+						 Intersection* isec,
+						 Float* tHit, Float* rayEpsilon) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+	// Shrink the ray to the closest hit so far
+	Ray ray(inRay);
+	ray.tMax = std::min(ray.tMax, *tHit);
+
+	float org[3], invDir[3];
+	int dirIsNeg[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		org[axis] = static_cast<float>(ray.o[axis]);
+		invDir[axis] = 1.0f / static_cast<float>(ray.d[axis]);
+		dirIsNeg[axis] = invDir[axis] < 0;
+	}
+
+	int todo[sMaxStackSize];
+	int todoPos = 0;
+	int nodeNum = 0;
+	bool isHit = false;
+	while (true)
+	{
+		const BVHNode4 &node = nodes[nodeNum];
+		float tNear[4];
+		int mask = intersectChildren(node, org, invDir, dirIsNeg,
+									 static_cast<float>(ray.tMin),
+									 static_cast<float>(ray.tMax), tNear);
+		// Inner children go on the stack far to near
+		int innerHits[4];
+		int innerCount = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (!(mask & (1 << i)))
+			{
+				continue;
+			}
+			if (node.primCount[i] == 0)
+			{
+				innerHits[innerCount++] = i;
+				continue;
+			}
+			for (uint32_t j = 0; j < node.primCount[i]; ++j)
+			{
+				int idx = orderedPrims[node.child[i] + j];
+				Intersection primIsec;
+				Float hitDist, rayEp;
+				if (primitives[idx]->intersect(ray, &primIsec, &hitDist, &rayEp)
+					&& hitDist < ray.tMax)
+				{
+					*isec = primIsec;
+					*tHit = hitDist;
+					*rayEpsilon = rayEp;
+					isec->mShape = primitives[idx];
+					ray.tMax = hitDist;
+					isHit = true;
+				}
+			}
+		}
+		std::sort(innerHits, innerHits + innerCount,
+				  [&tNear](int a, int b) { return tNear[a] > tNear[b]; });
+		for (int i = 0; i < innerCount; ++i)
+		{
+			todo[todoPos++] = node.child[innerHits[i]];
+		}
+
+		if (todoPos == 0)
+		{
+			break;
+		}
+		nodeNum = todo[--todoPos];
+	}
+	return isHit;
+}
+
+bool BVHAccel::intersectP(const Ray &inRay) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+	float org[3], invDir[3];
+	int dirIsNeg[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		org[axis] = static_cast<float>(inRay.o[axis]);
+		invDir[axis] = 1.0f / static_cast<float>(inRay.d[axis]);
+		dirIsNeg[axis] = invDir[axis] < 0;
+	}
+
+	int todo[sMaxStackSize];
+	int todoPos = 0;
+	int nodeNum = 0;
+	while (true)
+	{
+		const BVHNode4 &node = nodes[nodeNum];
+		float tNear[4];
+		int mask = intersectChildren(node, org, invDir, dirIsNeg,
+									 static_cast<float>(inRay.tMin),
+									 static_cast<float>(inRay.tMax), tNear);
+		for (int i = 0; i < 4; ++i)
+		{
+			if (!(mask & (1 << i)))
+			{
+				continue;
+			}
+			if (node.primCount[i] == 0)
+			{
+				todo[todoPos++] = node.child[i];
+				continue;
+			}
+			for (uint32_t j = 0; j < node.primCount[i]; ++j)
+			{
+				if (primitives[orderedPrims[node.child[i] + j]]->intersectP(inRay))
+				{
+					return true;
+				}
+			}
+		}
+		if (todoPos == 0)
+		{
+			return false;
+		}
+		nodeNum = todo[--todoPos];
+	}
+}
+
+void BVHAccel::printInfo() const
+{
+	std::cout << "BVH with " << nodes.size() << " 4-wide nodes over "
+		<< primitives.size() << " primitives" << std::endl;
+}
+
+}
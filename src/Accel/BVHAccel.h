@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Accel/Bounds.h"
+#include "Geometry/Geometry.h"
+#include "Geometry/Intersection.h"
+#include "Core/MappedFile.h"
+
+namespace Kaguya
+{
+
+// 4-wide node, child bounds are stored per axis so one SSE slab test
+// covers all children.
+// Inner child: primCount == 0, child is the node index
+// Leaf child: primCount > 0, child is the offset into the ordered primitives
+// Empty slot: primCount == 0, child == -1, inverted bounds never hit
+struct alignas(16) BVHNode4
+{
+	float    bounds[2][3][4];// [min/max][axis][child]
+	int32_t  child[4];
+	uint32_t primCount[4];
+};
+
+// Bounding volume hierarchy built with binned SAH, then collapsed
+// into a 4-wide tree. Does not depend on Embree.
+class BVHAccel
+{
+public:
+	BVHAccel(const std::vector<Geometry*> &prims, int mp = 4,
+			 const std::string &cacheFile = "");
+	~BVHAccel();
+
+	// Any hit along the ray
+	bool intersectP(const Ray &inRay) const;
+	// Closest hit closer than *tHit, traversal does no heap allocation
+	bool intersect(const Ray &inRay,
+				   Intersection* isec,
+				   Float* tHit, Float* rayEpsilon) const;
+
+	const Bounds3f &getBounds() const { return treeBound; }
+
+	// Tree cache keyed by the primitive bounds and the build settings,
+	// see AccelCache
+	bool saveCache(const std::string &filename) const;
+	bool loadCache(const std::string &filename);
+
+	void printInfo() const;
+
+private:
+	struct BuildPrim
+	{
+		int      primIndex;
+		Bounds3f bounds;
+		Point3f  centroid;
+	};
+	struct BuildNode
+	{
+		Bounds3f bounds;
+		int      children[2];// -1 for leaves
+		int      primOffset, primCount;
+	};
+
+	void build();
+	uint64_t contentHash() const;
+	int buildRecursive(std::vector<BuildNode> &buildNodes,
+					   std::vector<BuildPrim> &buildPrims,
+					   int begin, int end, int depth);
+	int flatten(const std::vector<BuildNode> &buildNodes, int buildIndex);
+	void setChild(BVHNode4 &node, int slot, const BuildNode &buildNode) const;
+
+	// Bit i of the result is set when child i is hit in [tMin, tMax]
+	int intersectChildren(const BVHNode4 &node,
+						  const float org[3], const float invDir[3],
+						  const int dirIsNeg[3],
+						  float tMin, float tMax, float tNear[4]) const;
+
+private:
+	// Traversal stack size, each wide level pushes at most 3 nodes
+	static const int sMaxStackSize = 256;
+	// Deeper binary nodes become leaves, so the stack can't overflow
+	static const int sMaxDepth = (sMaxStackSize - 1) / 3;
+	static const int sBinCount = 12;
+
+	int maxPrims;
+	std::vector<Geometry*> primitives;
+	// Primitive indices in leaf order
+	SharedBuffer<int> orderedPrims;
+	SharedBuffer<BVHNode4> nodes;
+	Bounds3f treeBound;
+};
+
+}
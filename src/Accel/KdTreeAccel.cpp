@@ -1,4 +1,6 @@
 #include "Accel/KdTreeAccel.h"
+#include "Accel/AccelCache.h"
+#include "Core/ThreadPool.h"
 
 namespace Kaguya
 {
@@ -6,8 +8,9 @@ namespace Kaguya
 char axisChar[4] = { 'X', 'Y', 'Z', 'L' };
 
 KdTreeAccel::KdTreeAccel(const std::vector<Geometry*> &prims,
-						 int md, int mp, Float eb)
-	: maxDepth(md), maxPrims(mp), emptyBonus(eb)
+						 int md, int mp, Float eb, KdBuildMode mode,
+						 const std::string &cacheFile)
+	: maxDepth(md), maxPrims(mp), emptyBonus(eb), buildMode(mode)
 {
 	int np = prims.size();
 	primitives = prims;
@@ -16,16 +19,70 @@ KdTreeAccel::KdTreeAccel(const std::vector<Geometry*> &prims,
 	{
 		maxDepth = roundToInt(8 + 1.3 * logToInt(static_cast<Float>(np)));
 	}
+	// Each level may push one node on the traversal stack
+	maxDepth = std::min(maxDepth, sMaxToDo - 1);
+	if (!cacheFile.empty() && loadCache(cacheFile))
+	{
+		return;
+	}
+	build();
+	if (!cacheFile.empty() && !saveCache(cacheFile))
+	{
+		std::cout << "Failed to write kd-tree cache " << cacheFile << std::endl;
+	}
+}
+
+uint64_t KdTreeAccel::contentHash() const
+{
+	uint64_t emptyBonusBits = 0;
+	std::memcpy(&emptyBonusBits, &emptyBonus, sizeof(Float));
+	return AccelCache::hashPrimitives(primitives,
+									  { static_cast<uint64_t>(maxDepth),
+										static_cast<uint64_t>(maxPrims),
+										emptyBonusBits,
+										static_cast<uint64_t>(buildMode) });
+}
+
+bool KdTreeAccel::saveCache(const std::string &filename) const
+{
+	return AccelCache::write(filename, AccelCache::AccelType::KD_TREE, contentHash(),
+							 treeBound, nodes.data(), sizeof(KdAccelNode), nodes.size(),
+							 primIndices);
+}
+
+bool KdTreeAccel::loadCache(const std::string &filename)
+{
+	return AccelCache::read(filename, AccelCache::AccelType::KD_TREE, contentHash(),
+							treeBound, nodes, primIndices);
+}
+
+void KdTreeAccel::build()
+{
+	nodes = SharedBuffer<KdAccelNode>();
+	primIndices = SharedBuffer<int>();
+	int np = primitives.size();
 	// If no node in vector, terminate initialization
 	if (np == 0)
 	{
-		root = nullptr;
 		return;
 	}
 	//Initialize bouding box for all primitives in stack
+	treeBound = primitives[0]->getWorldBounding();
+	for (int i = 1; i < np; ++i)
+	{
+		treeBound.Union(primitives[i]->getWorldBounding());
+	}
+	//Create stack to record primitive indices
+	std::vector<int> primNum(np);
 	for (int i = 0; i < np; ++i)
 	{
-		treeBound.Union(prims[i]->getWorldBounding());
+		primNum[i] = i;
+	}
+	if (buildMode == KdBuildMode::BINNED_SAH)
+	{
+		buildBinned(nodes.vector(), primIndices.vector(), treeBound, std::move(primNum), maxDepth);
+		nodes.vector().shrink_to_fit();
+		return;
 	}
 	//Allocate bound edge info
 	BoundEdge* edges[3];
@@ -33,15 +90,9 @@ KdTreeAccel::KdTreeAccel(const std::vector<Geometry*> &prims,
 	{
 		edges[i] = new BoundEdge[np * 2];
 	}
-	//Create stack to record primitive indices
-	std::vector<int> primNum(np);
-	for (int i = 0; i < np; ++i)
-	{
-		primNum[i] = i;
-	}
 	//Start recursively build the tree
-	root = new KdAccelNode;
-	buildTree(root, treeBound, primNum, maxDepth, edges);
+	buildTree(nodes.vector(), primIndices.vector(), treeBound, primNum, maxDepth, edges);
+	nodes.vector().shrink_to_fit();
 
 	//Clean data
 	for (int i = 0; i < 3; ++i)
@@ -51,26 +102,45 @@ KdTreeAccel::KdTreeAccel(const std::vector<Geometry*> &prims,
 	}
 }
 
-void KdTreeAccel::buildTree(KdAccelNode* node,
+Float KdTreeAccel::splitCost(const Bounds3f &bound, int axis, Float split,
+							 int nBelow, int nAbove) const
+{
+	//get other two axes
+	int axis0 = (axis + 1) % 3, axis1 = (axis + 2) % 3;
+	Vector3f bbDiag = bound.pMax - bound.pMin;
+	Float invTotalSA = 1.0 / bound.surfaceArea();
+	Float belowSA = 2 * (bbDiag[axis0] * bbDiag[axis1] +
+		(split - bound.pMin[axis]) *
+						 (bbDiag[axis0] + bbDiag[axis1]));
+	Float aboveSA = 2 * (bbDiag[axis0] * bbDiag[axis1] +
+		(bound.pMax[axis] - split) *
+						 (bbDiag[axis0] + bbDiag[axis1]));
+	Float pBelow = belowSA * invTotalSA;
+	Float pAbove = aboveSA * invTotalSA;
+	Float eb = (nAbove == 0 || nBelow == 0) ? emptyBonus : 0;
+	return (1.0 - eb) * (pBelow * nBelow + pAbove * nAbove);
+}
+
+void KdTreeAccel::buildTree(std::vector<KdAccelNode> &outNodes,
+							std::vector<int> &outPrimIndices,
 							const Bounds3f &bound,
-							std::vector<int> &prims,
-							int depth, BoundEdge* edges[3])
+							const std::vector<int> &prims,
+							int depth, BoundEdge* edges[3]) const
 {
-	node->bbox = bound;
+	// Nodes are appended in depth first order
+	int nodeNum = outNodes.size();
+	outNodes.emplace_back();
 	int np = prims.size();
 	//If not enough primitives or reach max depth of a tree
 	//Create a leaf node
 	if (np <= maxPrims || depth == 0)
 	{
-		node->initLeaf(prims);
+		outNodes[nodeNum].initLeaf(prims, outPrimIndices);
 		return;
 	}
 	//Interior node parameters
 	int bestAxis = -1, bestOffest = -1;//Split axis and split index*2
 	Float bestCost = INFINITY;
-	Float totalSA = bound.surfaceArea();
-	Float invTotalSA = 1.0 / totalSA;
-	Vector3f bbDiag = bound.pMax - bound.pMin;
 
 	//choose max extension axis of bounding box
 	int axis = bound.maxExtent();//axis is the longest edge of bounding box
@@ -100,18 +170,7 @@ RETRY_SPLIT:
 		if (edget > bound.pMin[axis] && edget < bound.pMax[axis])
 		{
 			//Compute cost for split at ith edge
-			//get other two axes
-			int axis0 = (axis + 1) % 3, axis1 = (axis + 2) % 3;
-			Float belowSA = 2 * (bbDiag[axis0] * bbDiag[axis1] +
-				(edget - bound.pMin[axis]) *
-								 (bbDiag[axis0] + bbDiag[axis1]));
-			Float aboveSA = 2 * (bbDiag[axis0] * bbDiag[axis1] +
-				(bound.pMax[axis] - edget) *
-								 (bbDiag[axis0] + bbDiag[axis1]));
-			Float pBelow = belowSA * invTotalSA;
-			Float pAbove = aboveSA * invTotalSA;
-			Float eb = (nAbove == 0 || nBelow == 0) ? emptyBonus : 0;
-			Float cost = (1.0 - eb) * (pBelow * nBelow + pAbove * nAbove);
+			Float cost = splitCost(bound, axis, edget, nBelow, nAbove);
 
 			//std::cout << "cost at i:" << i << " is " << cost << std::endl;
 			if (cost < bestCost)
@@ -136,7 +195,7 @@ RETRY_SPLIT:
 	//if no good split, init as leaf
 	if (bestAxis == -1)
 	{
-		node->initLeaf(prims);
+		outNodes[nodeNum].initLeaf(prims, outPrimIndices);
 		return;
 	}
 
@@ -160,7 +219,6 @@ RETRY_SPLIT:
 		}
 	}
 	Float tsplit = edges[bestAxis][bestOffest].t;
-	node->initInterior(bestAxis, tsplit);
 
 	/*for (int i = 0; i < 2 * np; ++i)
 	{
@@ -183,109 +241,250 @@ RETRY_SPLIT:
 	Bounds3f belowBound = bound, aboveBound = bound;
 	belowBound.pMax[bestAxis] = aboveBound.pMin[bestAxis] = tsplit;
 
-	buildTree(node->belowNode, belowBound, primsBelow, depth - 1, edges);
-	buildTree(node->aboveNode, aboveBound, primsAbove, depth - 1, edges);
-
+	// Below child follows its parent, above child goes after the below subtree
+	buildTree(outNodes, outPrimIndices, belowBound, primsBelow, depth - 1, edges);
+	int aboveChild = outNodes.size();
+	outNodes[nodeNum].initInterior(bestAxis, aboveChild, tsplit);
+	buildTree(outNodes, outPrimIndices, aboveBound, primsAbove, depth - 1, edges);
 }
-bool KdTreeAccel::intersect(const Ray &inRay,
-							Intersection* isec,
-							Float* tHit, Float* rayEpsilon) const
+
+void KdTreeAccel::buildBinned(std::vector<KdAccelNode> &outNodes,
+							  std::vector<int> &outPrimIndices,
+							  const Bounds3f &bound,
+							  std::vector<int> prims,
+							  int depth) const
 {
-	return intersect(inRay, isec, root, tHit, rayEpsilon);
+	int np = prims.size();
+	if (np <= maxPrims || depth == 0)
+	{
+		outNodes.emplace_back();
+		outNodes.back().initLeaf(prims, outPrimIndices);
+		return;
+	}
+	// Small nodes afford the exact sweep
+	if (np <= sExactSweepCount)
+	{
+		std::vector<BoundEdge> edgeBuffer(np * 6);
+		BoundEdge* edges[3] = { &edgeBuffer[0], &edgeBuffer[np * 2], &edgeBuffer[np * 4] };
+		buildTree(outNodes, outPrimIndices, bound, prims, depth, edges);
+		return;
+	}
+
+	// Count primitive starts and ends in equal bins along each axis,
+	// candidate splits are the bin boundaries
+	int bestAxis = -1;
+	Float bestSplit = 0;
+	Float bestCost = INFINITY;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		Float extent = bound.pMax[axis] - bound.pMin[axis];
+		if (extent <= 0)
+		{
+			continue;
+		}
+		Float binScale = sBinCount / extent;
+		auto binIndex = [&](Float t)
+		{
+			return clamp(static_cast<int>((t - bound.pMin[axis]) * binScale), 0, sBinCount - 1);
+		};
+		int startCount[sBinCount] = {}, endCount[sBinCount] = {};
+		for (int prmIdx : prims)
+		{
+			const Bounds3f &tmpBox = primitives[prmIdx]->getWorldBounding();
+			++startCount[binIndex(tmpBox.pMin[axis])];
+			++endCount[binIndex(tmpBox.pMax[axis])];
+		}
+		int nBelow(0), nAbove(np);
+		for (int i = 1; i < sBinCount; ++i)
+		{
+			nBelow += startCount[i - 1];
+			nAbove -= endCount[i - 1];
+			Float split = bound.pMin[axis] + i / binScale;
+			Float cost = splitCost(bound, axis, split, nBelow, nAbove);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	std::vector<int> primsBelow;
+	std::vector<int> primsAbove;
+	if (bestAxis != -1)
+	{
+		// Primitives lying in the split plane go to both sides
+		for (int prmIdx : prims)
+		{
+			const Bounds3f &tmpBox = primitives[prmIdx]->getWorldBounding();
+			if (tmpBox.pMin[bestAxis] < bestSplit || tmpBox.pMax[bestAxis] <= bestSplit)
+			{
+				primsBelow.push_back(prmIdx);
+			}
+			if (tmpBox.pMax[bestAxis] > bestSplit || tmpBox.pMin[bestAxis] >= bestSplit)
+			{
+				primsAbove.push_back(prmIdx);
+			}
+		}
+	}
+	//if no split separates anything, init as leaf
+	if (bestAxis == -1
+		|| (static_cast<int>(primsBelow.size()) == np
+			&& static_cast<int>(primsAbove.size()) == np))
+	{
+		outNodes.emplace_back();
+		outNodes.back().initLeaf(prims, outPrimIndices);
+		return;
+	}
+	std::vector<int>().swap(prims);
+
+	Bounds3f belowBound = bound, aboveBound = bound;
+	belowBound.pMax[bestAxis] = aboveBound.pMin[bestAxis] = bestSplit;
+
+	int nodeNum = outNodes.size();
+	outNodes.emplace_back();
+	if (np < sParallelBuildCount)
+	{
+		buildBinned(outNodes, outPrimIndices, belowBound, std::move(primsBelow), depth - 1);
+		int aboveChild = outNodes.size();
+		outNodes[nodeNum].initInterior(bestAxis, aboveChild, bestSplit);
+		buildBinned(outNodes, outPrimIndices, aboveBound, std::move(primsAbove), depth - 1);
+		return;
+	}
+
+	// Build the above subtree in its own arrays on another thread,
+	// then append it behind the below subtree
+	std::vector<KdAccelNode> aboveNodes;
+	std::vector<int> abovePrimIndices;
+	ThreadPool &pool = ThreadPool::global();
+	TaskGroup group;
+	pool.run(group, [&]()
+	{
+		buildBinned(aboveNodes, abovePrimIndices, aboveBound, std::move(primsAbove), depth - 1);
+	});
+	buildBinned(outNodes, outPrimIndices, belowBound, std::move(primsBelow), depth - 1);
+	pool.wait(group);
+
+	int aboveChild = outNodes.size();
+	int primIndicesOffset = outPrimIndices.size();
+	outNodes[nodeNum].initInterior(bestAxis, aboveChild, bestSplit);
+	for (auto &node : aboveNodes)
+	{
+		node.rebase(aboveChild, primIndicesOffset);
+	}
+	outNodes.insert(outNodes.end(), aboveNodes.begin(), aboveNodes.end());
+	outPrimIndices.insert(outPrimIndices.end(), abovePrimIndices.begin(), abovePrimIndices.end());
 }
+
 bool KdTreeAccel::intersect(const Ray &inRay,
 							Intersection* isec,
-							const KdAccelNode* node,
 							Float* tHit, Float* rayEpsilon) const
 {
 	//Compute initial parametric range of ray inside kd-tree extent
-	Float tmin, tmax, rayEp;//temprary Intersection result
-	if (!node->bbox.intersectP(inRay, &tmin, &tmax))
+	Float tmin, tmax;
+	if (nodes.empty() || !treeBound.intersectP(inRay, &tmin, &tmax))
 	{
 		return false;
 	}
 
 	//prepare to traversal kd-tree for ray
 	Vector3f invDir(1.0 / inRay.d.x, 1.0 / inRay.d.y, 1.0 / inRay.d.z);
+	KdToDo todo[sMaxToDo];
+	int todoPos = 0;
+
+	// Shrink the ray to the closest hit so far
+	Ray ray(inRay);
+	ray.tMax = std::min(ray.tMax, *tHit);
 
 	//Traversal kd-tree node in order of ray
 	bool isHit = false;
-	if (node != nullptr)
+	const KdAccelNode* node = &nodes[0];
+	while (node != nullptr)
 	{
-		//if hit outside the box, think it's used for later use
-		if (inRay.tMax < tmin)
-		{
-			return isHit;
-		}
-		if (node->isLeaf())
+		//Stop once the closest hit is before the node
+		if (ray.tMax < tmin)
 		{
-			Intersection* tmpQuery = new Intersection();
-			Float hitDist;
-			for (size_t i = 0; i < node->primIndex.size(); ++i)
-			{
-				int idx = node->primIndex[i];
-
-				if (primitives[idx]->intersectP(inRay))
-				{
-					if (primitives[idx]->intersect(inRay, tmpQuery, &hitDist, &rayEp))
-					{
-						if (hitDist < *tHit && inRange(hitDist, tmin, tmax))
-						{
-							*isec = *tmpQuery;
-							*tHit = hitDist;
-							*rayEpsilon = rayEp;
-							isec->mShape = primitives[idx];
-							isHit = true;
-						}
-					}
-				}
-			}
-			delete tmpQuery;
+			break;
 		}
-		else//if hit interior node
+		if (!node->isLeaf())
 		{
 			/*process interior node*/
 			//calculate parametric distance from ray to split plane
-			int axis = node->flags;
-			Float tsplit = (node->split - inRay.o[axis]) * invDir[axis];
+			int axis = node->splitAxis();
+			Float tsplit = (node->splitPos() - ray.o[axis]) * invDir[axis];
 
 			//get children node for ray
 			const KdAccelNode* nearChild;
 			const KdAccelNode* farChild;
-			bool belowFisrt = ((inRay.o[axis] < node->split) ||
-				(inRay.o[axis] == node->split && inRay.d[axis] < 0));
-			if (belowFisrt)
+			bool belowFirst = ((ray.o[axis] < node->splitPos()) ||
+				(ray.o[axis] == node->splitPos() && ray.d[axis] <= 0));
+			if (belowFirst)
 			{
-				nearChild = node->belowNode;
-				farChild = node->aboveNode;
+				nearChild = node + 1;
+				farChild = &nodes[node->aboveChild()];
 			}
 			else
 			{
-				nearChild = node->aboveNode;
-				farChild = node->belowNode;
+				nearChild = &nodes[node->aboveChild()];
+				farChild = node + 1;
 			}
 			if (tsplit > tmax || tsplit <= 0)
 			{
-				isHit = intersect(inRay, isec, nearChild, tHit, rayEpsilon);
+				node = nearChild;
 			}
 			else if (tsplit < tmin)
 			{
-				isHit = intersect(inRay, isec, farChild, tHit, rayEpsilon);
+				node = farChild;
 			}
 			else
 			{
-				isHit = intersect(inRay, isec, nearChild, tHit, rayEpsilon);
-				if (!isHit)
+				todo[todoPos].node = farChild;
+				todo[todoPos].tmin = tsplit;
+				todo[todoPos].tmax = tmax;
+				++todoPos;
+				node = nearChild;
+				tmax = tsplit;
+			}
+		}
+		else
+		{
+			int np = node->nPrimitives();
+			for (int i = 0; i < np; ++i)
+			{
+				int idx = np == 1
+					? node->onePrimitive
+					: primIndices[node->primIndicesOffset + i];
+				Intersection primIsec;
+				Float hitDist, rayEp;
+				if (primitives[idx]->intersect(ray, &primIsec, &hitDist, &rayEp)
+					&& hitDist < ray.tMax)
 				{
-					isHit = intersect(inRay, isec, farChild, tHit, rayEpsilon);
+					*isec = primIsec;
+					*tHit = hitDist;
+					*rayEpsilon = rayEp;
+					isec->mShape = primitives[idx];
+					ray.tMax = hitDist;
+					isHit = true;
 				}
 			}
-			// 			nearChild = nullptr;
-			// 			farChild = nullptr;
+			//Grab next node to process from todo list
+			if (todoPos > 0)
+			{
+				--todoPos;
+				node = todo[todoPos].node;
+				tmin = todo[todoPos].tmin;
+				tmax = todo[todoPos].tmax;
+			}
+			else
+			{
+				node = nullptr;
+			}
 		}
 	}
 	return isHit;
 }
+
 KdTreeAccel::~KdTreeAccel()
 {
 	primitives.clear();
@@ -293,27 +492,24 @@ KdTreeAccel::~KdTreeAccel()
 
 void KdTreeAccel::printInfo() const
 {
-	if (root->flags == 3)
-	{
-		root->printInfo();
-	}
-	else
-	{
-		root->belowNode->printInfo();
-		root->aboveNode->printInfo();
-	}
-}
-
-void KdTreeAccel::printNode(KdAccelNode* node) const
-{
-	if (node->flags == 3)
+	for (auto &node : nodes)
 	{
-		node->printInfo();
-	}
-	else
-	{
-		printNode(node->belowNode);
-		printNode(node->aboveNode);
+		if (!node.isLeaf())
+		{
+			continue;
+		}
+		int np = node.nPrimitives();
+		std::cout << "Leaf primitives: ";
+		if (np == 0)
+		{
+			std::cout << "no primitive in this leaf";
+		}
+		for (int i = 0; i < np; ++i)
+		{
+			std::cout << (np == 1 ? node.onePrimitive
+						  : primIndices[node.primIndicesOffset + i]) << "\t";
+		}
+		std::cout << std::endl;
 	}
 }
 
@@ -324,121 +520,52 @@ bool KdTreeAccel::intersectP(const Ray &inRay) const
 
 void KdTreeAccel::update()
 {
-	int np = primitives.size();
-	//Initialize bouding box for all primitives in stack
-	treeBound = Bounds3f();
-	for (int i = 0; i < np; ++i)
-	{
-		treeBound.Union(primitives[i]->getWorldBounding());
-	}
-	//Allocate bound edge info
-	BoundEdge* edges[3];
-	for (int i = 0; i < 3; ++i)
-	{
-		edges[i] = new BoundEdge[np * 2];
-	}
-	//Create stack to record primitive indices
-	std::vector<int> primNum(np);
-	for (int i = 0; i < np; ++i)
-	{
-		primNum[i] = i;
-	}
-	//Start recursively build the tree
-	buildTree(root, treeBound, primNum, maxDepth, edges);
-
-	//Clean data
-	for (int i = 0; i < 3; ++i)
-	{
-		delete[] edges[i];
-		//		edges[i] = nullptr;
-	}
+	build();
 }
 
 bool KdTreeAccel::inLeaf(const Point3f &pos) const
 {
-	/*if (!treeBound.isInside(pos))
-	{
-	return false;
-	}*/
-	return inLeaf(pos, root);
+	// Leaves partition the tree bounds
+	return !nodes.empty() && treeBound.isInside(pos);
 }
 
-bool KdTreeAccel::inLeaf(const Point3f &pos, const KdAccelNode* node) const
+void KdAccelNode::initLeaf(const std::vector<int> &prims, std::vector<int> &primIndices)
 {
-	bool isInLeaf = false;
-	if (node != nullptr)
+	flags = 3;
+	nPrims |= (prims.size() << 2);
+	// Store primitive ids for leaf node
+	if (prims.size() == 0)
 	{
-		if (!node->bbox.isInside(pos))
-		{
-			return false;
-		}
-		if (node->isLeaf())
-		{
-			return true;
-		}
-
-		isInLeaf = this->inLeaf(pos, node->belowNode);
-		if (!isInLeaf)
-		{
-			isInLeaf = this->inLeaf(pos, node->aboveNode);
-		}
+		onePrimitive = 0;
 	}
-	return isInLeaf;
-}
-
-void KdAccelNode::initLeaf(std::vector<int> &prims)
-{
-	//int np = prims.size();
-	flags = 3;
-
-	primIndex = prims;
-	belowNode = nullptr;
-	aboveNode = nullptr;
-}
-void KdAccelNode::initInterior(int axis, Float s)
-{
-	flags = axis;
-	split = s;
-	belowNode = new KdAccelNode;
-	aboveNode = new KdAccelNode;
-}
-
-void KdAccelNode::printInfo() const
-{
-	if (flags == 3)
+	else if (prims.size() == 1)
 	{
-
-		std::cout << "Leaf primitives: ";
-		if (primIndex.size() == 0)
-		{
-			std::cout << "no primitive in this leaf\n"\
-				"Pmin:\t" << (bbox.pMax - bbox.pMin) << std::endl;
-		}
-		for (size_t i = 0; i < primIndex.size(); ++i)
-		{
-			std::cout << primIndex[i] << "\t";
-		}
-		std::cout << std::endl;
+		onePrimitive = prims[0];
 	}
 	else
 	{
-		this->belowNode->printInfo();
-		this->aboveNode->printInfo();
+		primIndicesOffset = primIndices.size();
+		primIndices.insert(primIndices.end(), prims.begin(), prims.end());
 	}
 }
 
-bool KdAccelNode::isLeaf() const
+void KdAccelNode::initInterior(int axis, int aboveChild, Float s)
 {
-	return (flags == 3);
+	split = s;
+	flags = axis;
+	aboveChildIndex |= (aboveChild << 2);
 }
 
-KdAccelNode::~KdAccelNode()
+void KdAccelNode::rebase(int nodeOffset, int primOffset)
 {
-	primIndex.clear();
-	delete belowNode;
-	//	belowNode = nullptr;
-	delete aboveNode;
-	//	aboveNode = nullptr;
+	if (!isLeaf())
+	{
+		aboveChildIndex += (nodeOffset << 2);
+	}
+	else if (nPrimitives() > 1)
+	{
+		primIndicesOffset += primOffset;
+	}
 }
 
 }
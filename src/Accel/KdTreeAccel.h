@@ -3,6 +3,7 @@
 #include "Accel/Bounds.h"
 #include "Geometry/Geometry.h"
 #include "Geometry/Intersection.h"
+#include "Core/MappedFile.h"
 
 namespace Kaguya
 {
@@ -35,74 +36,115 @@ struct BoundEdge
 	}
 };
 
-struct KdAccelNode//Node class
+// 8 byte node (with float precision) stored in one contiguous array.
+// The below child of an interior node directly follows it, only the
+// above child index is stored. Leaves index into a shared primitive array.
+// Pharr et al., Physically Based Rendering, 3rd edition, 4.5
+struct KdAccelNode
 {
-	Bounds3f bbox;
-	//std::vector<Shape*> primitives;
-	int flags;//index of split axes
-	std::vector<int> primIndex;//only for leaf
-	KdAccelNode* belowNode;
-	KdAccelNode* aboveNode;//only for interior
-	Float split;//split position only for interior
-
-				//void initLeaf(int* prims, int np);//primitive indices array
-	void initLeaf(std::vector<int> &prims);//primitive indices array
-	void initInterior(int axis, Float s);
-
-	bool isLeaf() const;
-	int axis() const;
-	~KdAccelNode();
-	//KdAccelNode* build(std::vector<Shape*> &tris, int depth) const;
-	// 	bool hit(KdAccelNode* node, const Ray &inRay,
-	// 		Float &t, Float &tmin, Intersection* isec) const;
+	void initLeaf(const std::vector<int> &prims, std::vector<int> &primIndices);
+	void initInterior(int axis, int aboveChild, Float s);
+	// Move a subtree built in its own arrays behind existing nodes
+	void rebase(int nodeOffset, int primOffset);
+
+	Float splitPos() const { return split; }
+	int nPrimitives() const { return nPrims >> 2; }
+	int splitAxis() const { return flags & 3; }
+	bool isLeaf() const { return (flags & 3) == 3; }
+	int aboveChild() const { return aboveChildIndex >> 2; }
+
+	union
+	{
+		Float split;// interior
+		int   onePrimitive;// leaf with a single primitive
+		int   primIndicesOffset;// leaf
+	};
 
-	void printInfo() const;
+private:
+	// Low 2 bits hold the split axis, 3 for leaves
+	union
+	{
+		int flags;
+		int nPrims;// leaf
+		int aboveChildIndex;// interior
+	};
+};
+
+enum class KdBuildMode
+{
+	// Exact SAH sweep over sorted bound edges at every node, single threaded
+	SWEEP,
+	// Binned SAH on large nodes and exact sweep near the leaves,
+	// large subtrees are built in parallel
+	BINNED_SAH
+};
+
+struct KdToDo
+{
+	const KdAccelNode* node;
+	Float tmin, tmax;
 };
 
 class KdTreeAccel//Tree class
 {
 public:
 	KdTreeAccel(const std::vector<Geometry*> &prims,
-				int md = -1, int mp = 3, Float eb = 0.5);
+				int md = -1, int mp = 3, Float eb = 0.5,
+				KdBuildMode mode = KdBuildMode::SWEEP,
+				const std::string &cacheFile = "");
 	~KdTreeAccel();
 	bool intersectP(const Ray &inRay) const;
+	// Closest hit closer than *tHit, traversal does no heap allocation
 	bool intersect(const Ray &inRay,
 				   Intersection* isec,
 				   Float* tHit, Float* rayEpsilon) const;
-	bool intersect(const Ray &inRay,
-				   Intersection* isec,
-				   const KdAccelNode* node,
-				   Float* tHit, Float* rayEpsilon) const;
 	bool inLeaf(const Point3f &pos) const;
-	bool inLeaf(const Point3f &pos, const KdAccelNode* node) const;
 
 	//update tree?
 	void update();
 
+	// Tree cache keyed by the primitive bounds and the build settings,
+	// see AccelCache
+	bool saveCache(const std::string &filename) const;
+	bool loadCache(const std::string &filename);
+
 	void printInfo() const;
-	void printNode(KdAccelNode* node) const;
 
 private:
-	void buildTree(KdAccelNode* node, const Bounds3f &bound,
-				   std::vector<int> &prims,
-				   int depth, BoundEdge* edges[3]);
+	void build();
+	uint64_t contentHash() const;
+	void buildTree(std::vector<KdAccelNode> &outNodes,
+				   std::vector<int> &outPrimIndices,
+				   const Bounds3f &bound,
+				   const std::vector<int> &prims,
+				   int depth, BoundEdge* edges[3]) const;
+	void buildBinned(std::vector<KdAccelNode> &outNodes,
+					 std::vector<int> &outPrimIndices,
+					 const Bounds3f &bound,
+					 std::vector<int> prims,
+					 int depth) const;
+	Float splitCost(const Bounds3f &bound, int axis, Float split,
+					int nBelow, int nAbove) const;
 
 private:
+	// Traversal stack size, bounds the tree depth
+	static const int sMaxToDo = 64;
+	// Binned builder settings
+	static const int sBinCount = 32;
+	static const int sExactSweepCount = 256;
+	static const int sParallelBuildCount = 16384;
+
 	//int isectCost, traversalCost,
 	int maxDepth, maxPrims;
 	Float emptyBonus;
+	KdBuildMode buildMode;
 	std::vector<Geometry*> primitives;
-	KdAccelNode* root;
+	SharedBuffer<KdAccelNode> nodes;
+	SharedBuffer<int> primIndices;
 	Bounds3f treeBound;
 
 	friend class RasterizedVolume;
 
 };
 
-struct KdToDo
-{
-	const KdAccelNode* node;
-	Float tmin, tmax;
-};
-
 }
@@ -3,6 +3,24 @@
 namespace Kaguya
 {
 
+FilmTile::FilmTile(const Bounds2i &pixelBounds)
+	: mPixelBounds(pixelBounds)
+{
+	Vector2i extent = pixelBounds.diagnal();
+	size_t pixelCount = std::max(extent.x, 0) * std::max(extent.y, 0);
+	mPixels.resize(pixelCount);
+	mWeights.resize(pixelCount, 0);
+}
+
+void FilmTile::addSample(const Point2i &pixel, const Spectrum &L, Float weight)
+{
+	int32_t tileWidth = mPixelBounds.pMax.x - mPixelBounds.pMin.x;
+	size_t index = (pixel.y - mPixelBounds.pMin.y) * tileWidth
+		+ (pixel.x - mPixelBounds.pMin.x);
+	mPixels[index] += L * weight;
+	mWeights[index] += weight;
+}
+
 //////////////////////////////////////////////////////////////////////////
 Film::Film(FILM_TYPE filmType,
 		   int32_t resX, int32_t resY, FIT_RESOLUTION_GATE fitTyep)
@@ -221,4 +239,38 @@ void Film::setAperture(Float hori, Float vert)
 	horiApert = hori;
 	vertApert = vert;
 }
+
+void Film::resetPixels()
+{
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	mPixels.assign(pixelCount, Spectrum(0.f));
+	mWeights.assign(pixelCount, 0);
+}
+
+void Film::mergeTile(const FilmTile &tile)
+{
+	const Bounds2i &bounds = tile.mPixelBounds;
+	int32_t tileWidth = bounds.pMax.x - bounds.pMin.x;
+	for (int32_t y = bounds.pMin.y; y < bounds.pMax.y; y++)
+	{
+		for (int32_t x = bounds.pMin.x; x < bounds.pMax.x; x++)
+		{
+			size_t tileIndex = (y - bounds.pMin.y) * tileWidth + (x - bounds.pMin.x);
+			size_t filmIndex = static_cast<size_t>(y) * width + x;
+			mPixels[filmIndex] += tile.mPixels[tileIndex];
+			mWeights[filmIndex] += tile.mWeights[tileIndex];
+		}
+	}
+}
+
+Spectrum Film::getPixel(uint32_t x, uint32_t y) const
+{
+	size_t index = static_cast<size_t>(y) * width + x;
+	if (index >= mPixels.size() || mWeights[index] == 0)
+	{
+		return Spectrum(0.f);
+	}
+	return mPixels[index] / mWeights[index];
+}
+
 }
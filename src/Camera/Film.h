@@ -7,6 +7,7 @@
 #pragma once
 
 #include "Math/Transform.h"
+#include "Light/Spectrum.h"
 
 namespace Kaguya
 {
@@ -29,6 +30,19 @@ enum FIT_RESOLUTION_GATE
 	FRG_OVERSCAN_FIT = 3
 };
 
+// Block of pixels rendered by one task, merged into the film once done.
+// Pixel bounds are [pMin, pMax).
+struct FilmTile
+{
+	FilmTile(const Bounds2i &pixelBounds);
+
+	void addSample(const Point2i &pixel, const Spectrum &L, Float weight = 1);
+
+	Bounds2i              mPixelBounds;
+	std::vector<Spectrum> mPixels;
+	std::vector<Float>    mWeights;
+};
+
 class Film//:public ImageData
 {
 public:
@@ -48,12 +62,22 @@ public:
 	Point2f getFilmUV(Float imgX, Float imgY) const;
 	Matrix4x4 rasterToFilm() const;
 
+	// Allocate and clear the accumulation buffer for current resolution
+	void resetPixels();
+	// Tiles must not overlap, so they can be merged concurrently
+	void mergeTile(const FilmTile &tile);
+	Spectrum getPixel(uint32_t x, uint32_t y) const;
+
 public:
 	Float horiApert, vertApert;//mm
 	uint32_t width, height;// width, height from image class
 	Transform RasterToFilm, FilmToScreen;
 
 	FIT_RESOLUTION_GATE resFT = FRG_HORIZONTAL_FIT;
+
+private:
+	std::vector<Spectrum> mPixels;
+	std::vector<Float>    mWeights;
 };
 
 }
@@ -50,14 +50,15 @@ Float PerspectiveCamera::generateRay(const CameraSample &sample,
 {
 	Point3f pCam = RasterToCamera(Point3f(sample.mFilm.x, sample.mFilm.y, 0));
 	*ray = Ray(Point3f(), normalize(Vector3f(pCam)));
+	ray->time = sample.mTime;
 	// Depth of Field Operations;
 	if (mLensRadius > 0.)
 	{
 		//sample point on lens
 		Float lensU, lensV;
-		//sample lensU and lensV to (-1,1)
-		lensU = unitRandom(20) * 2.0 - 1.0;
-		lensV = unitRandom(20) * 2.0 - 1.0;
+		//remap lens sample to (-1,1)
+		lensU = sample.mLens.x * 2.0 - 1.0;
+		lensV = sample.mLens.y * 2.0 - 1.0;
 		lensU *= mLensRadius;
 		lensV *= mLensRadius;//scale to focal radius
 
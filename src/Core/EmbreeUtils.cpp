@@ -1,4 +1,7 @@
 #include "EmbreeUtils.h"
+#include "Geometry/ParametricGeomtry.h"
+#include "Geometry/DeferredGeometry.h"
+#include "Core/ThreadPool.h"
 
 namespace Kaguya
 {
@@ -9,10 +12,51 @@ static RTCDevice sEmbreeDevice = nullptr;
 
 RTCDevice createDevice(const char* cfg)
 {
-	sEmbreeDevice = rtcNewDevice(cfg);
+	if (sEmbreeDevice != nullptr)
+	{
+		rtcReleaseDevice(sEmbreeDevice);
+	}
+	sEmbreeDevice = newDevice(cfg ? cfg : "");
 	return sEmbreeDevice;
 }
 
+RTCRayNp toRayNp(RayBatch &rays)
+{
+	RTCRayNp ret;
+	ret.org_x = rays.orgX.data();
+	ret.org_y = rays.orgY.data();
+	ret.org_z = rays.orgZ.data();
+	ret.tnear = rays.tNear.data();
+	ret.dir_x = rays.dirX.data();
+	ret.dir_y = rays.dirY.data();
+	ret.dir_z = rays.dirZ.data();
+	ret.time = rays.time.data();
+	ret.tfar = rays.tFar.data();
+	ret.mask = rays.mask.data();
+	ret.id = rays.id.data();
+	ret.flags = rays.flags.data();
+	return ret;
+}
+
+RTCRayHitNp toRayHitNp(RayBatch &rays, HitBatch &hits)
+{
+	RTCRayHitNp ret;
+	ret.ray = toRayNp(rays);
+
+	ret.hit.Ng_x = hits.NgX.data();
+	ret.hit.Ng_y = hits.NgY.data();
+	ret.hit.Ng_z = hits.NgZ.data();
+	ret.hit.u = hits.u.data();
+	ret.hit.v = hits.v.data();
+	ret.hit.primID = hits.primID.data();
+	ret.hit.geomID = hits.geomID.data();
+	for (uint32_t level = 0; level < sMaxInstanceLevel; level++)
+	{
+		ret.hit.instID[level] = hits.instID[level].data();
+	}
+	return ret;
+}
+
 void deleteDevice()
 {
 	rtcReleaseDevice(sEmbreeDevice);
@@ -29,5 +73,260 @@ RTCDevice getDevice()
 	return sEmbreeDevice;
 }
 
+RTCDevice newDevice(const std::string &cfg)
+{
+	if (cfg.empty())
+	{
+		return rtcNewDevice(nullptr);
+	}
+	RTCDevice device = rtcNewDevice(cfg.c_str());
+	if (device == nullptr)
+	{
+		std::cout << "Invalid Embree device config \"" << cfg
+			<< "\", using the default device." << std::endl;
+		device = rtcNewDevice(nullptr);
+	}
+	return device;
+}
+
+std::string deviceConfig(const RenderOptions &options)
+{
+	std::string cfg;
+	auto append = [&cfg](const std::string &option)
+	{
+		cfg += cfg.empty() ? option : "," + option;
+	};
+	if (options.threadCount > 0)
+	{
+		append("threads=" + std::to_string(options.threadCount));
+	}
+	if (!options.isa.empty())
+	{
+		append("isa=" + options.isa);
+	}
+	// Pool workers plus the caller join scene commits
+	append("user_threads=" + std::to_string(ThreadPool::global().getThreadCount() + 1));
+	if (!options.deviceConfig.empty())
+	{
+		append(options.deviceConfig);
+	}
+	return cfg;
+}
+
+static Ray rayFromRayN(RTCRayN* rays, unsigned int N, unsigned int i)
+{
+	Ray ray(Point3f(RTCRayN_org_x(rays, N, i),
+					RTCRayN_org_y(rays, N, i),
+					RTCRayN_org_z(rays, N, i)),
+			Vector3f(1, 0, 0),
+			RTCRayN_tnear(rays, N, i),
+			RTCRayN_tfar(rays, N, i));
+	// Keep the direction as is, so hit distances stay in Embree's units
+	ray.d = Vector3f(RTCRayN_dir_x(rays, N, i),
+					 RTCRayN_dir_y(rays, N, i),
+					 RTCRayN_dir_z(rays, N, i));
+	ray.time = RTCRayN_time(rays, N, i);
+	return ray;
+}
+
+static void userGeometryBounds(const RTCBoundsFunctionArguments* args)
+{
+	auto data = static_cast<const UserGeometryData*>(args->geometryUserPtr);
+	Bounds3f bounds = data->prim->worldBound();
+	args->bounds_o->lower_x = static_cast<float>(bounds.pMin.x);
+	args->bounds_o->lower_y = static_cast<float>(bounds.pMin.y);
+	args->bounds_o->lower_z = static_cast<float>(bounds.pMin.z);
+	args->bounds_o->upper_x = static_cast<float>(bounds.pMax.x);
+	args->bounds_o->upper_y = static_cast<float>(bounds.pMax.y);
+	args->bounds_o->upper_z = static_cast<float>(bounds.pMax.z);
+}
+
+static void userGeometryIntersect(const RTCIntersectFunctionNArguments* args)
+{
+	auto data = static_cast<const UserGeometryData*>(args->geometryUserPtr);
+	unsigned int N = args->N;
+	RTCRayN* rays = RTCRayHitN_RayN(args->rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(args->rayhit, N);
+	for (unsigned int i = 0; i < N; i++)
+	{
+		if (args->valid[i] == 0)
+		{
+			continue;
+		}
+		Ray ray = rayFromRayN(rays, N, i);
+		Intersection isec;
+		Float tHit, rayEpsilon;
+		if (!data->prim->intersect(ray, &isec, &tHit, &rayEpsilon)
+			|| tHit <= ray.tMin || tHit >= ray.tMax)
+		{
+			continue;
+		}
+		RTCRayN_tfar(rays, N, i) = static_cast<float>(tHit);
+		RTCHitN_Ng_x(hits, N, i) = static_cast<float>(isec.mGeomN.x);
+		RTCHitN_Ng_y(hits, N, i) = static_cast<float>(isec.mGeomN.y);
+		RTCHitN_Ng_z(hits, N, i) = static_cast<float>(isec.mGeomN.z);
+		RTCHitN_u(hits, N, i) = static_cast<float>(isec.mUV.x);
+		RTCHitN_v(hits, N, i) = static_cast<float>(isec.mUV.y);
+		RTCHitN_primID(hits, N, i) = args->primID;
+		RTCHitN_geomID(hits, N, i) = data->geomID;
+		for (unsigned int level = 0; level < sMaxInstanceLevel; level++)
+		{
+			RTCHitN_instID(hits, N, i, level) = args->context->instID[level];
+		}
+	}
+}
+
+static void userGeometryOccluded(const RTCOccludedFunctionNArguments* args)
+{
+	auto data = static_cast<const UserGeometryData*>(args->geometryUserPtr);
+	unsigned int N = args->N;
+	for (unsigned int i = 0; i < N; i++)
+	{
+		if (args->valid[i] == 0)
+		{
+			continue;
+		}
+		if (data->prim->intersectP(rayFromRayN(args->ray, N, i)))
+		{
+			RTCRayN_tfar(args->ray, N, i) = -sNumInfinity;
+		}
+	}
+}
+
+static RTCScene loadDeferredScene(DeferredGeometryData* data)
+{
+	std::call_once(data->loadFlag, [data]()
+	{
+		RTCScene scene = rtcNewScene(data->device);
+		const Geometry* prim = data->prim->load();
+		RTCGeometry geom = prim ? data->newGeometry(prim) : nullptr;
+		if (geom != nullptr)
+		{
+			rtcAttachGeometryByID(scene, geom, 0);
+			rtcReleaseGeometry(geom);
+		}
+		else if (prim != nullptr)
+		{
+			std::cout << "Unsupported deferred geometry type, primitive is not traceable." << std::endl;
+		}
+		rtcCommitScene(scene);
+		data->scene = scene;
+	});
+	return data->scene;
+}
+
+static void copyRayN(RTCRayN* rays, unsigned int N, unsigned int i, RTCRay &ray)
+{
+	ray.org_x = RTCRayN_org_x(rays, N, i);
+	ray.org_y = RTCRayN_org_y(rays, N, i);
+	ray.org_z = RTCRayN_org_z(rays, N, i);
+	ray.tnear = RTCRayN_tnear(rays, N, i);
+	ray.dir_x = RTCRayN_dir_x(rays, N, i);
+	ray.dir_y = RTCRayN_dir_y(rays, N, i);
+	ray.dir_z = RTCRayN_dir_z(rays, N, i);
+	ray.time = RTCRayN_time(rays, N, i);
+	ray.tfar = RTCRayN_tfar(rays, N, i);
+	ray.mask = RTCRayN_mask(rays, N, i);
+	ray.id = 0;
+	ray.flags = 0;
+}
+
+static void deferredGeometryBounds(const RTCBoundsFunctionArguments* args)
+{
+	auto data = static_cast<const DeferredGeometryData*>(args->geometryUserPtr);
+	const Bounds3f &bounds = data->prim->getWorldBounding();
+	args->bounds_o->lower_x = static_cast<float>(bounds.pMin.x);
+	args->bounds_o->lower_y = static_cast<float>(bounds.pMin.y);
+	args->bounds_o->lower_z = static_cast<float>(bounds.pMin.z);
+	args->bounds_o->upper_x = static_cast<float>(bounds.pMax.x);
+	args->bounds_o->upper_y = static_cast<float>(bounds.pMax.y);
+	args->bounds_o->upper_z = static_cast<float>(bounds.pMax.z);
+}
+
+static void deferredGeometryIntersect(const RTCIntersectFunctionNArguments* args)
+{
+	auto data = static_cast<DeferredGeometryData*>(args->geometryUserPtr);
+	RTCScene scene = loadDeferredScene(data);
+	unsigned int N = args->N;
+	RTCRayN* rays = RTCRayHitN_RayN(args->rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(args->rayhit, N);
+	for (unsigned int i = 0; i < N; i++)
+	{
+		if (args->valid[i] == 0)
+		{
+			continue;
+		}
+		RTCRayHit rayHit;
+		copyRayN(rays, N, i, rayHit.ray);
+		rayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+		rayHit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+		RTCIntersectContext context;
+		rtcInitIntersectContext(&context);
+		rtcIntersect1(scene, &context, &rayHit);
+		if (rayHit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+		{
+			continue;
+		}
+		// Loaded primitive IDs, reported under the placeholder geomID
+		RTCRayN_tfar(rays, N, i) = rayHit.ray.tfar;
+		RTCHitN_Ng_x(hits, N, i) = rayHit.hit.Ng_x;
+		RTCHitN_Ng_y(hits, N, i) = rayHit.hit.Ng_y;
+		RTCHitN_Ng_z(hits, N, i) = rayHit.hit.Ng_z;
+		RTCHitN_u(hits, N, i) = rayHit.hit.u;
+		RTCHitN_v(hits, N, i) = rayHit.hit.v;
+		RTCHitN_primID(hits, N, i) = rayHit.hit.primID;
+		RTCHitN_geomID(hits, N, i) = data->geomID;
+		for (unsigned int level = 0; level < sMaxInstanceLevel; level++)
+		{
+			RTCHitN_instID(hits, N, i, level) = args->context->instID[level];
+		}
+	}
+}
+
+static void deferredGeometryOccluded(const RTCOccludedFunctionNArguments* args)
+{
+	auto data = static_cast<DeferredGeometryData*>(args->geometryUserPtr);
+	RTCScene scene = loadDeferredScene(data);
+	unsigned int N = args->N;
+	for (unsigned int i = 0; i < N; i++)
+	{
+		if (args->valid[i] == 0)
+		{
+			continue;
+		}
+		RTCRay ray;
+		copyRayN(args->ray, N, i, ray);
+		RTCIntersectContext context;
+		rtcInitIntersectContext(&context);
+		rtcOccluded1(scene, &context, &ray);
+		if (ray.tfar < 0)
+		{
+			RTCRayN_tfar(args->ray, N, i) = -sNumInfinity;
+		}
+	}
+}
+
+RTCGeometry newDeferredGeometry(DeferredGeometryData* data)
+{
+	RTCGeometry geom = rtcNewGeometry(data->device, RTC_GEOMETRY_TYPE_USER);
+	rtcSetGeometryUserPrimitiveCount(geom, 1);
+	rtcSetGeometryUserData(geom, data);
+	rtcSetGeometryBoundsFunction(geom, deferredGeometryBounds, nullptr);
+	rtcSetGeometryIntersectFunction(geom, deferredGeometryIntersect);
+	rtcSetGeometryOccludedFunction(geom, deferredGeometryOccluded);
+	return geom;
+}
+
+RTCGeometry newUserGeometry(RTCDevice device, UserGeometryData* data)
+{
+	RTCGeometry geom = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_USER);
+	rtcSetGeometryUserPrimitiveCount(geom, 1);
+	rtcSetGeometryUserData(geom, data);
+	rtcSetGeometryBoundsFunction(geom, userGeometryBounds, nullptr);
+	rtcSetGeometryIntersectFunction(geom, userGeometryIntersect);
+	rtcSetGeometryOccludedFunction(geom, userGeometryOccluded);
+	return geom;
+}
+
 }
 }
@@ -1,19 +1,36 @@
 #pragma once
 #include "Core/Kaguya.h"
+#include "Core/RenderOptions.h"
 #include "Tracer/Ray.h"
+#include "Tracer/RayBatch.h"
 #include "Math/Vector.h"
 
 #include <embree3/rtcore.h>
 #include <embree3/rtcore_ray.h>
 
+#include <functional>
+#include <mutex>
+
 namespace Kaguya
 {
+
+class ParametricGeomtry;
+class DeferredGeometry;
+class Geometry;
+
 namespace EmbreeUtils
 {
 
+// Replaces the current device, scenes and geometries keep their own
+// reference to the device they were created on
 RTCDevice createDevice(const char* cfg = nullptr);
 void deleteDevice();
 RTCDevice getDevice();
+// Device of its own for a scene, released by the caller.
+// An invalid cfg falls back to the default device options
+RTCDevice newDevice(const std::string &cfg);
+// Device config string of the render options, e.g. "threads=8,isa=avx2"
+std::string deviceConfig(const RenderOptions &options);
 
 inline Ray safeConvert(const RTCRay &src)
 {
@@ -34,8 +51,11 @@ inline RTCRay safeConvert(const Ray &src)
 
 	ret.tnear = src.tMin;
 	ret.tfar = src.tMax;
+	ret.time = src.time;
 
+	ret.mask = src.mask;
 	ret.id = RTC_INVALID_GEOMETRY_ID;
+	ret.flags = 0;
 	//ret.primID = RTC_INVALID_GEOMETRY_ID;
 	//ret.instID = RTC_INVALID_GEOMETRY_ID;
 
@@ -43,5 +63,38 @@ inline RTCRay safeConvert(const Ray &src)
 
 }
 
+// Pointer SOA view of a batch, hits are written in place
+RTCRayNp toRayNp(RayBatch &rays);
+RTCRayHitNp toRayHitNp(RayBatch &rays, HitBatch &hits);
+
+// User data of an analytic shape registered as Embree user geometry.
+// Must outlive the scene, geomID is filled in once attached.
+struct UserGeometryData
+{
+	const ParametricGeomtry* prim;
+	unsigned int             geomID;
+};
+
+// Geometry with bounds, intersect and occluded callbacks forwarding
+// to the shape, callbacks handle single rays and 4/8/16-wide packets
+RTCGeometry newUserGeometry(RTCDevice device, UserGeometryData* data);
+
+// User data of a deferred geometry. The first ray reaching its bounds
+// loads it into a scene of its own, built with newGeometry.
+// Must outlive the scene, scene is released by the owner.
+struct DeferredGeometryData
+{
+	const DeferredGeometry*                     prim = nullptr;
+	unsigned int                                geomID = RTC_INVALID_GEOMETRY_ID;
+	std::function<RTCGeometry(const Geometry*)> newGeometry;
+	RTCDevice                                   device = nullptr;
+	std::once_flag                              loadFlag;
+	RTCScene                                    scene = nullptr;
+};
+
+// Geometry covering the bounds of the placeholder, rays entering them
+// are traced against the loaded scene and hits reported as this geomID
+RTCGeometry newDeferredGeometry(DeferredGeometryData* data);
+
 }
 }
@@ -0,0 +1,88 @@
+#include "Core/MappedFile.h"
+
+#if defined(KAGUYA_IS_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Kaguya
+{
+
+#if defined(KAGUYA_IS_WINDOWS)
+MappedFile::MappedFile(const std::string &filename)
+	: mData(nullptr)
+	, mSize(0)
+	, mFileHandle(INVALID_HANDLE_VALUE)
+	, mMappingHandle(nullptr)
+{
+	mFileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+							  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize;
+	if (mFileHandle == INVALID_HANDLE_VALUE
+		|| !GetFileSizeEx(mFileHandle, &fileSize)
+		|| fileSize.QuadPart == 0)
+	{
+		return;
+	}
+	mMappingHandle = CreateFileMappingA(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMappingHandle == nullptr)
+	{
+		return;
+	}
+	mData = static_cast<const char*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+	mSize = mData ? static_cast<size_t>(fileSize.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMappingHandle)
+	{
+		CloseHandle(mMappingHandle);
+	}
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFileHandle);
+	}
+}
+#else
+MappedFile::MappedFile(const std::string &filename)
+	: mData(nullptr)
+	, mSize(0)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+	{
+		void* ptr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			mData = static_cast<const char*>(ptr);
+			mSize = fileStat.st_size;
+		}
+	}
+	// The mapping stays valid after closing the descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData)
+	{
+		munmap(const_cast<char*>(mData), mSize);
+	}
+}
+#endif
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Core/Kaguya.h"
+
+namespace Kaguya
+{
+
+// Read-only memory map of a whole file
+class MappedFile
+{
+public:
+	MappedFile(const std::string &filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool isValid() const { return mData != nullptr; }
+	const char* data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	const char* mData;
+	size_t      mSize;
+#if defined(KAGUYA_IS_WINDOWS)
+	void*       mFileHandle;
+	void*       mMappingHandle;
+#endif
+};
+
+// Array that either owns its elements or views a block of a read-only
+// memory map, which the shared handle keeps alive. Mutable access copies
+// mapped elements into owned storage first.
+template <typename T>
+class SharedBuffer
+{
+public:
+	SharedBuffer() {}
+	SharedBuffer(std::vector<T> values) : mOwned(std::move(values)) {}
+	SharedBuffer(std::shared_ptr<const MappedFile> file, const T* data, size_t count)
+		: mFile(std::move(file)), mView(data), mViewCount(count)
+	{
+	}
+
+	bool isMapped() const { return mFile != nullptr; }
+	const T* data() const { return mFile ? mView : mOwned.data(); }
+	size_t size() const { return mFile ? mViewCount : mOwned.size(); }
+	bool empty() const { return size() == 0; }
+
+	const T &operator[](size_t i) const { return data()[i]; }
+	const T &front() const { return data()[0]; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + size(); }
+
+	std::vector<T> &vector()
+	{
+		if (mFile)
+		{
+			mOwned.assign(mView, mView + mViewCount);
+			mFile.reset();
+			mView = nullptr;
+			mViewCount = 0;
+		}
+		return mOwned;
+	}
+
+private:
+	std::vector<T>                    mOwned;
+	std::shared_ptr<const MappedFile> mFile;
+	const T*                          mView = nullptr;
+	size_t                            mViewCount = 0;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Core/Kaguya.h"
+
+namespace Kaguya
+{
+
+enum class AccelBuildQuality : uint8_t
+{
+	// Not set in the scene file, medium unless the scene turns dynamic
+	DEFAULT,
+	LOW,
+	MEDIUM,
+	HIGH
+};
+
+enum AccelSceneFlags : uint32_t
+{
+	ACCEL_SCENE_NONE = 0,
+	// Smaller BVH at some traversal cost
+	ACCEL_SCENE_COMPACT = 1 << 0,
+	// Watertight, no missed hits at edges
+	ACCEL_SCENE_ROBUST = 1 << 1,
+	// Geometry changes between commits
+	ACCEL_SCENE_DYNAMIC = 1 << 2
+};
+
+// Settings of the "renderer" block in scene files
+struct RenderOptions
+{
+	std::string outputFile;
+	uint32_t    samplesPerPixel = 16;
+	// "random", "stratified", "halton" or "sobol"
+	std::string samplerType = "sobol";
+	uint64_t    seed = 0;
+	// Target length in pixels of subdivision surface segments,
+	// 0 uses the uniform rate of each mesh
+	Float       subdivEdgeLength = 4;
+	// Quantize mesh UVs and normals, meshes can override it with "compact"
+	bool        compactMeshes = false;
+	// Keep a binary copy of each polygonal mesh next to its file,
+	// meshes can override it with "cache"
+	bool        meshCache = false;
+	// Load meshes when a ray first reaches their bounds, which come from
+	// "bounds" or the mesh cache. Meshes can override it with "deferred"
+	bool        deferredLoading = false;
+
+	// Ray tracing kernel settings
+	AccelBuildQuality buildQuality = AccelBuildQuality::DEFAULT;
+	uint32_t    sceneFlags = ACCEL_SCENE_NONE;
+	// 0 uses every hardware thread
+	uint32_t    threadCount = 0;
+	// Instruction set of the kernel, empty picks the best available
+	std::string isa;
+	// Extra device options, appended as is
+	std::string deviceConfig;
+};
+
+}
@@ -15,6 +15,8 @@ public:
 	~RenderPrimitive();
 
 	const Geometry* getGeometry() const { return mGeometry.get(); }
+	Geometry* getGeometry() { return mGeometry.get(); }
+	const Light* getLight() const { return mLight.get(); }
 
 private:
 	std::shared_ptr<Geometry> mGeometry;
@@ -0,0 +1,178 @@
+#include "Sampler.h"
+#include "Math/LowDiscrepancy.h"
+
+namespace Kaguya
+{
+
+/************************************************************************/
+/* Stratified Sampler                                                   */
+/************************************************************************/
+StratifiedSampler::StratifiedSampler(uint32_t samplesPerPixel, uint64_t seed)
+	: Sampler(std::max(samplesPerPixel, 1u), seed)
+{
+	// Most square factorization of the sample count
+	mSamplesX = static_cast<uint32_t>(std::sqrt(static_cast<double>(mSamplesPerPixel)));
+	while (mSamplesPerPixel % mSamplesX != 0)
+	{
+		mSamplesX--;
+	}
+	mSamplesY = mSamplesPerPixel / mSamplesX;
+}
+
+std::unique_ptr<Sampler> StratifiedSampler::clone() const
+{
+	return std::make_unique<StratifiedSampler>(*this);
+}
+
+void StratifiedSampler::startPixelSample(const Point2i &pixel, uint32_t sampleIndex)
+{
+	Sampler::startPixelSample(pixel, sampleIndex);
+	mRng.setSequence(hashValues(static_cast<uint32_t>(pixel.x),
+								static_cast<uint32_t>(pixel.y),
+								mSeed));
+	mRng.advance(static_cast<uint64_t>(sampleIndex) << 16);
+}
+
+uint32_t StratifiedSampler::stratum()
+{
+	// Every dimension visits the strata in its own order
+	uint64_t hash = hashValues(static_cast<uint32_t>(mPixel.x) | (static_cast<uint64_t>(mPixel.y) << 32),
+							   mDimension, mSeed);
+	return permutationElement(mSampleIndex, mSamplesPerPixel, static_cast<uint32_t>(hash));
+}
+
+Float StratifiedSampler::generate1D()
+{
+	uint32_t s = stratum();
+	mDimension++;
+	return std::min(sOneMinusEpsilon,
+					(s + mRng.uniformFloat()) / static_cast<Float>(mSamplesPerPixel));
+}
+
+Point2f StratifiedSampler::generate2D()
+{
+	uint32_t s = stratum();
+	mDimension += 2;
+	uint32_t x = s % mSamplesX;
+	uint32_t y = s / mSamplesX;
+	Float dx = mRng.uniformFloat();
+	Float dy = mRng.uniformFloat();
+	return Point2f(std::min(sOneMinusEpsilon, (x + dx) / static_cast<Float>(mSamplesX)),
+				   std::min(sOneMinusEpsilon, (y + dy) / static_cast<Float>(mSamplesY)));
+}
+
+/************************************************************************/
+/* Halton Sampler                                                       */
+/************************************************************************/
+std::unique_ptr<Sampler> HaltonSampler::clone() const
+{
+	return std::make_unique<HaltonSampler>(*this);
+}
+
+void HaltonSampler::startPixelSample(const Point2i &pixel, uint32_t sampleIndex)
+{
+	Sampler::startPixelSample(pixel, sampleIndex);
+	mPixelSeed = hashValues(static_cast<uint32_t>(pixel.x),
+							static_cast<uint32_t>(pixel.y),
+							mSeed);
+}
+
+Float HaltonSampler::generate1D()
+{
+	uint32_t dim = mDimension++;
+	return scrambledRadicalInverse(dim, mSampleIndex, mixBits(mPixelSeed ^ dim));
+}
+
+Point2f HaltonSampler::generate2D()
+{
+	uint32_t dim = mDimension;
+	mDimension += 2;
+	return Point2f(scrambledRadicalInverse(dim, mSampleIndex, mixBits(mPixelSeed ^ dim)),
+				   scrambledRadicalInverse(dim + 1, mSampleIndex, mixBits(mPixelSeed ^ (dim + 1))));
+}
+
+/************************************************************************/
+/* Sobol Sampler                                                        */
+/************************************************************************/
+SobolSampler::SobolSampler(uint32_t samplesPerPixel, uint64_t seed)
+	: Sampler(samplesPerPixel, seed)
+{
+	uint32_t powerOfTwo = 1;
+	while (powerOfTwo < samplesPerPixel)
+	{
+		powerOfTwo <<= 1;
+	}
+	if (powerOfTwo != samplesPerPixel)
+	{
+		std::cout << "Sobol sampler: rounding " << samplesPerPixel
+			<< " samples per pixel up to " << powerOfTwo << std::endl;
+	}
+	mSamplesPerPixel = powerOfTwo;
+}
+
+std::unique_ptr<Sampler> SobolSampler::clone() const
+{
+	return std::make_unique<SobolSampler>(*this);
+}
+
+void SobolSampler::startPixelSample(const Point2i &pixel, uint32_t sampleIndex)
+{
+	Sampler::startPixelSample(pixel, sampleIndex);
+	mPixelSeed = hashValues(static_cast<uint32_t>(pixel.x),
+							static_cast<uint32_t>(pixel.y),
+							mSeed);
+}
+
+Float SobolSampler::sampleDimension(uint32_t dimension) const
+{
+	// Each group of 4 dimensions shuffles the sample order independently
+	uint32_t groupSeed = static_cast<uint32_t>(mixBits(mPixelSeed ^ (dimension / sSobolDimensions)));
+	uint32_t index = owenScramble(mSampleIndex, groupSeed);
+	uint32_t dim = dimension % sSobolDimensions;
+	uint32_t dimSeed = static_cast<uint32_t>(mixBits(groupSeed ^ (static_cast<uint64_t>(dim + 1) << 32)));
+	return uint32ToUnitFloat(owenScramble(sobolSample(index, dim), dimSeed));
+}
+
+Float SobolSampler::generate1D()
+{
+	return sampleDimension(mDimension++);
+}
+
+Point2f SobolSampler::generate2D()
+{
+	// Keep both dimensions inside the same 4D set
+	if (mDimension % sSobolDimensions == sSobolDimensions - 1)
+	{
+		mDimension++;
+	}
+	uint32_t dim = mDimension;
+	mDimension += 2;
+	return Point2f(sampleDimension(dim), sampleDimension(dim + 1));
+}
+
+std::unique_ptr<Sampler> createSampler(const std::string &samplerType,
+									   uint32_t samplesPerPixel,
+									   uint64_t seed)
+{
+	if (samplerType == "random")
+	{
+		return std::make_unique<RandomSampler>(samplesPerPixel, seed);
+	}
+	else if (samplerType == "stratified")
+	{
+		return std::make_unique<StratifiedSampler>(samplesPerPixel, seed);
+	}
+	else if (samplerType == "halton")
+	{
+		return std::make_unique<HaltonSampler>(samplesPerPixel, seed);
+	}
+	else if (samplerType == "sobol")
+	{
+		return std::make_unique<SobolSampler>(samplesPerPixel, seed);
+	}
+	std::cout << "Unknown sampler type \"" << samplerType
+		<< "\", falling back to sobol" << std::endl;
+	return std::make_unique<SobolSampler>(samplesPerPixel, seed);
+}
+
+}
@@ -4,17 +4,161 @@
 
 #include "Math/MathUtil.h"
 #include "Math/Vector.h"
+#include "Math/RNG.h"
 
 namespace Kaguya
 {
 
-struct Sampler
+// Samplers are cheap to clone: every render thread works on its own copy.
+// Values only depend on (seed, pixel, sample index, dimension), so images
+// are identical whatever the thread count or tile order.
+class Sampler
 {
-	virtual Float generate1D() const { return unitRandom(10); }
-	virtual Point2f generate2D() const { return Point2f(unitRandom(10), unitRandom(10)); }
+public:
+	Sampler(uint32_t samplesPerPixel, uint64_t seed)
+		: mSamplesPerPixel(samplesPerPixel)
+		, mSeed(seed)
+		, mSampleIndex(0)
+		, mDimension(0)
+	{
+	}
+	virtual ~Sampler() {}
 
+	virtual std::unique_ptr<Sampler> clone() const = 0;
+
+	// Restart the sample sequence for the given pixel
+	virtual void startPixelSample(const Point2i &pixel, uint32_t sampleIndex)
+	{
+		mPixel = pixel;
+		mSampleIndex = sampleIndex;
+		mDimension = 0;
+	}
+
+	virtual Float generate1D() = 0;
+	virtual Point2f generate2D() = 0;
+
+	uint32_t getSamplesPerPixel() const { return mSamplesPerPixel; }
+
+protected:
+	uint32_t mSamplesPerPixel;
+	uint64_t mSeed;
+
+	Point2i  mPixel;
+	uint32_t mSampleIndex;
+	uint32_t mDimension;
+};
+
+// Independent uniform random samples from a PCG32 stream per pixel
+class RandomSampler : public Sampler
+{
+public:
+	RandomSampler(uint32_t samplesPerPixel = 4, uint64_t seed = 0)
+		: Sampler(samplesPerPixel, seed)
+	{
+	}
+
+	std::unique_ptr<Sampler> clone() const override
+	{
+		return std::make_unique<RandomSampler>(*this);
+	}
+
+	void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) override
+	{
+		Sampler::startPixelSample(pixel, sampleIndex);
+		mRng.setSequence(hashValues(static_cast<uint32_t>(pixel.x),
+									static_cast<uint32_t>(pixel.y),
+									mSeed));
+		// Leave each sample 2^16 values apart in the stream
+		mRng.advance(static_cast<uint64_t>(sampleIndex) << 16);
+	}
+
+	Float generate1D() override
+	{
+		mDimension++;
+		return mRng.uniformFloat();
+	}
+	Point2f generate2D() override
+	{
+		mDimension += 2;
+		Float u = mRng.uniformFloat();
+		return Point2f(u, mRng.uniformFloat());
+	}
+
+private:
+	RNG mRng;
+};
+
+// Jittered samples in permuted strata, one stratum per pixel sample.
+// 2D samples use a x*y grid with x*y == samplesPerPixel.
+class StratifiedSampler : public Sampler
+{
+public:
+	StratifiedSampler(uint32_t samplesPerPixel = 16, uint64_t seed = 0);
+
+	std::unique_ptr<Sampler> clone() const override;
+
+	void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) override;
+
+	Float generate1D() override;
+	Point2f generate2D() override;
+
+private:
+	uint32_t stratum();
+
+private:
+	uint32_t mSamplesX, mSamplesY;
+	RNG      mRng;
+};
+
+// Halton sequence with per-pixel Owen scrambled digits
+class HaltonSampler : public Sampler
+{
+public:
+	HaltonSampler(uint32_t samplesPerPixel = 16, uint64_t seed = 0)
+		: Sampler(samplesPerPixel, seed)
+	{
+	}
+
+	std::unique_ptr<Sampler> clone() const override;
+
+	void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) override;
+
+	Float generate1D() override;
+	Point2f generate2D() override;
+
+private:
+	uint64_t mPixelSeed = 0;
 };
 
+// Shuffled, Owen scrambled 4D Sobol' points, padded to higher dimensions
+// with independently shuffled 4D sets.
+// Burley, Practical Hash-based Owen Scrambling, JCGT 2020
+class SobolSampler : public Sampler
+{
+public:
+	// samplesPerPixel is rounded up to a power of 2
+	SobolSampler(uint32_t samplesPerPixel = 16, uint64_t seed = 0);
+
+	std::unique_ptr<Sampler> clone() const override;
+
+	void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) override;
+
+	Float generate1D() override;
+	Point2f generate2D() override;
+
+private:
+	Float sampleDimension(uint32_t dimension) const;
+
+private:
+	uint64_t mPixelSeed = 0;
+};
+
+// Create a sampler from its scene file name:
+// "random", "stratified", "halton" or "sobol"
+std::unique_ptr<Sampler> createSampler(const std::string &samplerType,
+									   uint32_t samplesPerPixel,
+									   uint64_t seed = 0);
+
 struct CameraSample
 {
 	Point2f mFilm;
@@ -1,9 +1,14 @@
 #include "Scene.h"
 #include "Core/EmbreeUtils.h"
+#include "Geometry/ParametricGeomtry.h"
 #include "Geometry/TriangleMesh.h"
 #include "Geometry/QuadMesh.h"
 #include "Geometry/SubdMesh.h"
 #include "Geometry/Curve.h"
+#include "Geometry/Instance.h"
+#include "Geometry/DeferredGeometry.h"
+#include "Camera/Camera.h"
+#include "Core/ThreadPool.h"
 
 #include <embree3/rtcore_geometry.h>
 #include <embree3/rtcore_ray.h>
@@ -11,33 +16,137 @@
 namespace Kaguya
 {
 
+// Row vector matrices, rows are the columns of a column vector matrix
+static void setInstanceTransform(RTCGeometry geom, const Matrix4x4 &mat)
+{
+	float xfm[16];
+	for (int i = 0; i < 16; i++)
+	{
+		xfm[i] = static_cast<float>(mat.data()[i]);
+	}
+	rtcSetGeometryTransform(geom, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, xfm);
+}
+
+// Innermost instance to world of a flattened instance path
+static Matrix4x4 pathToWorld(const std::vector<const Instance*> &path)
+{
+	Matrix4x4 mat = path.front()->objectToWorld();
+	for (size_t i = 1; i < path.size(); i++)
+	{
+		mat = mat * path[i]->objectToWorld();
+	}
+	return mat;
+}
+
 Scene::Scene()
-	: mSceneContext(rtcNewScene(EmbreeUtils::getDevice()))
+	: mDevice(EmbreeUtils::getDevice())
+	, mSceneContext(rtcNewScene(mDevice))
 {
+	rtcRetainDevice(mDevice);
 }
 
 Scene::Scene(std::shared_ptr<Camera> camera,
 			 std::vector<std::shared_ptr<RenderPrimitive>> prims,
-			 std::vector<std::shared_ptr<Light>> lights)
-	: mSceneContext(rtcNewScene(EmbreeUtils::getDevice()))
+			 std::vector<std::shared_ptr<Light>> lights,
+			 const RenderOptions &options)
+	: mDevice(EmbreeUtils::newDevice(EmbreeUtils::deviceConfig(options)))
+	, mSceneContext(rtcNewScene(mDevice))
 	, mCamera(camera)
 	, mPrims(std::move(prims))
 	, mLights(std::move(lights))
+	, mRenderOptions(options)
 {
-	for (auto& prim : mPrims)
+	applySceneSettings(mSceneContext);
+
+	// Buffers are prepared and committed on the thread pool, attaching
+	// in order keeps geomID equal to the primitive index
+	std::vector<RTCGeometry> geometries(mPrims.size(), nullptr);
+	parallelFor(0, mPrims.size(), [&](size_t i)
+	{
+		geometries[i] = newGeometry(mPrims[i]->getGeometry(), true);
+	});
+	// Flattened instances append pieces past the primitives
+	uint32_t primCount = static_cast<uint32_t>(mPrims.size());
+	mHitRecords.resize(primCount);
+	for (uint32_t i = 0; i < primCount; i++)
 	{
-		buildGeometry(prim->getGeometry());
+		mHitRecords[i] = makeHitRecord(mPrims[i].get());
+		if (geometries[i] != nullptr)
+		{
+			mHitRecords[i].embreeGeometry = geometries[i];
+			rtcAttachGeometryByID(mSceneContext, geometries[i], i);
+			rtcReleaseGeometry(geometries[i]);
+		}
+		else
+		{
+			buildGeometry(mPrims[i]->getGeometry(), mSceneContext, i);
+		}
 	}
 }
 
 Scene::~Scene()
 {
+	for (auto &prototypeScene : mPrototypeScenes)
+	{
+		rtcReleaseScene(prototypeScene.second);
+	}
+	for (auto &prototypeScene : mFlatPrototypeScenes)
+	{
+		rtcReleaseScene(prototypeScene.second);
+	}
+	for (auto &deferred : mDeferredGeometries)
+	{
+		if (deferred.scene != nullptr)
+		{
+			rtcReleaseScene(deferred.scene);
+		}
+	}
 	rtcReleaseScene(mSceneContext);
+	rtcReleaseDevice(mDevice);
+}
+
+void Scene::applySceneSettings(RTCScene scene) const
+{
+	switch (mRenderOptions.buildQuality)
+	{
+	case AccelBuildQuality::LOW:
+		rtcSetSceneBuildQuality(scene, RTC_BUILD_QUALITY_LOW);
+		break;
+	case AccelBuildQuality::HIGH:
+		rtcSetSceneBuildQuality(scene, RTC_BUILD_QUALITY_HIGH);
+		break;
+	default:
+		rtcSetSceneBuildQuality(scene, RTC_BUILD_QUALITY_MEDIUM);
+		break;
+	}
+
+	int flags = RTC_SCENE_FLAG_NONE;
+	if (mRenderOptions.sceneFlags & ACCEL_SCENE_COMPACT)
+	{
+		flags |= RTC_SCENE_FLAG_COMPACT;
+	}
+	if (mRenderOptions.sceneFlags & ACCEL_SCENE_ROBUST)
+	{
+		flags |= RTC_SCENE_FLAG_ROBUST;
+	}
+	if (mRenderOptions.sceneFlags & ACCEL_SCENE_DYNAMIC)
+	{
+		flags |= RTC_SCENE_FLAG_DYNAMIC;
+	}
+	rtcSetSceneFlags(scene, static_cast<RTCSceneFlags>(flags));
 }
 
 void Scene::commitScene()
 {
-	rtcCommitScene(mSceneContext);
+	// Pool workers join the BVH build instead of Embree spawning its own
+	ThreadPool &pool = ThreadPool::global();
+	TaskGroup group;
+	for (uint32_t i = 0; i < pool.getThreadCount(); i++)
+	{
+		pool.run(group, [this]() { rtcJoinCommitScene(mSceneContext); });
+	}
+	rtcJoinCommitScene(mSceneContext);
+	pool.wait(group);
 }
 
 bool Scene::intersect(Ray &inRay, Intersection* isec) const
@@ -57,6 +166,9 @@ bool Scene::intersect(Ray &inRay, Intersection* isec) const
 		return true;
 	}
 #else
+	static_assert(offsetof(Ray, geomID) == offsetof(RTCRayHit, hit) + offsetof(RTCHit, geomID)
+				  && offsetof(Ray, instID) == offsetof(RTCRayHit, hit) + offsetof(RTCHit, instID),
+				  "Ray must share the memory layout of RTCRayHit");
 	{
 		RTCIntersectContext context;
 		rtcInitIntersectContext(&context);
@@ -65,68 +177,461 @@ bool Scene::intersect(Ray &inRay, Intersection* isec) const
 	}
 	if (inRay.geomID != RTC_INVALID_GEOMETRY_ID)
 	{
-		isec->mShape = mPrims[inRay.primID]->getGeometry();
-		isec->mShape->postIntersect(inRay, isec);
+		postIntersect(inRay, isec);
 		return true;
 	}
 #endif
 	return false;
 }
 
+void Scene::intersect(RayBatch &rays, HitBatch &hits) const
+{
+	hits.reset(rays.size());
+	if (rays.empty())
+	{
+		return;
+	}
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+	// Stream API lets Embree pick the packet width for the host ISA
+	RTCRayHitNp rayHits = EmbreeUtils::toRayHitNp(rays, hits);
+	rtcIntersectNp(mSceneContext, &context, &rayHits,
+				   static_cast<unsigned int>(rays.size()));
+}
+
+bool Scene::resolveHit(const RayBatch &rays, const HitBatch &hits,
+					   size_t index, Ray &ray, Intersection* isec) const
+{
+	ray = rays.getRay(index);
+	if (!hits.isHit(index))
+	{
+		return false;
+	}
+	hits.fillRay(index, ray);
+	postIntersect(ray, isec);
+	return true;
+}
+
+void Scene::postIntersect(Ray &ray, Intersection* isec) const
+{
+	// Top level instance or the hit geometry itself
+	uint32_t topID = ray.instID[0] == RTC_INVALID_GEOMETRY_ID
+		? ray.geomID : ray.instID[0];
+	const HitRecord &record = mHitRecords[topID];
+	isec->mLightID = record.lightID;
+	isec->mShape = record.geometry;
+
+	// Concrete calls for the common mesh types skip the virtual dispatch
+	switch (record.kind)
+	{
+	case HitRecord::Kind::TRIANGLE_MESH:
+		static_cast<const TriangleMesh*>(record.geometry)->TriangleMesh::postIntersect(ray, isec);
+		break;
+	case HitRecord::Kind::QUAD_MESH:
+		static_cast<const QuadMesh*>(record.geometry)->QuadMesh::postIntersect(ray, isec);
+		break;
+	case HitRecord::Kind::SUBDIVISION_MESH:
+	{
+		record.geometry->postIntersect(ray, isec);
+		// Limit surface position and tangents evaluated by Embree
+		float P[3], dPdu[3], dPdv[3];
+		rtcInterpolate1(record.embreeGeometry, ray.primID,
+						static_cast<float>(ray.u), static_cast<float>(ray.v),
+						RTC_BUFFER_TYPE_VERTEX, 0, P, dPdu, dPdv, 3);
+		isec->mPos = Point3f(P[0], P[1], P[2]);
+		isec->mPu = isec->mPs = Vector3f(dPdu[0], dPdu[1], dPdu[2]);
+		isec->mPv = isec->mPt = Vector3f(dPdv[0], dPdv[1], dPdv[2]);
+		isec->mGeomN = normalize(ray.Ng);
+		Normal3f limitN(cross(isec->mPu, isec->mPv));
+		isec->mShadingN = limitN.lengthSquared() > 0
+			? normalize(limitN) : isec->mGeomN;
+		isec->mST = isec->mUV;
+		break;
+	}
+	case HitRecord::Kind::INSTANCE:
+		postIntersectInstance(static_cast<const Instance*>(record.geometry), 1, ray, isec);
+		break;
+	case HitRecord::Kind::FLAT_INSTANCE:
+		postIntersectFlatInstance(record.flatInstance, ray, isec);
+		break;
+	case HitRecord::Kind::DEFERRED:
+		// Loaded by the traversal that reported the hit
+		isec->mShape = static_cast<const DeferredGeometry*>(record.geometry)->getGeometry();
+		isec->mShape->postIntersect(ray, isec);
+		break;
+	case HitRecord::Kind::OTHER:
+		record.geometry->postIntersect(ray, isec);
+		break;
+	default:
+		break;
+	}
+}
+
+void Scene::postIntersectInstance(const Instance* inst, uint32_t level,
+								  const Ray &ray, Intersection* isec) const
+{
+	// Embree reports the hit in the space of the innermost instance
+	Ray localRay = inst->worldToPrototype(ray);
+	const InstancePrototype* prototype = inst->getPrototype();
+	uint32_t childID = level < sMaxInstanceLevel
+		? ray.instID[level] : RTC_INVALID_GEOMETRY_ID;
+	if (childID != RTC_INVALID_GEOMETRY_ID)
+	{
+		auto child = static_cast<const Instance*>(prototype->getPrimitive(childID));
+		postIntersectInstance(child, level + 1, localRay, isec);
+	}
+	else
+	{
+		isec->mShape = prototype->getPrimitive(ray.geomID);
+		isec->mShape->postIntersect(localRay, isec);
+	}
+	inst->prototypeToWorld(isec);
+}
+
+void Scene::postIntersectFlatInstance(const FlatInstance* flat,
+									  const Ray &ray, Intersection* isec) const
+{
+	// The piece places the innermost prototype directly, walk its path
+	Ray localRay(ray);
+	for (auto inst : flat->path)
+	{
+		localRay = inst->worldToPrototype(localRay);
+	}
+	isec->mShape = flat->path.back()->getPrototype()->getPrimitive(ray.geomID);
+	isec->mShape->postIntersect(localRay, isec);
+	for (auto inst = flat->path.rbegin(); inst != flat->path.rend(); ++inst)
+	{
+		(*inst)->prototypeToWorld(isec);
+	}
+}
+
+bool Scene::occluded(const Ray &ray) const
+{
+	RTCRay occRay = EmbreeUtils::safeConvert(ray);
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	rtcOccluded1(mSceneContext, &context, &occRay);
+	// tfar is set to -inf when any hit was found
+	return occRay.tfar < 0;
+}
+
+void Scene::occluded(RayBatch &rays) const
+{
+	if (rays.empty())
+	{
+		return;
+	}
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	RTCRayNp occRays = EmbreeUtils::toRayNp(rays);
+	rtcOccludedNp(mSceneContext, &context, &occRays,
+				  static_cast<unsigned int>(rays.size()));
+}
+
 RenderBufferTrait Scene::getRenderBuffer(uint32_t geomID) const
 {
 	RenderBufferTrait ret;
-	mPrims.at(geomID)->getGeometry()->getRenderBuffer(&ret);
+	// Removed primitives leave an empty buffer
+	if (mPrims.at(geomID))
+	{
+		mPrims[geomID]->getGeometry()->getRenderBuffer(&ret);
+	}
 	return ret;
 }
 
-void Scene::buildGeometry(const Geometry* prim)
+void Scene::addLight(std::shared_ptr<Light> &light)
 {
-	if (prim == nullptr)
+	mLights.push_back(light);
+	// Primitives may already reference it as their area light
+	for (size_t i = 0; i < mPrims.size(); i++)
 	{
-		return;
+		if (mPrims[i])
+		{
+			mHitRecords[i] = makeHitRecord(mPrims[i].get());
+		}
 	}
-	switch (prim->primitiveType())
+	for (auto &flat : mFlatInstances)
 	{
-	case GeometryType::PARAMATRIC_SURFACE:
+		mHitRecords[flat.geomID].lightID = mHitRecords[flat.ownerID].lightID;
+	}
+}
+
+HitRecord Scene::makeHitRecord(const RenderPrimitive* prim) const
+{
+	HitRecord record;
+	if (prim == nullptr || prim->getGeometry() == nullptr)
 	{
-		buildUserGeomtry(prim);
-		break;
+		return record;
 	}
+	record.geometry = prim->getGeometry();
+	switch (record.geometry->primitiveType())
+	{
 	case GeometryType::POLYGONAL_MESH:
 	{
-		buildPolygonalMesh(static_cast<const PolyMesh*>(prim));
+		auto mesh = static_cast<const PolyMesh*>(record.geometry);
+		record.kind = mesh->polyMeshType() == PolyMeshType::TRIANGLE
+			? HitRecord::Kind::TRIANGLE_MESH : HitRecord::Kind::QUAD_MESH;
+		record.texcoords = mesh->getTextureAttribute();
+		record.normals = mesh->getNormalAttribute();
 		break;
 	}
 	case GeometryType::SUBDIVISION_MESH:
+		record.kind = HitRecord::Kind::SUBDIVISION_MESH;
+		break;
+	case GeometryType::INSTANCE:
+		record.kind = HitRecord::Kind::INSTANCE;
+		break;
+	case GeometryType::DEFERRED:
+		record.kind = HitRecord::Kind::DEFERRED;
+		break;
+	default:
+		record.kind = HitRecord::Kind::OTHER;
+		break;
+	}
+	if (prim->getLight() != nullptr)
+	{
+		for (uint32_t i = 0; i < mLights.size(); i++)
+		{
+			if (mLights[i].get() == prim->getLight())
+			{
+				record.lightID = i;
+				break;
+			}
+		}
+	}
+	return record;
+}
+
+uint32_t Scene::addPrimitive(std::shared_ptr<RenderPrimitive> prim)
+{
+	markDynamic();
+	uint32_t geomID = static_cast<uint32_t>(mPrims.size());
+	mHitRecords.push_back(makeHitRecord(prim.get()));
+	mPrims.push_back(std::move(prim));
+	buildGeometry(mPrims.back()->getGeometry(), mSceneContext, geomID);
+	if (mHitRecords[geomID].kind == HitRecord::Kind::SUBDIVISION_MESH)
+	{
+		mHitRecords[geomID].embreeGeometry = rtcGetGeometry(mSceneContext, geomID);
+	}
+	return geomID;
+}
+
+void Scene::removePrimitive(uint32_t geomID)
+{
+	if (geomID >= mPrims.size() || !mPrims[geomID])
+	{
+		return;
+	}
+	markDynamic();
+	for (auto embreeID : getEmbreeIDs(geomID))
+	{
+		rtcDetachGeometry(mSceneContext, embreeID);
+		mHitRecords[embreeID] = HitRecord();
+	}
+	// Keep the slot so later geomIDs still index mPrims
+	mPrims[geomID].reset();
+	mHitRecords[geomID] = HitRecord();
+}
+
+void Scene::setPrimitiveEnabled(uint32_t geomID, bool enabled)
+{
+	if (geomID >= mPrims.size() || !mPrims[geomID])
+	{
+		return;
+	}
+	std::vector<uint32_t> embreeIDs = getEmbreeIDs(geomID);
+	if (embreeIDs.empty())
+	{
+		return;
+	}
+	markDynamic();
+	for (auto embreeID : embreeIDs)
+	{
+		RTCGeometry geom = rtcGetGeometry(mSceneContext, embreeID);
+		if (enabled)
+		{
+			rtcEnableGeometry(geom);
+		}
+		else
+		{
+			rtcDisableGeometry(geom);
+		}
+		rtcCommitGeometry(geom);
+	}
+}
+
+bool Scene::transformPrimitive(uint32_t geomID, const Transform &xform)
+{
+	if (geomID >= mPrims.size() || !mPrims[geomID])
 	{
-		buildSubdivisionMesh(static_cast<const SubdMesh*>(prim));
+		return false;
+	}
+	std::vector<uint32_t> embreeIDs = getEmbreeIDs(geomID);
+	Geometry* prim = mPrims[geomID]->getGeometry();
+	if (embreeIDs.empty() || prim == nullptr)
+	{
+		return false;
+	}
+	RTCGeometry geom = rtcGetGeometry(mSceneContext, embreeIDs.front());
+
+	switch (prim->primitiveType())
+	{
+	case GeometryType::POLYGONAL_MESH:
+	{
+		// Vertex buffers are shared with Embree, topology is unchanged
+		// so the BVH of the mesh is refitted rather than rebuilt
+		auto mesh = static_cast<PolyMesh*>(prim);
+		const MeshVertex* vertices = mesh->getVertexBuffer().data();
+		mesh->transform(xform);
+		if (mesh->getVertexBuffer().data() != vertices)
+		{
+			// Vertices viewed from a mesh cache are copied out on first edit
+			rtcSetSharedGeometryBuffer(geom, RTC_BUFFER_TYPE_VERTEX, 0,
+									   RTC_FORMAT_FLOAT3,
+									   mesh->getVertexBuffer().data(), 0,
+									   sizeof(MeshVertex),
+									   mesh->getVertexBuffer().size());
+		}
+		for (uint32_t i = 0; i < mesh->getTimeStepCount()
+			 && i < RTC_MAX_TIME_STEP_COUNT; i++)
+		{
+			rtcUpdateGeometryBuffer(geom, RTC_BUFFER_TYPE_VERTEX, i);
+		}
+		rtcSetGeometryBuildQuality(geom, RTC_BUILD_QUALITY_REFIT);
+		break;
+	}
+	case GeometryType::INSTANCE:
+	{
+		auto inst = static_cast<Instance*>(prim);
+		const Transform &cur = inst->getInstanceToWorld();
+		inst->setInstanceToWorld(Transform(xform.getMat() * cur.getMat(),
+										   cur.getInvMat() * xform.getInvMat()));
+		for (auto embreeID : embreeIDs)
+		{
+			const FlatInstance* flat = mHitRecords[embreeID].flatInstance;
+			setInstanceTransform(rtcGetGeometry(mSceneContext, embreeID),
+								 flat ? pathToWorld(flat->path) : inst->objectToWorld());
+		}
 		break;
 	}
+	default:
+		std::cout << "Primitive " << geomID
+			<< " can not be transformed after the scene is built." << std::endl;
+		return false;
+	}
+
+	markDynamic();
+	for (auto embreeID : embreeIDs)
+	{
+		rtcCommitGeometry(rtcGetGeometry(mSceneContext, embreeID));
+	}
+	return true;
+}
+
+std::vector<uint32_t> Scene::getEmbreeIDs(uint32_t geomID) const
+{
+	std::vector<uint32_t> embreeIDs;
+	if (rtcGetGeometry(mSceneContext, geomID) != nullptr)
+	{
+		embreeIDs.push_back(geomID);
+	}
+	for (auto &flat : mFlatInstances)
+	{
+		if (flat.ownerID == geomID)
+		{
+			embreeIDs.push_back(flat.geomID);
+		}
+	}
+	return embreeIDs;
+}
+
+void Scene::markDynamic()
+{
+	if (mIsDynamic)
+	{
+		return;
+	}
+	mIsDynamic = true;
+	// Low quality builds refit and rebuild faster between edits,
+	// a quality picked in the scene file is kept
+	if (mRenderOptions.buildQuality == AccelBuildQuality::DEFAULT)
+	{
+		rtcSetSceneBuildQuality(mSceneContext, RTC_BUILD_QUALITY_LOW);
+	}
+	rtcSetSceneFlags(mSceneContext, static_cast<RTCSceneFlags>(
+		rtcGetSceneFlags(mSceneContext) | RTC_SCENE_FLAG_DYNAMIC));
+}
+
+RTCGeometry Scene::newGeometry(const Geometry* prim, bool isTopLevel) const
+{
+	if (prim == nullptr)
+	{
+		return nullptr;
+	}
+	switch (prim->primitiveType())
+	{
+	case GeometryType::POLYGONAL_MESH:
+		return newPolygonalMesh(static_cast<const PolyMesh*>(prim));
+	case GeometryType::SUBDIVISION_MESH:
+		return newSubdivisionMesh(static_cast<const SubdMesh*>(prim), isTopLevel);
 	case GeometryType::CURVE:
+		return newCurve(static_cast<const Curve*>(prim));
+	default:
+		return nullptr;
+	}
+}
+
+void Scene::buildGeometry(const Geometry* prim, RTCScene scene, uint32_t geomID)
+{
+	if (prim == nullptr)
 	{
-		buildCurve(static_cast<const Curve*>(prim));
+		return;
+	}
+	RTCGeometry geom = newGeometry(prim, scene == mSceneContext);
+	if (geom != nullptr)
+	{
+		rtcAttachGeometryByID(scene, geom, geomID);
+		rtcReleaseGeometry(geom);
+		return;
+	}
+	switch (prim->primitiveType())
+	{
+	case GeometryType::PARAMATRIC_SURFACE:
+	{
+		buildUserGeomtry(static_cast<const ParametricGeomtry*>(prim), scene, geomID);
 		break;
 	}
 	case GeometryType::INSTANCE:
 	{
-		buildInstance(prim);
+		buildInstance(static_cast<const Instance*>(prim), scene, geomID);
+		break;
+	}
+	case GeometryType::DEFERRED:
+	{
+		buildDeferredGeometry(static_cast<const DeferredGeometry*>(prim), scene, geomID);
 		break;
 	}
 	default:
 	{
-		buildUserGeomtry(prim);
+		std::cout << "Unsupported geometry type, primitive is not traceable." << std::endl;
 		break;
 	}
 	}
 }
 
-void Scene::buildUserGeomtry(const Geometry* /*prim*/)
+void Scene::buildUserGeomtry(const ParametricGeomtry* prim, RTCScene scene, uint32_t geomID)
 {
-	// TODO
+	mUserGeometries.push_back(EmbreeUtils::UserGeometryData{ prim, geomID });
+	EmbreeUtils::UserGeometryData &data = mUserGeometries.back();
+
+	RTCGeometry userGeom = EmbreeUtils::newUserGeometry(mDevice, &data);
+	rtcCommitGeometry(userGeom);
+	rtcAttachGeometryByID(scene, userGeom, geomID);
+	rtcReleaseGeometry(userGeom);
 }
 
-void Scene::buildPolygonalMesh(const PolyMesh* prim)
+RTCGeometry Scene::newPolygonalMesh(const PolyMesh* prim) const
 {
 	TessBuffer buffer;
 	prim->getTessellated(buffer);
@@ -148,25 +653,22 @@ void Scene::buildPolygonalMesh(const PolyMesh* prim)
 		break;
 	}
 
-	RTCGeometry embreeMesh = rtcNewGeometry(EmbreeUtils::getDevice(), geomType);
+	RTCGeometry embreeMesh = rtcNewGeometry(mDevice, geomType);
 
-	rtcSetSharedGeometryBuffer(embreeMesh,
-							   RTC_BUFFER_TYPE_VERTEX,
-							   0,
-							   RTC_FORMAT_FLOAT3,
-							   buffer.vertTraits[0].data,
-							   buffer.vertTraits[0].byteOffset,
-							   buffer.vertTraits[0].byteStride,
-							   buffer.nVertices);
-	if (buffer.nTimeStep > 1)
+	// One vertex buffer slot per time step, Embree interpolates
+	// linearly between them with the ray time
+	uint32_t timeStepCount = static_cast<uint32_t>(
+		std::min(buffer.nTimeStep, static_cast<size_t>(RTC_MAX_TIME_STEP_COUNT)));
+	rtcSetGeometryTimeStepCount(embreeMesh, timeStepCount);
+	for (uint32_t i = 0; i < timeStepCount; i++)
 	{
 		rtcSetSharedGeometryBuffer(embreeMesh,
 								   RTC_BUFFER_TYPE_VERTEX,
-								   1,
+								   i,
 								   RTC_FORMAT_FLOAT3,
-								   buffer.vertTraits[1].data,
-								   buffer.vertTraits[1].byteOffset,
-								   buffer.vertTraits[1].byteStride,
+								   buffer.vertTraits[i].data,
+								   buffer.vertTraits[i].byteOffset,
+								   buffer.vertTraits[i].byteStride,
 								   buffer.nVertices);
 	}
 	rtcSetSharedGeometryBuffer(embreeMesh,
@@ -179,23 +681,212 @@ void Scene::buildPolygonalMesh(const PolyMesh* prim)
 							   buffer.nPrimtives);
 
 	rtcCommitGeometry(embreeMesh);
-	unsigned int geomID __attribute__((unused)) = rtcAttachGeometry(mSceneContext, embreeMesh);
-	rtcReleaseGeometry(embreeMesh);
+	return embreeMesh;
 }
 
-void Scene::buildSubdivisionMesh(const SubdMesh* /*prim*/)
+RTCGeometry Scene::newSubdivisionMesh(const SubdMesh* prim, bool isTopLevel) const
 {
-	// TODO
+	RTCGeometry embreeMesh = rtcNewGeometry(mDevice,
+											RTC_GEOMETRY_TYPE_SUBDIVISION);
+
+	const auto &verts = prim->getVertexBuffer();
+	const auto &indices = prim->getIndexBuffer();
+	const auto &faceSizes = prim->getFaceSizeBuffer();
+	rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+							   verts.data(), 0, sizeof(MeshVertex), verts.size());
+	rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+							   indices.data(), 0, sizeof(uint32_t), indices.size());
+	rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_FACE, 0, RTC_FORMAT_UINT,
+							   faceSizes.data(), 0, sizeof(uint32_t), faceSizes.size());
+
+	const auto &edgeCreases = prim->getEdgeCreaseIndices();
+	if (!edgeCreases.empty())
+	{
+		rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_EDGE_CREASE_INDEX, 0,
+								   RTC_FORMAT_UINT2, edgeCreases.data(),
+								   0, sizeof(uint32_t) * 2, edgeCreases.size() / 2);
+		rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_EDGE_CREASE_WEIGHT, 0,
+								   RTC_FORMAT_FLOAT, prim->getEdgeCreaseWeights().data(),
+								   0, sizeof(float), edgeCreases.size() / 2);
+	}
+	const auto &vertexCreases = prim->getVertexCreaseIndices();
+	if (!vertexCreases.empty())
+	{
+		rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_VERTEX_CREASE_INDEX, 0,
+								   RTC_FORMAT_UINT, vertexCreases.data(),
+								   0, sizeof(uint32_t), vertexCreases.size());
+		rtcSetSharedGeometryBuffer(embreeMesh, RTC_BUFFER_TYPE_VERTEX_CREASE_WEIGHT, 0,
+								   RTC_FORMAT_FLOAT, prim->getVertexCreaseWeights().data(),
+								   0, sizeof(float), vertexCreases.size());
+	}
+
+	// Screen space edge levels when the camera is known,
+	// uniform rate otherwise (and for prototypes seen through instances)
+	Point3f eye;
+	Float pixelAngle;
+	if (isTopLevel
+		&& mRenderOptions.subdivEdgeLength > 0
+		&& getPixelFootprint(eye, pixelAngle))
+	{
+		std::vector<float> levels;
+		prim->computeEdgeLevels(eye, pixelAngle, mRenderOptions.subdivEdgeLength, levels);
+		float* levelBuffer = static_cast<float*>(rtcSetNewGeometryBuffer(
+			embreeMesh, RTC_BUFFER_TYPE_LEVEL, 0, RTC_FORMAT_FLOAT,
+			sizeof(float), levels.size()));
+		std::copy(levels.begin(), levels.end(), levelBuffer);
+	}
+	else
+	{
+		rtcSetGeometryTessellationRate(embreeMesh,
+									   static_cast<float>(prim->getTessellationRate()));
+	}
+
+	rtcCommitGeometry(embreeMesh);
+	return embreeMesh;
 }
 
-void Scene::buildCurve(const Curve* /*prim*/)
+bool Scene::getPixelFootprint(Point3f &eye, Float &pixelAngle) const
 {
-	// TODO
+	if (mCamera == nullptr)
+	{
+		return false;
+	}
+	const Film &film = mCamera->getFilm();
+	Point2f center(film.width * static_cast<Float>(0.5),
+				   film.height * static_cast<Float>(0.5));
+	Ray centerRay, neighbourRay;
+	mCamera->generateRay(CameraSample{ center, Point2f(0.5, 0.5), 0 }, &centerRay);
+	mCamera->generateRay(CameraSample{ Point2f(center.x + 1, center.y),
+									   Point2f(0.5, 0.5), 0 }, &neighbourRay);
+	eye = centerRay.o;
+	// atan2 stays accurate for the tiny angles acos would lose
+	Vector3f d0 = normalize(centerRay.d), d1 = normalize(neighbourRay.d);
+	pixelAngle = std::atan2(cross(d0, d1).length(), dot(d0, d1));
+	return pixelAngle > 0;
 }
 
-void Scene::buildInstance(const Geometry* /*prim*/)
+RTCGeometry Scene::newCurve(const Curve* prim) const
 {
-	// TODO
+	// Round tubes for smooth strands, camera facing ribbons for polylines
+	RTCGeometryType geomType = prim->basis() == CurveBasis::BEZIER
+		? RTC_GEOMETRY_TYPE_ROUND_BEZIER_CURVE
+		: RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE;
+	RTCGeometry embreeCurve = rtcNewGeometry(mDevice, geomType);
+
+	const auto &verts = prim->getVertexBuffer();
+	const auto &indices = prim->getIndexBuffer();
+	rtcSetSharedGeometryBuffer(embreeCurve, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT4,
+							   verts.data(), 0, sizeof(CurveVertex), verts.size());
+	rtcSetSharedGeometryBuffer(embreeCurve, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+							   indices.data(), 0, sizeof(uint32_t), indices.size());
+
+	rtcCommitGeometry(embreeCurve);
+	return embreeCurve;
+}
+
+void Scene::buildInstance(const Instance* prim, RTCScene scene, uint32_t geomID)
+{
+	// Prototype scenes only hold instances that fit below their parent,
+	// deeper nesting is resolved at the top level
+	if (scene == mSceneContext && prim->getInstanceDepth() > sMaxInstanceLevel)
+	{
+		std::vector<const Instance*> path{ prim };
+		flattenInstance(geomID, path);
+		return;
+	}
+
+	RTCGeometry embreeInst = rtcNewGeometry(mDevice,
+											RTC_GEOMETRY_TYPE_INSTANCE);
+	rtcSetGeometryInstancedScene(embreeInst, getPrototypeScene(prim->getPrototype()));
+	setInstanceTransform(embreeInst, prim->objectToWorld());
+
+	rtcCommitGeometry(embreeInst);
+	rtcAttachGeometryByID(scene, embreeInst, geomID);
+	rtcReleaseGeometry(embreeInst);
+}
+
+void Scene::flattenInstance(uint32_t ownerID, std::vector<const Instance*> &path)
+{
+	const InstancePrototype* prototype = path.back()->getPrototype();
+	const auto &prims = prototype->getPrimitives();
+	bool hasPiece = std::any_of(prims.begin(), prims.end(), [](const std::shared_ptr<Geometry> &child)
+	{
+		return child->primitiveType() != GeometryType::INSTANCE;
+	});
+	if (hasPiece)
+	{
+		// The empty primitive slot keeps geomIDs equal to primitive indices
+		uint32_t pieceID = static_cast<uint32_t>(mPrims.size());
+		mFlatInstances.push_back(FlatInstance{ path, ownerID, pieceID });
+
+		RTCGeometry embreeInst = rtcNewGeometry(mDevice,
+												RTC_GEOMETRY_TYPE_INSTANCE);
+		rtcSetGeometryInstancedScene(embreeInst, getPrototypeScene(prototype, false));
+		setInstanceTransform(embreeInst, pathToWorld(path));
+		rtcCommitGeometry(embreeInst);
+		rtcAttachGeometryByID(mSceneContext, embreeInst, pieceID);
+		rtcReleaseGeometry(embreeInst);
+
+		HitRecord record = mHitRecords[ownerID];
+		record.kind = HitRecord::Kind::FLAT_INSTANCE;
+		record.flatInstance = &mFlatInstances.back();
+		mPrims.emplace_back();
+		mHitRecords.push_back(record);
+	}
+	for (auto &child : prims)
+	{
+		if (child->primitiveType() == GeometryType::INSTANCE)
+		{
+			path.push_back(static_cast<const Instance*>(child.get()));
+			flattenInstance(ownerID, path);
+			path.pop_back();
+		}
+	}
+}
+
+void Scene::buildDeferredGeometry(const DeferredGeometry* prim, RTCScene scene, uint32_t geomID)
+{
+	mDeferredGeometries.emplace_back();
+	EmbreeUtils::DeferredGeometryData &data = mDeferredGeometries.back();
+	data.prim = prim;
+	data.geomID = geomID;
+	data.device = mDevice;
+	data.newGeometry = [this, isTopLevel = scene == mSceneContext](const Geometry* loaded)
+	{
+		return newGeometry(loaded, isTopLevel);
+	};
+
+	RTCGeometry placeholder = EmbreeUtils::newDeferredGeometry(&data);
+	rtcCommitGeometry(placeholder);
+	rtcAttachGeometryByID(scene, placeholder, geomID);
+	rtcReleaseGeometry(placeholder);
+}
+
+RTCScene Scene::getPrototypeScene(const InstancePrototype* prototype,
+								  bool withInstances)
+{
+	// Without nested instances both variants are the same scene
+	withInstances = withInstances || prototype->getInstanceDepth() == 0;
+	auto &prototypeScenes = withInstances ? mPrototypeScenes : mFlatPrototypeScenes;
+	auto found = prototypeScenes.find(prototype);
+	if (found != prototypeScenes.end())
+	{
+		return found->second;
+	}
+
+	RTCScene prototypeScene = rtcNewScene(mDevice);
+	applySceneSettings(prototypeScene);
+	const auto &prims = prototype->getPrimitives();
+	for (uint32_t i = 0; i < prims.size(); i++)
+	{
+		if (withInstances || prims[i]->primitiveType() != GeometryType::INSTANCE)
+		{
+			buildGeometry(prims[i].get(), prototypeScene, i);
+		}
+	}
+	rtcCommitScene(prototypeScene);
+	prototypeScenes[prototype] = prototypeScene;
+	return prototypeScene;
 }
 
 }
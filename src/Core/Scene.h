@@ -1,36 +1,100 @@
 #pragma once
 #include <embree3/rtcore.h>
 
+#include "Core/EmbreeUtils.h"
 #include "Core/RenderPrimitive.h"
+#include "Core/RenderOptions.h"
+#include "Geometry/PrimitiveAttribute.h"
+#include "Tracer/RayBatch.h"
 
 namespace Kaguya
 {
 
+class Instance;
+class InstancePrototype;
+class DeferredGeometry;
+
+// Instances nested deeper than Embree traces are flattened: every prototype
+// on the way down is instanced at the top level with the composed transform.
+// Hits on a piece walk the same path back.
+struct FlatInstance
+{
+	// Top level instance first, the piece traces path.back()'s prototype
+	std::vector<const Instance*> path;
+	uint32_t                     ownerID;
+	uint32_t                     geomID;
+};
+
+// Everything the hit path needs about one top level geometry. Records are
+// stored flat by geomID, so resolving a hit reads a single entry.
+struct HitRecord
+{
+	enum class Kind : uint8_t
+	{
+		NONE,
+		TRIANGLE_MESH,
+		QUAD_MESH,
+		SUBDIVISION_MESH,
+		INSTANCE,
+		DEFERRED,
+		// Piece of an instance nested deeper than Embree traces
+		FLAT_INSTANCE,
+		OTHER
+	};
+	static const uint32_t sInvalidLightID = (uint32_t)(-1);
+
+	const Geometry*         geometry = nullptr;
+	const TextureAttribute* texcoords = nullptr;
+	const NormalAttribute*  normals = nullptr;
+	// Attached Embree geometry, kept for rtcInterpolate on subdivision hits
+	RTCGeometry             embreeGeometry = nullptr;
+	const FlatInstance*     flatInstance = nullptr;
+	uint32_t                lightID = sInvalidLightID;
+	Kind                    kind = Kind::NONE;
+};
+
 class Scene
 {
 public:
 	Scene();
 	Scene(std::shared_ptr<Camera> camera,
 		  std::vector<std::shared_ptr<RenderPrimitive>> prims,
-		  std::vector<std::shared_ptr<Light>> lights);
+		  std::vector<std::shared_ptr<Light>> lights,
+		  const RenderOptions &options = RenderOptions());
 	~Scene();
 
 	void commitScene();
 
-	/*void addPrimitive(std::shared_ptr<Geometry> &prim)
-	{
-		mPrims.push_back(prim);
-		buildGeometry(prim.get());
-	}*/
+	// Incremental edits for interactive use, only the touched Embree
+	// geometries are rebuilt and commitScene refits the rest.
+	// geomIDs of other primitives never change, removed slots stay empty.
+	uint32_t addPrimitive(std::shared_ptr<RenderPrimitive> prim);
+	void removePrimitive(uint32_t geomID);
+	void setPrimitiveEnabled(uint32_t geomID, bool enabled);
+	// Meshes are moved in place, instances get a new placement.
+	// false for primitive types that can not be transformed
+	bool transformPrimitive(uint32_t geomID, const Transform &xform);
 
-	void addLight(std::shared_ptr<Light> &light)
-	{
-		mLights.push_back(light);
-	}
+	void addLight(std::shared_ptr<Light> &light);
 
 	bool intersect(Ray &inRay, Intersection* isec) const;
+	// Closest hit of a whole ray stream, tFar of each hit ray is updated.
+	// Rays in a batch should be coherent (e.g. neighbour camera rays).
+	void intersect(RayBatch &rays, HitBatch &hits) const;
+	// Rebuild ray and shading information of one hit from a batch
+	bool resolveHit(const RayBatch &rays, const HitBatch &hits,
+					size_t index, Ray &ray, Intersection* isec) const;
+
+	// Any hit test between tMin and tMax, no shading information
+	bool occluded(const Ray &ray) const;
+	// Batched shadow rays, check the result with RayBatch::isOccluded
+	void occluded(RayBatch &rays) const;
 
 	RenderBufferTrait getRenderBuffer(uint32_t geomID) const;
+	const HitRecord& getHitRecord(uint32_t geomID) const
+	{
+		return mHitRecords[geomID];
+	}
 	size_t getPrimitiveCount() const
 	{
 		return mPrims.size();
@@ -54,21 +118,78 @@ public:
 		return mLights;
 	}
 
+	const RenderOptions& getRenderOptions() const
+	{
+		return mRenderOptions;
+	}
+
 private:
-	void buildGeometry(const Geometry* prim);
+	// Build quality and flags from the render options
+	void applySceneSettings(RTCScene scene) const;
+	// Geometries are attached to the given Embree scene, which is either
+	// the top level scene or the shared scene of an instance prototype
+	void buildGeometry(const Geometry* prim, RTCScene scene, uint32_t geomID);
+
+	// Committed but unattached geometry, safe to call from any thread.
+	// nullptr for types that must be built in order (user geometry, instances)
+	RTCGeometry newGeometry(const Geometry* prim, bool isTopLevel) const;
+	RTCGeometry newPolygonalMesh(const PolyMesh* prim) const;
+	RTCGeometry newSubdivisionMesh(const SubdMesh* prim, bool isTopLevel) const;
+	RTCGeometry newCurve(const Curve* prim) const;
+
+	void buildUserGeomtry(const ParametricGeomtry* prim, RTCScene scene, uint32_t geomID);
+	void buildInstance(const Instance* prim, RTCScene scene, uint32_t geomID);
+	// Add a piece for the prototype of path.back(), then recurse into
+	// its nested instances
+	void flattenInstance(uint32_t ownerID, std::vector<const Instance*> &path);
+	// Attached Embree geometries of a primitive, one per piece if flattened
+	std::vector<uint32_t> getEmbreeIDs(uint32_t geomID) const;
+	void buildDeferredGeometry(const DeferredGeometry* prim, RTCScene scene, uint32_t geomID);
+
+	HitRecord makeHitRecord(const RenderPrimitive* prim) const;
 
-	void buildUserGeomtry(const Geometry* prim);
-	void buildPolygonalMesh(const PolyMesh* prim);
-	void buildSubdivisionMesh(const SubdMesh* prim);
-	void buildCurve(const Curve* prim);
-	void buildInstance(const Geometry* prim);
+	// Switch the top level scene to refit friendly settings on first edit
+	void markDynamic();
+
+	// Eye position and angle covered by a pixel at the image center,
+	// false without a camera
+	bool getPixelFootprint(Point3f &eye, Float &pixelAngle) const;
+
+	// Embree scene of a prototype, built on first use. Flattened instances
+	// use a variant without the nested instances, placed as pieces instead
+	RTCScene getPrototypeScene(const InstancePrototype* prototype,
+							   bool withInstances = true);
+
+	// Fill shading information of the hit primitive, walking down instances
+	void postIntersect(Ray &ray, Intersection* isec) const;
+	void postIntersectInstance(const Instance* inst, uint32_t level,
+							   const Ray &ray, Intersection* isec) const;
+	void postIntersectFlatInstance(const FlatInstance* flat,
+								   const Ray &ray, Intersection* isec) const;
 
 private:
+	// Device of this scene, every Embree object of the scene is made on it
+	RTCDevice                                      mDevice;
 	RTCScene                                       mSceneContext;
 
 	std::shared_ptr<Camera>                        mCamera;
 	std::vector<std::shared_ptr<RenderPrimitive>>  mPrims;
+	std::vector<HitRecord>                         mHitRecords;
 	std::vector<std::shared_ptr<Light>>            mLights;
+
+	RenderOptions                                  mRenderOptions;
+
+	// Stable storage for Embree user geometry callbacks
+	std::deque<EmbreeUtils::UserGeometryData>      mUserGeometries;
+	std::deque<EmbreeUtils::DeferredGeometryData>  mDeferredGeometries;
+
+	// One Embree scene per prototype, shared by all its instances
+	std::unordered_map<const InstancePrototype*, RTCScene> mPrototypeScenes;
+	std::unordered_map<const InstancePrototype*, RTCScene> mFlatPrototypeScenes;
+	// Pieces of flattened instances, their geomIDs follow the primitives
+	std::deque<FlatInstance>                       mFlatInstances;
+
+	bool                                           mIsDynamic = false;
 };
 
 }
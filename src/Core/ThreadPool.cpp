@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+
+namespace Kaguya
+{
+
+// Identifies the pool and queue owned by the current worker thread
+static thread_local const ThreadPool* sCurrentPool = nullptr;
+static thread_local uint32_t          sWorkerIndex = 0;
+
+thread_local uint32_t SerialScope::sDepth = 0;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+	: mQueuedCount(0)
+	, mNextQueue(0)
+	, mStop(false)
+{
+	if (threadCount == 0)
+	{
+		// The thread calling wait() also runs tasks, so leave it one core
+		uint32_t hwCount = std::thread::hardware_concurrency();
+		threadCount = hwCount > 1 ? hwCount - 1 : 1;
+	}
+
+	mQueues.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		mQueues.emplace_back(std::make_unique<WorkQueue>());
+	}
+	mWorkers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		mWorkers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mStop = true;
+	}
+	mWakeCondition.notify_all();
+	for (auto &worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::run(TaskGroup &group, Task task)
+{
+	group.mPendingCount.fetch_add(1, std::memory_order_relaxed);
+
+	// Workers keep spawned tasks local, other threads distribute round-robin
+	uint32_t queueIndex = sCurrentPool == this
+		? sWorkerIndex
+		: mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+	{
+		WorkQueue &queue = *mQueues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.items.push_back(WorkItem{ std::move(task), &group });
+	}
+	mQueuedCount.fetch_add(1, std::memory_order_release);
+
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+	}
+	mWakeCondition.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup &group)
+{
+	uint32_t queueIndex = sCurrentPool == this
+		? sWorkerIndex : static_cast<uint32_t>(mQueues.size());
+	while (!group.isDone())
+	{
+		WorkItem item;
+		if (popWork(queueIndex, item))
+		{
+			execute(item);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+ThreadPool &ThreadPool::global()
+{
+	static ThreadPool sGlobalPool;
+	return sGlobalPool;
+}
+
+bool ThreadPool::popWork(uint32_t queueIndex, WorkItem &item)
+{
+	if (mQueuedCount.load(std::memory_order_acquire) == 0)
+	{
+		return false;
+	}
+	size_t queueCount = mQueues.size();
+	// Newest task from our own queue first
+	if (queueIndex < queueCount)
+	{
+		WorkQueue &queue = *mQueues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.items.empty())
+		{
+			item = std::move(queue.items.back());
+			queue.items.pop_back();
+			mQueuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	// Otherwise steal the oldest task from a victim
+	for (size_t i = 1; i <= queueCount; i++)
+	{
+		WorkQueue &queue = *mQueues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.items.empty())
+		{
+			item = std::move(queue.items.front());
+			queue.items.pop_front();
+			mQueuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::execute(WorkItem &item)
+{
+	item.task();
+	item.group->mPendingCount.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex)
+{
+	sCurrentPool = this;
+	sWorkerIndex = workerIndex;
+
+	while (true)
+	{
+		WorkItem item;
+		if (popWork(workerIndex, item))
+		{
+			execute(item);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mWakeCondition.wait(lock, [this]()
+		{
+			return mStop || mQueuedCount.load(std::memory_order_acquire) > 0;
+		});
+		if (mStop && mQueuedCount.load(std::memory_order_acquire) == 0)
+		{
+			return;
+		}
+	}
+}
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "Core/Kaguya.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Kaguya
+{
+
+// Tracks a set of tasks so the caller can wait on exactly those tasks.
+// Waiting is allowed from inside another task.
+class TaskGroup
+{
+public:
+	TaskGroup() : mPendingCount(0) {}
+	TaskGroup(const TaskGroup &) = delete;
+	TaskGroup &operator=(const TaskGroup &) = delete;
+
+	bool isDone() const
+	{
+		return mPendingCount.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	std::atomic<size_t> mPendingCount;
+
+	friend class ThreadPool;
+};
+
+// Work-stealing thread pool.
+// Each worker owns a task deque: it pops new work from the back of its own
+// queue and steals the oldest work from the front of the others.
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	// threadCount == 0 picks one worker per hardware thread but one,
+	// the calling thread makes up the last one by helping in wait()
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	void run(TaskGroup &group, Task task);
+	// Blocks until every task of the group finished.
+	// The calling thread executes pending tasks while it waits.
+	void wait(TaskGroup &group);
+
+	uint32_t getThreadCount() const
+	{
+		return static_cast<uint32_t>(mWorkers.size());
+	}
+
+	// Shared pool used by the renderer and the loaders
+	static ThreadPool &global();
+
+private:
+	struct WorkItem
+	{
+		Task       task;
+		TaskGroup* group;
+	};
+	struct WorkQueue
+	{
+		std::mutex           mutex;
+		std::deque<WorkItem> items;
+	};
+
+	bool popWork(uint32_t queueIndex, WorkItem &item);
+	void execute(WorkItem &item);
+	void workerLoop(uint32_t workerIndex);
+
+private:
+	std::vector<std::thread>                mWorkers;
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+
+	std::mutex                              mSleepMutex;
+	std::condition_variable                 mWakeCondition;
+	std::atomic<size_t>                     mQueuedCount;
+	std::atomic<uint32_t>                   mNextQueue;
+	bool                                    mStop;
+};
+
+// While alive, parallelFor on this thread runs its loop inline. For work
+// other threads block on, it must not pick up pool tasks that could end
+// up waiting on the very same work.
+class SerialScope
+{
+public:
+	SerialScope() { sDepth++; }
+	~SerialScope() { sDepth--; }
+
+	SerialScope(const SerialScope &) = delete;
+	SerialScope &operator=(const SerialScope &) = delete;
+
+	static bool isActive() { return sDepth > 0; }
+
+private:
+	static thread_local uint32_t sDepth;
+};
+
+// Split [begin, end) into chunks of grainSize indices and run them on the pool.
+template <typename Func>
+void parallelFor(size_t begin, size_t end, Func &&func,
+				 size_t grainSize = 1,
+				 ThreadPool &pool = ThreadPool::global())
+{
+	if (begin >= end)
+	{
+		return;
+	}
+	if (SerialScope::isActive())
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			func(i);
+		}
+		return;
+	}
+	grainSize = std::max(grainSize, (size_t)1);
+	TaskGroup group;
+	for (size_t chunkStart = begin; chunkStart < end; chunkStart += grainSize)
+	{
+		size_t chunkEnd = std::min(chunkStart + grainSize, end);
+		pool.run(group, [&func, chunkStart, chunkEnd]()
+		{
+			for (size_t i = chunkStart; i < chunkEnd; i++)
+			{
+				func(i);
+			}
+		});
+	}
+	pool.wait(group);
+}
+
+}
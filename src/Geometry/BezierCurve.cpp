@@ -3,14 +3,64 @@
 namespace Kaguya
 {
 
-BezierCurve::BezierCurve()
+BezierCurve::BezierCurve(const std::vector<CurveVertex> &points,
+						 const std::vector<uint32_t>    &strandSizes)
+	: Curve(3)
 {
+	size_t segmentCount = 0;
+	for (auto strandSize : strandSizes)
+	{
+		segmentCount += strandSize > 1 ? strandSize - 1 : 0;
+	}
+	mVertexBuffer.reserve(segmentCount * 3 + strandSizes.size());
+	mIndexBuffer.reserve(segmentCount);
 
+	auto lerp = [](const CurveVertex &v0, const CurveVertex &v1, Float t)
+	{
+		return CurveVertex(v0.position() + (v1.position() - v0.position()) * t,
+						   v0.r + (v1.r - v0.r) * t);
+	};
+	uint32_t strandOffset = 0;
+	for (auto strandSize : strandSizes)
+	{
+		const CurveVertex* p = points.data() + strandOffset;
+		strandOffset += strandSize;
+		if (strandSize < 2)
+		{
+			continue;
+		}
+		// Mirror the end points to get the tangents at both ends
+		auto point = [p, strandSize, &lerp](int32_t i)
+		{
+			if (i < 0)
+			{
+				return lerp(p[1], p[0], 2);
+			}
+			if (i >= static_cast<int32_t>(strandSize))
+			{
+				return lerp(p[strandSize - 2], p[strandSize - 1], 2);
+			}
+			return p[i];
+		};
+		mVertexBuffer.push_back(p[0]);
+		for (int32_t i = 0; i + 1 < static_cast<int32_t>(strandSize); i++)
+		{
+			CurveVertex prev = point(i - 1), next = point(i + 2);
+			mIndexBuffer.push_back(static_cast<uint32_t>(mVertexBuffer.size() - 1));
+			mVertexBuffer.emplace_back(
+				p[i].position() + (p[i + 1].position() - prev.position()) / static_cast<Float>(6),
+				std::max(p[i].r + (p[i + 1].r - prev.r) / 6.f, 0.f));
+			mVertexBuffer.emplace_back(
+				p[i + 1].position() - (next.position() - p[i].position()) / static_cast<Float>(6),
+				std::max(p[i + 1].r - (next.r - p[i].r) / 6.f, 0.f));
+			mVertexBuffer.push_back(p[i + 1]);
+		}
+	}
+	bounding();
 }
 
 BezierCurve::~BezierCurve()
 {
-
 }
 
 }
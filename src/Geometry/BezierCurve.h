@@ -4,14 +4,18 @@
 namespace Kaguya
 {
 
+// Cubic Bezier segments, consecutive segments of a strand share
+// their end point
 class BezierCurve : public Curve
 {
 public:
-	BezierCurve();
+	// Interpolate polyline strands with Catmull-Rom splines,
+	// strandSizes holds the point count of each strand
+	BezierCurve(const std::vector<CurveVertex> &points,
+				const std::vector<uint32_t>    &strandSizes);
 	~BezierCurve();
-protected:
 
-private:
+	CurveBasis basis() const override { return CurveBasis::BEZIER; }
 };
 
 }
@@ -0,0 +1,216 @@
+#pragma once
+#include "Geometry/PrimitiveAttribute.h"
+
+namespace Kaguya
+{
+
+// Unit normals in 32 bits, octahedral mapping with two 16 bit snorms
+struct OctahedralNormalCodec
+{
+	typedef uint32_t Encoded;
+
+	void fit(const std::vector<Normal3f> &/*values*/) {}
+
+	Encoded encode(const Normal3f &n) const
+	{
+		Float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (l1 == 0)
+		{
+			return quantize(0) | quantize(0) << 16;
+		}
+		Float u = n.x / l1;
+		Float v = n.y / l1;
+		// Lower hemisphere is folded over the diagonals
+		if (n.z < 0)
+		{
+			Float fu = (1 - std::abs(v)) * signNotZero(u);
+			Float fv = (1 - std::abs(u)) * signNotZero(v);
+			u = fu;
+			v = fv;
+		}
+		return quantize(u) | quantize(v) << 16;
+	}
+	Normal3f decode(Encoded code) const
+	{
+		Float u = static_cast<int16_t>(code & 0xffff) / Float(32767);
+		Float v = static_cast<int16_t>(code >> 16) / Float(32767);
+		Normal3f n(u, v, 1 - std::abs(u) - std::abs(v));
+		if (n.z < 0)
+		{
+			n.x = (1 - std::abs(v)) * signNotZero(u);
+			n.y = (1 - std::abs(u)) * signNotZero(v);
+		}
+		return normalize(n);
+	}
+
+private:
+	static Float signNotZero(Float f)
+	{
+		return f < 0 ? Float(-1) : Float(1);
+	}
+	static uint32_t quantize(Float f)
+	{
+		f = std::min(std::max(f, Float(-1)), Float(1));
+		return static_cast<uint16_t>(static_cast<int16_t>(std::round(f * 32767)));
+	}
+};
+
+// Texture coordinates as two 16 bit unorms over the bounds of the set
+struct QuantizedUVCodec
+{
+	typedef uint32_t Encoded;
+
+	void fit(const std::vector<Point2f> &values)
+	{
+		if (values.empty())
+		{
+			return;
+		}
+		Point2f pMin = values.front();
+		Point2f pMax = values.front();
+		for (auto &uv : values)
+		{
+			pMin = Point2f(std::min(pMin.x, uv.x), std::min(pMin.y, uv.y));
+			pMax = Point2f(std::max(pMax.x, uv.x), std::max(pMax.y, uv.y));
+		}
+		mMin = pMin;
+		mExtentX = pMax.x - pMin.x;
+		mExtentY = pMax.y - pMin.y;
+	}
+
+	Encoded encode(const Point2f &uv) const
+	{
+		return quantize(uv.x - mMin.x, mExtentX)
+			| quantize(uv.y - mMin.y, mExtentY) << 16;
+	}
+	Point2f decode(Encoded code) const
+	{
+		return Point2f(mMin.x + (code & 0xffff) * mExtentX / Float(65535),
+					   mMin.y + (code >> 16) * mExtentY / Float(65535));
+	}
+
+private:
+	static uint32_t quantize(Float offset, Float extent)
+	{
+		return extent > 0
+			? static_cast<uint32_t>(std::round(offset / extent * 65535)) : 0;
+	}
+
+	Point2f mMin;
+	Float   mExtentX = 0;
+	Float   mExtentY = 0;
+};
+
+// Read only copy of an AttributeRate with encoded values and 16 bit
+// indices when they fit, values are decoded per hit
+template <typename T, typename Codec>
+class CompactAttributeRate
+{
+public:
+	CompactAttributeRate(const AttributeRate<T> &attri)
+		: mType(attri.mType)
+	{
+		encodeValues(attri.mValueBuffer);
+		mHasShortIndices = attri.mValueBuffer.size() <= 0x10000;
+		if (mHasShortIndices)
+		{
+			mShortIndexBuffer.assign(attri.mIndexBuffer.begin(),
+									 attri.mIndexBuffer.end());
+		}
+		else
+		{
+			mIndexBuffer = attri.mIndexBuffer;
+		}
+	}
+
+	// Same contract as AttributeRate::getCornerValues
+	bool getCornerValues(uint32_t primID, size_t primSize,
+						 const uint32_t* vIDs, T* targ) const
+	{
+		if (mValueBuffer.empty())
+		{
+			return false;
+		}
+		switch (mType)
+		{
+		case AttributeType::VERTEX_VARYING:
+		{
+			for (size_t i = 0; i < primSize; i++)
+			{
+				targ[i] = mCodec.decode(mValueBuffer[vIDs[i]]);
+			}
+			return true;
+		}
+		case AttributeType::FACE_VARYING:
+		{
+			size_t first = primID * primSize;
+			for (size_t i = 0; i < primSize; i++)
+			{
+				uint32_t id = mHasShortIndices
+					? mShortIndexBuffer[first + i] : mIndexBuffer[first + i];
+				targ[i] = mCodec.decode(mValueBuffer[id]);
+			}
+			return true;
+		}
+		case AttributeType::UNIFORM:
+		{
+			if (primID >= mValueBuffer.size())
+			{
+				return false;
+			}
+			std::fill(targ, targ + primSize, mCodec.decode(mValueBuffer[primID]));
+			return true;
+		}
+		case AttributeType::CONSTANT:
+		{
+			std::fill(targ, targ + primSize, mCodec.decode(mValueBuffer.front()));
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	// Decode, modify and encode every value again
+	template <typename Func>
+	void transformValues(Func &&func)
+	{
+		std::vector<T> values(mValueBuffer.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			values[i] = func(mCodec.decode(mValueBuffer[i]));
+		}
+		encodeValues(values);
+	}
+
+	// Size in bytes
+	size_t getByteSize() const
+	{
+		return sizeof(typename Codec::Encoded) * mValueBuffer.size()
+			+ sizeof(uint16_t) * mShortIndexBuffer.size()
+			+ sizeof(uint32_t) * mIndexBuffer.size();
+	}
+
+private:
+	void encodeValues(const std::vector<T> &values)
+	{
+		mCodec.fit(values);
+		mValueBuffer.resize(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			mValueBuffer[i] = mCodec.encode(values[i]);
+		}
+	}
+
+	Codec                                mCodec;
+	std::vector<typename Codec::Encoded> mValueBuffer;
+	std::vector<uint16_t>                mShortIndexBuffer;
+	std::vector<uint32_t>                mIndexBuffer;
+	bool                                 mHasShortIndices;
+	AttributeType                        mType;
+};
+
+using CompactTextureAttribute = CompactAttributeRate<Point2f, QuantizedUVCodec>;
+using CompactNormalAttribute = CompactAttributeRate<Normal3f, OctahedralNormalCodec>;
+
+}
@@ -1,9 +1,24 @@
 #include "Curve.h"
+#include "Core/Utils.h"
+#include "Geometry/BezierCurve.h"
+#include "IO/ObjLoader.h"
+#include "Math/RNG.h"
+#include "Tracer/Ray.h"
 
 namespace Kaguya
 {
 
-Curve::Curve()
+Curve::Curve(std::vector<CurveVertex> vertexBuffer,
+			 std::vector<uint32_t>    indexBuffer)
+	: mVertexBuffer(std::move(vertexBuffer))
+	, mIndexBuffer(std::move(indexBuffer))
+	, degree(1)
+{
+	bounding();
+}
+
+Curve::Curve(uint8_t curveDegree)
+	: degree(curveDegree)
 {
 }
 
@@ -11,4 +26,229 @@ Curve::~Curve()
 {
 }
 
+void Curve::bounding()
+{
+	if (mVertexBuffer.empty())
+	{
+		return;
+	}
+	// Curves stay inside the hull of their control points
+	mObjBound = Bounds3f(mVertexBuffer.front().position());
+	Float maxRadius = 0;
+	for (auto &v : mVertexBuffer)
+	{
+		mObjBound.Union(v.position());
+		maxRadius = std::max(maxRadius, static_cast<Float>(v.r));
+	}
+	mObjBound.expand(maxRadius);
+}
+
+bool Curve::intersect(const Ray &/*inRay*/,
+					  Intersection* /*isec*/,
+					  Float* /*tHit*/,
+					  Float* /*rayEpsilon*/) const
+{
+	return false;
+}
+
+void Curve::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	// u is the parameter along the segment, v across it
+	isec->mPos = inRay(inRay.tMax);
+	isec->mGeomN = inRay.Ng;
+	isec->mUV = { inRay.u, inRay.v };
+}
+
+void Curve::getRenderBuffer(RenderBufferTrait* trait) const
+{
+	trait->renderType = GPURenderType::CURVE;
+
+	trait->vertex.data = (void*)(mVertexBuffer.data());
+	trait->vertex.count = mVertexBuffer.size();
+	trait->vertex.size = sizeof(CurveVertex) * trait->vertex.count;
+	trait->vertex.offset = 0;
+	trait->vertex.stride = sizeof(CurveVertex);
+
+	trait->index.data = (void*)(mIndexBuffer.data());
+	trait->index.count = mIndexBuffer.size();
+	trait->index.size = sizeof(uint32_t) * trait->index.count;
+	trait->index.offset = 0;
+	trait->index.stride = sizeof(uint32_t);
+}
+
+namespace curveFileParser
+{
+
+// http://www.cemyuksel.com/research/hairmodels/
+struct HairFileHeader
+{
+	char     signature[4];
+	uint32_t hairCount;
+	uint32_t pointCount;
+	uint32_t arrays;
+	uint32_t defaultSegments;
+	float    defaultThickness;
+	float    defaultTransparency;
+	float    defaultColor[3];
+	char     info[88];
+};
+static_assert(sizeof(HairFileHeader) == 128, "Hair file header is 128 bytes");
+
+enum HairArrays : uint32_t
+{
+	SEGMENTS = 1 << 0,
+	POINTS = 1 << 1,
+	THICKNESS = 1 << 2
+};
+
+// Points carry their diameter in r until the strands are built
+bool parseHair(const char*               filename,
+			   std::vector<CurveVertex> &points,
+			   std::vector<uint32_t>    &strandSizes)
+{
+	std::FILE* fp = std::fopen(filename, "rb");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	HairFileHeader header;
+	if (std::fread(&header, sizeof(HairFileHeader), 1, fp) != 1
+		|| strncmp(header.signature, "HAIR", 4) != 0
+		|| !(header.arrays & POINTS))
+	{
+		fclose(fp);
+		return false;
+	}
+
+	strandSizes.resize(header.hairCount, header.defaultSegments + 1);
+	if (header.arrays & SEGMENTS)
+	{
+		std::vector<uint16_t> segments(header.hairCount);
+		std::fread(segments.data(), sizeof(uint16_t), segments.size(), fp);
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			strandSizes[i] = segments[i] + 1u;
+		}
+	}
+
+	std::vector<float> pos(header.pointCount * 3);
+	if (std::fread(pos.data(), sizeof(float), pos.size(), fp) != pos.size())
+	{
+		fclose(fp);
+		return false;
+	}
+	points.resize(header.pointCount);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i].x = pos[i * 3];
+		points[i].y = pos[i * 3 + 1];
+		points[i].z = pos[i * 3 + 2];
+		points[i].r = header.defaultThickness;
+	}
+	if (header.arrays & THICKNESS)
+	{
+		std::vector<float> thickness(header.pointCount);
+		std::fread(thickness.data(), sizeof(float), thickness.size(), fp);
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			points[i].r = thickness[i];
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// Polylines of an OBJ file, every "l" element is a strand
+bool parseObj(const char*               filename,
+			  std::vector<CurveVertex> &points,
+			  std::vector<uint32_t>    &strandSizes)
+{
+	ObjBuffers buffers;
+	if (!ObjLoader::loadRawBuffers(buffers, filename))
+	{
+		return false;
+	}
+	points.reserve(buffers.lineIndexBuffer.size());
+	for (auto index : buffers.lineIndexBuffer)
+	{
+		if (index >= buffers.vertexBuffer.size())
+		{
+			return false;
+		}
+		points.emplace_back(toPoint3f(buffers.vertexBuffer[index]), 0);
+	}
+	strandSizes = std::move(buffers.lineSizeBuffer);
+	return true;
+}
+
+}
+
+std::shared_ptr<Curve> createCurves(const std::string &filename,
+									const CurveLoadOptions &options)
+{
+	std::vector<CurveVertex> points;
+	std::vector<uint32_t> strandSizes;
+	bool isLoaded = false;
+	if (Utils::endsWith(filename, "hair", false))
+	{
+		isLoaded = curveFileParser::parseHair(filename.c_str(), points, strandSizes);
+	}
+	else if (Utils::endsWith(filename, "obj", false))
+	{
+		isLoaded = curveFileParser::parseObj(filename.c_str(), points, strandSizes);
+	}
+	size_t pointCount = 0;
+	for (auto strandSize : strandSizes)
+	{
+		pointCount += strandSize;
+	}
+	if (!isLoaded || pointCount > points.size())
+	{
+		return nullptr;
+	}
+
+	// Drop strands and turn diameters into radii in place,
+	// so only the final strands are ever converted
+	RNG rng(0);
+	size_t srcOffset = 0, dstOffset = 0, dstStrand = 0;
+	for (auto strandSize : strandSizes)
+	{
+		size_t offset = srcOffset;
+		srcOffset += strandSize;
+		if (options.subsample < 1 && rng.uniformFloat() >= options.subsample)
+		{
+			continue;
+		}
+		for (uint32_t i = 0; i < strandSize; i++)
+		{
+			CurveVertex v = points[offset + i];
+			Float diameter = options.thickness > 0 ? options.thickness : v.r;
+			Float scale = options.taper && strandSize > 1
+				? 1 - static_cast<Float>(i) / (strandSize - 1) : 1;
+			points[dstOffset++] = CurveVertex(v.position(), diameter * static_cast<Float>(0.5) * scale);
+		}
+		strandSizes[dstStrand++] = strandSize;
+	}
+	points.resize(dstOffset);
+	strandSizes.resize(dstStrand);
+
+	if (options.basis == CurveBasis::BEZIER)
+	{
+		return std::make_shared<BezierCurve>(points, strandSizes);
+	}
+
+	std::vector<uint32_t> indexBuffer;
+	indexBuffer.reserve(points.size());
+	uint32_t strandOffset = 0;
+	for (auto strandSize : strandSizes)
+	{
+		for (uint32_t i = 0; i + 1 < strandSize; i++)
+		{
+			indexBuffer.push_back(strandOffset + i);
+		}
+		strandOffset += strandSize;
+	}
+	return std::make_shared<Curve>(std::move(points), std::move(indexBuffer));
+}
+
 }
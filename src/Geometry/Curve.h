@@ -4,15 +4,85 @@
 namespace Kaguya
 {
 
+enum class CurveBasis : uint8_t
+{
+	LINEAR,
+	BEZIER
+};
+
+// Control point and curve radius, single precision in every build
+// as it is shared with Embree as RTC_FORMAT_FLOAT4
+struct CurveVertex
+{
+	CurveVertex() : x(0), y(0), z(0), r(0) {}
+	CurveVertex(const Point3f &pos, Float radius)
+		: x(static_cast<float>(pos.x))
+		, y(static_cast<float>(pos.y))
+		, z(static_cast<float>(pos.z))
+		, r(static_cast<float>(radius))
+	{
+	}
+
+	Point3f position() const { return Point3f(x, y, z); }
+
+	float x, y, z, r;
+};
+static_assert(sizeof(CurveVertex) == 16, "Curve vertices are four floats");
+
+// Hair strands made of curve segments.
+// Each index is the first control point of a segment, which uses
+// degree + 1 consecutive control points. Curve itself is linear.
 class Curve : public Geometry
 {
 public:
-	Curve();
+	Curve(std::vector<CurveVertex> vertexBuffer,
+		  std::vector<uint32_t>    indexBuffer);
 	virtual ~Curve();
 
+	GeometryType primitiveType() const override
+	{
+		return GeometryType::CURVE;
+	}
+
+	void bounding() override;
+
+	// Curves are only traced through Embree
+	bool intersect(const Ray &inRay,
+				   Intersection* isec,
+				   Float* tHit,
+				   Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
+
+	void getRenderBuffer(RenderBufferTrait* trait) const override;
+
+	virtual CurveBasis basis() const { return CurveBasis::LINEAR; }
+	uint8_t getDegree() const { return degree; }
+
+	const std::vector<CurveVertex> &getVertexBuffer() const { return mVertexBuffer; }
+	const std::vector<uint32_t> &getIndexBuffer() const { return mIndexBuffer; }
+
+protected:
+	Curve(uint8_t curveDegree);
+
 protected:
-	std::vector<Point3f> verts;
-	uint8_t              degree;
+	std::vector<CurveVertex> mVertexBuffer;
+	std::vector<uint32_t>    mIndexBuffer;
+	uint8_t                  degree;
 };
 
+struct CurveLoadOptions
+{
+	CurveBasis basis = CurveBasis::BEZIER;
+	// Diameter, overrides the file thickness when positive
+	Float      thickness = 0;
+	// Shrink the radius linearly to zero at the tip of each strand
+	bool       taper = false;
+	// Fraction of strands kept, picked with a fixed seed
+	Float      subsample = 1;
+};
+
+// Load strands from a Cem Yuksel .hair file or from OBJ polylines ("l")
+std::shared_ptr<Curve> createCurves(const std::string &filename,
+									const CurveLoadOptions &options = CurveLoadOptions());
+
 }
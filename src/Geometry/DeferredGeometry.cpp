@@ -0,0 +1,73 @@
+#include "DeferredGeometry.h"
+#include "Core/ThreadPool.h"
+#include "Tracer/Ray.h"
+
+namespace Kaguya
+{
+
+DeferredGeometry::DeferredGeometry(const Bounds3f &bounds, Loader loader)
+	: Geometry(nullptr)
+	, mLoader(std::move(loader))
+	, mIsLoaded(false)
+{
+	mObjBound = bounds;
+}
+
+const Geometry* DeferredGeometry::load() const
+{
+	std::call_once(mLoadFlag, [this]()
+	{
+		// Loads usually start from a render task, the loader must not
+		// run other tasks that may be waiting on this load
+		SerialScope serial;
+		mGeometry = mLoader();
+		mLoader = nullptr;
+		if (mGeometry == nullptr)
+		{
+			std::cout << "Failed to load deferred geometry " << mGeomName << std::endl;
+		}
+		mIsLoaded.store(true, std::memory_order_release);
+	});
+	return mGeometry.get();
+}
+
+bool DeferredGeometry::intersect(const Ray &inRay,
+								 Intersection* isec,
+								 Float* tHit,
+								 Float* rayEpsilon) const
+{
+	if (!mObjBound.intersectP(inRay))
+	{
+		return false;
+	}
+	const Geometry* prim = load();
+	return prim && prim->intersect(inRay, isec, tHit, rayEpsilon);
+}
+
+bool DeferredGeometry::intersectP(const Ray &inRay) const
+{
+	if (!mObjBound.intersectP(inRay))
+	{
+		return false;
+	}
+	const Geometry* prim = load();
+	return prim && prim->intersectP(inRay);
+}
+
+void DeferredGeometry::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	if (const Geometry* prim = getGeometry())
+	{
+		prim->postIntersect(inRay, isec);
+	}
+}
+
+void DeferredGeometry::getRenderBuffer(RenderBufferTrait* trait) const
+{
+	if (const Geometry* prim = getGeometry())
+	{
+		prim->getRenderBuffer(trait);
+	}
+}
+
+}
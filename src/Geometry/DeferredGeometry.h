@@ -0,0 +1,55 @@
+#pragma once
+#include "Geometry/Geometry.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace Kaguya
+{
+
+// Stand-in for a geometry loaded the first time it is needed. Its bounds
+// are known up front, the tracer loads it once a ray reaches them.
+class DeferredGeometry : public Geometry
+{
+public:
+	typedef std::function<std::shared_ptr<Geometry>()> Loader;
+
+	DeferredGeometry(const Bounds3f &bounds, Loader loader);
+
+	// Bounds are given, not computed
+	void bounding() override {}
+
+	bool intersect(const Ray &inRay,
+				   Intersection* isec,
+				   Float* tHit,
+				   Float* rayEpsilon) const override;
+	bool intersectP(const Ray &inRay) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
+
+	GeometryType primitiveType() const override
+	{
+		return GeometryType::DEFERRED;
+	}
+
+	// Empty until loaded, the preview does not trigger loading
+	void getRenderBuffer(RenderBufferTrait* trait) const override;
+
+	// Loads on first call, later and concurrent calls wait for that load.
+	// nullptr when loading failed.
+	const Geometry* load() const;
+	bool isLoaded() const { return mIsLoaded.load(std::memory_order_acquire); }
+	// Loaded geometry, nullptr before load() returned
+	const Geometry* getGeometry() const
+	{
+		return isLoaded() ? mGeometry.get() : nullptr;
+	}
+
+private:
+	mutable Loader                    mLoader;
+	mutable std::once_flag            mLoadFlag;
+	mutable std::shared_ptr<Geometry> mGeometry;
+	mutable std::atomic<bool>         mIsLoaded;
+};
+
+}
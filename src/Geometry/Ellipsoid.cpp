@@ -1,4 +1,5 @@
 #include "Ellipsoid.h"
+#include "Math/MathUtil.h"
 #include "Tracer/Ray.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Shader.h"
@@ -15,6 +16,7 @@ geoEllipsoid::geoEllipsoid()
 	sa = 1;
 	sb = 1;
 	sc = 1;
+	bounding();
 }
 geoEllipsoid::geoEllipsoid(const Point3f &pos, Float semiA, Float semiB, Float semiC)
 {
@@ -22,54 +24,77 @@ geoEllipsoid::geoEllipsoid(const Point3f &pos, Float semiA, Float semiB, Float s
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
+	bounding();
 }
 void geoEllipsoid::setSemiAxes(Float semiA, Float semiB, Float semiC)
 {
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
+	bounding();
 }
-bool geoEllipsoid::intersect(const Ray &inRay, Intersection* /*isec*/, Float* /*tHit*/, Float* /*rayEpsilon*/) const
+void geoEllipsoid::bounding()
 {
-	Point3f rp = inRay.o;
-	Vector3f rd = inRay.d;// Ray position and ray direction.
-	Float coeA = (rd.x / sa) * (rd.x / sa) + (rd.y / sb) * (rd.y / sb) + (rd.z / sc) * (rd.z / sc);
-	Float coeB = (c.x - rp.x) * rd.x / (sa * sa) + (c.y - rp.y) * rd.y / (sb * sb) + (c.z - rp.z) * rd.z / (sc * sc);
-	Float coeC = (rp.x - c.x) * (rp.x - c.x) / (sa * sa) + (rp.y - c.y) * (rp.y - c.y) / (sb * sb) + (rp.z - c.z) * (rp.z - c.z) / (sc * sc) - 1;
-	Float delta = coeB * coeB - coeA * coeC;
-	if (delta < 0)
+	Vector3f extent(sa, sb, sc);
+	mObjBound = Bounds3f(c - extent, c + extent);
+}
+bool geoEllipsoid::intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const
+{
+	Ray ray = objectRay(inRay);
+	// Unit sphere in the space scaled by the semi axes
+	Vector3f o = ray.o - c;
+	Vector3f so(o.x / sa, o.y / sb, o.z / sc);
+	Vector3f sd(ray.d.x / sa, ray.d.y / sb, ray.d.z / sc);
+	Float t1, t2;
+	if (!quadratic(sd.lengthSquared(), 2 * dot(so, sd), so.lengthSquared() - 1, t1, t2))
 	{
-		//std::cout << "No Intersection!" << std::endl;
 		return false;
 	}
-	else//delta > 0
-	{
-		Float t1 = coeB - std::sqrt(delta);
-		Float t2 = 2 * coeB - t1;
 
-		inRay.setT(t1 / coeA, t2 / coeA);
-		if (t1 <= 0 || t2 <= 0)
-		{
-			return false;
-		}
-		else
-		{
-			return true;
-		}
+	// Always use the nearest intersection inside the ray range
+	Float tHitLoc = t1;
+	if (tHitLoc <= ray.tMin)
+	{
+		tHitLoc = t2;
+	}
+	if (tHitLoc <= ray.tMin || tHitLoc >= ray.tMax)
+	{
+		return false;
 	}
+
+	*tHit = tHitLoc;
+	*rayEpsilon = reCE * *tHit;
+	fillIntersection(ray(tHitLoc), isec);
+	return true;
+}
+void geoEllipsoid::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	Ray ray = objectRay(inRay);
+	fillIntersection(ray(ray.tMax), isec);
 }
-/*
-Vector3D geoEllipsoid::getNormal(const Point3f &pos) const
+void geoEllipsoid::fillIntersection(const Point3f &pHit, Intersection* isec) const
 {
-// 2(x-c.x) / sa^2, 2(y - c.y) / sb^2, 2(z - c.z) / sc^2
-return Normalize(Vector3D(
-2 * (pos.x - c.x) / (sa * sa),
-2 * (pos.y - c.y) / (sb * sb),
-2 * (pos.z - c.z) / (sc * sc)));
-}*/
-bool geoEllipsoid::isInside(const Point3f &/*pPos*/) const
+	// Point on the unit sphere, (sinTheta * cosPhi, sinTheta * sinPhi, cosTheta)
+	Vector3f p = pHit - c;
+	Vector3f q(p.x / sa, p.y / sb, p.z / sc);
+	Float sinTheta = std::sqrt(sqr(q.x) + sqr(q.y));
+	if (sinTheta == 0) sinTheta = 1e-5f;
+	Float cosPhi = q.x / sinTheta;
+	Float sinPhi = q.y / sinTheta;
+	Float phi = std::atan2(q.y, q.x);
+	if (phi < 0) phi += M_TWOPI;
+	Float theta = std::acos(clamp(q.z, (Float)-1, (Float)1));
+
+	// 2(x-c.x) / sa^2, 2(y - c.y) / sb^2, 2(z - c.z) / sc^2
+	Normal3f n(p.x / sqr(sa), p.y / sqr(sb), p.z / sqr(sc));
+	Vector3f dpdu = M_TWOPI * Vector3f(-sa * q.y, sb * q.x, 0);
+	Vector3f dpdv = M_PI * Vector3f(sa * q.z * cosPhi, sb * q.z * sinPhi, -sc * sinTheta);
+	makeIntersection(pHit, n, dpdu, dpdv,
+					 Point2f(phi * INV_TWOPI, theta * INV_PI), isec);
+}
+bool geoEllipsoid::isInside(const Point3f &pPos) const
 {
-	return false;
+	return sqr((pPos.x - c.x) / sa) + sqr((pPos.y - c.y) / sb) + sqr((pPos.z - c.z) / sc) <= 1;
 }
 
 }
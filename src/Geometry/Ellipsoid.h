@@ -14,10 +14,16 @@ public:
 	geoEllipsoid(const Point3f &pos, Float semiA, Float semiB, Float semiC);
 
 	void setSemiAxes(Float semiA, Float semiB, Float semiC);
+	void bounding() override;
 	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
 
 	bool isInside(const Point3f &pPos) const override;
 
+private:
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Intersection* isec) const;
+
 public:
 	Point3f c;//center
 	Float sa, sb, sc;//semi-principal axes of length a, b, c
@@ -10,7 +10,7 @@
 namespace Kaguya
 {
 
-uint32_t Geometry::sNextGeomID = 0;
+std::atomic<uint32_t> Geometry::sNextGeomID(0);
 
 bool Geometry::intersectP(const Ray &inRay) const
 {
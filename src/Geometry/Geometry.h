@@ -14,6 +14,8 @@
 #include "Shading/BxDF.h"
 #include "PrimitiveAttribute.h"
 
+#include <atomic>
+
 const Float reCE = 5e-8;//ray epsilon coefficient
 
 //Distance epsilon coefficient
@@ -72,7 +74,8 @@ enum class GeometryType
 	POLYGONAL_MESH,
 	SUBDIVISION_MESH,
 	CURVE,
-	INSTANCE
+	INSTANCE,
+	DEFERRED
 };
 
 static const uint32_t sInvalidGeomID = (uint32_t)(-1);
@@ -146,15 +149,16 @@ public:
 	}
 
 protected:
-	static uint32_t         sNextGeomID;
-	const uint32_t          mGeomID;
+	// Geometries are created concurrently while loading
+	static std::atomic<uint32_t> sNextGeomID;
+	const uint32_t               mGeomID;
 
-	std::string             mGeomName;
+	std::string                  mGeomName;
 
-	const Transform*        mObjectToWorld;
-	Bounds3f                mObjBound;
+	const Transform*             mObjectToWorld;
+	Bounds3f                     mObjBound;
 
-	std::shared_ptr<BxDF>   bxdf;
+	std::shared_ptr<BxDF>        bxdf;
 };
 
 }
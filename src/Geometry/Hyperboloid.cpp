@@ -1,4 +1,5 @@
 #include "Hyperboloid.h"
+#include "Math/MathUtil.h"
 #include "Tracer/Ray.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Shader.h"
@@ -17,14 +18,19 @@ geoHyperboloid::geoHyperboloid()
 	sb = 1;
 	sc = 1;
 	hbType = ONE_SHEET;
+	hh = 2;
+	bounding();
 }
-geoHyperboloid::geoHyperboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, HYPERBOLOID_TYPE newType)
+geoHyperboloid::geoHyperboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, HYPERBOLOID_TYPE newType,
+							   Float halfHeight)
 {
 	c = pos;
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
 	hbType = newType;
+	hh = halfHeight;
+	bounding();
 }
 geoHyperboloid::~geoHyperboloid()
 {
@@ -32,59 +38,89 @@ geoHyperboloid::~geoHyperboloid()
 void geoHyperboloid::setCenter(const Point3f &pos)
 {
 	c = pos;
+	bounding();
 }
 void geoHyperboloid::setSemiAxes(Float semiA, Float semiB, Float semiC)
 {
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
+	bounding();
 }
 void geoHyperboloid::setHyperboloidType(HYPERBOLOID_TYPE newType)
 {
 	hbType = newType;
+	bounding();
 }
-bool geoHyperboloid::intersect(const Ray &inRay, Intersection* /*isec*/, Float* tHit, Float* /*rayEpsilon*/) const
+void geoHyperboloid::setHalfHeight(Float halfHeight)
 {
-	Point3f rp = inRay.o;
-	Vector3f rd = inRay.d;// Ray postion and ray direction.	
-	Float coeA = (rd.x / sa) * (rd.x / sa) - (rd.y / sb) * (rd.y / sb) + (rd.z / sc) * (rd.z / sc);
-	Float coeB = (c.x - rp.x) * rd.x / (sa * sa) - (c.y - rp.y) * rd.y / (sb * sb) + (c.z - rp.z) * rd.z / (sc * sc);
-	Float coeC = (rp.x - c.x) * (rp.x - c.x) / (sa * sa) - (rp.y - c.y) * (rp.y - c.y) / (sb * sb) + (rp.z - c.z) * (rp.z - c.z) / (sc * sc) - hbType;
-
-	Float delta = coeB * coeB - coeA * coeC;
-	if (delta < 0)
+	hh = halfHeight;
+	bounding();
+}
+void geoHyperboloid::bounding()
+{
+	// Widest at the clipping planes
+	Float scale = std::sqrt(std::max(hbType + sqr(hh / sb), (Float)0));
+	Vector3f extent(sa * scale, hh, sc * scale);
+	mObjBound = Bounds3f(c - extent, c + extent);
+}
+bool geoHyperboloid::intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const
+{
+	Ray ray = objectRay(inRay);
+	// (x/a)^2 - (y/b)^2 + (z/c)^2 = type
+	Vector3f o = ray.o - c;
+	const Vector3f &d = ray.d;
+	Float coeA = sqr(d.x / sa) - sqr(d.y / sb) + sqr(d.z / sc);
+	Float coeB = 2 * (o.x * d.x / sqr(sa) - o.y * d.y / sqr(sb) + o.z * d.z / sqr(sc));
+	Float coeC = sqr(o.x / sa) - sqr(o.y / sb) + sqr(o.z / sc) - hbType;
+	Float t[2];
+	if (!quadratic(coeA, coeB, coeC, t[0], t[1]))
 	{
-		inRay.setT(NAN, NAN);
-		//std::cout << "No Intersection!" << std::endl;
 		return false;
 	}
-	else//delta > 0
+
+	// Nearest root inside the ray range and the clipping planes,
+	// NaN roots of a degenerate ray fail every test
+	for (Float tHitLoc : t)
 	{
-		Float t1 = (coeB - std::sqrt(delta)) / coeA;
-		Float t2 = 2 * coeB / coeA - t1;
-		// 		t1 /= coeA;
-		// 		t2 /= coeA;
-		inRay.setT(t1, t2);
-		if (t1 > 0 && t2 > 0)
+		if (!(tHitLoc > ray.tMin && tHitLoc < ray.tMax))
 		{
-			*tHit = t1;
-			return true;
+			continue;
 		}
-		else
+		Point3f pHit = ray(tHitLoc);
+		if (std::abs(pHit.y - c.y) > hh)
 		{
-			return false;
+			continue;
 		}
+		*tHit = tHitLoc;
+		*rayEpsilon = reCE * *tHit;
+		fillIntersection(pHit, isec);
+		return true;
 	}
+	return false;
+}
+void geoHyperboloid::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	Ray ray = objectRay(inRay);
+	fillIntersection(ray(ray.tMax), isec);
 }
-/*
-Normal3f geoHyperboloid::getNormal(const Point3f &pos) const
+void geoHyperboloid::fillIntersection(const Point3f &pHit, Intersection* isec) const
 {
-// 2(x-c.x) / sa^2, -1/sb, 2* type *(z - c.z) / sb^2
-return Normalize(Normal3f(
-2 * (pos.x - c.x) / sqr(sa),
--2 * (pos.y - c.y) / sqr(sb),
-2 * (pos.z - c.z) / sqr(sc)));
-}*/
+	// Ellipse of scale s at height y, s^2 = type + (y/b)^2
+	Vector3f p = pHit - c;
+	Float scale2 = sqr(p.x / sa) + sqr(p.z / sc);
+	Float phi = std::atan2(p.z / sc, p.x / sa);
+	if (phi < 0) phi += M_TWOPI;
+
+	// 2(x-c.x) / sa^2, -2(y - c.y) / sb^2, 2(z - c.z) / sc^2
+	Normal3f n(p.x / sqr(sa), -p.y / sqr(sb), p.z / sqr(sc));
+	Vector3f dpdu = M_TWOPI * Vector3f(-sa * p.z / sc, 0, sc * p.x / sa);
+	// Tip of the cone or of a sheet, the slope is undefined
+	Float slope = scale2 > 0 ? p.y / (sqr(sb) * scale2) : 0;
+	Vector3f dpdv = 2 * hh * Vector3f(p.x * slope, 1, p.z * slope);
+	makeIntersection(pHit, n, dpdu, dpdv,
+					 Point2f(phi * INV_TWOPI, (p.y + hh) / (2 * hh)), isec);
+}
 bool geoHyperboloid::isInside(const Point3f &/*pPos*/) const
 {
 	return 0;
@@ -14,25 +14,34 @@ enum HYPERBOLOID_TYPE
 	CONE = 0
 };
 
+// Opens along the y axis, clipped to |y - c.y| <= hh so it has finite bounds
 class geoHyperboloid : public ParametricGeomtry
 {
 public:
 	geoHyperboloid();
-	geoHyperboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, HYPERBOLOID_TYPE newType);
+	geoHyperboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, HYPERBOLOID_TYPE newType,
+				   Float halfHeight = 2);
 	~geoHyperboloid();
 
 	void setCenter(const Point3f &pos);
 	void setSemiAxes(Float semiA, Float semiB, Float semiC);
 	void setHyperboloidType(HYPERBOLOID_TYPE newType);
-	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const;
-	//Normal3f getNormal(const Point3f &pos) const;
+	void setHalfHeight(Float halfHeight);
+	void bounding() override;
+	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
 
-	bool isInside(const Point3f &pPos) const;
+	bool isInside(const Point3f &pPos) const override;
+
+private:
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Intersection* isec) const;
 
 public:
 	Point3f c;//center
 	Float sa, sb, sc;//semi-principal axes of length a, b, c
 	HYPERBOLOID_TYPE hbType;
+	Float hh;//half height
 };
 
 }
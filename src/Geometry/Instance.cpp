@@ -0,0 +1,125 @@
+#include "Instance.h"
+#include "Geometry/ParametricGeomtry.h"
+#include "Tracer/Ray.h"
+
+namespace Kaguya
+{
+
+InstancePrototype::InstancePrototype(const std::vector<std::shared_ptr<Geometry>> &prims)
+	: mPrims(prims)
+	, mInstanceDepth(0)
+{
+	bool isFirst = true;
+	for (auto &prim : mPrims)
+	{
+		Bounds3f primBounds;
+		switch (prim->primitiveType())
+		{
+		case GeometryType::PARAMATRIC_SURFACE:
+			primBounds = static_cast<const ParametricGeomtry*>(prim.get())->worldBound();
+			break;
+		case GeometryType::INSTANCE:
+			primBounds = prim->getWorldBounding();
+			mInstanceDepth = std::max(mInstanceDepth,
+									  static_cast<const Instance*>(prim.get())->getInstanceDepth());
+			break;
+		default:
+			primBounds = prim->getWorldBounding();
+			break;
+		}
+		mBounds = isFirst ? primBounds : Union(mBounds, primBounds);
+		isFirst = false;
+	}
+}
+
+Instance::Instance(std::shared_ptr<InstancePrototype> prototype,
+				   const Transform &instanceToWorld)
+	: Geometry(nullptr)
+	, mPrototype(prototype)
+	, mInstanceToWorld(instanceToWorld)
+{
+	mObjectToWorld = &mInstanceToWorld;
+	bounding();
+}
+
+void Instance::setInstanceToWorld(const Transform &instanceToWorld)
+{
+	mInstanceToWorld = instanceToWorld;
+	bounding();
+}
+
+void Instance::bounding()
+{
+	// Bounds in the parent space of the instance
+	mObjBound = mInstanceToWorld(mPrototype->getBounds());
+}
+
+bool Instance::intersect(const Ray &inRay,
+						 Intersection* isec,
+						 Float* tHit,
+						 Float* rayEpsilon) const
+{
+	Ray ray = worldToPrototype(inRay);
+	bool isHit = false;
+	for (auto &prim : mPrototype->getPrimitives())
+	{
+		Intersection primIsec;
+		Float primHit, primEpsilon;
+		if (prim->intersect(ray, &primIsec, &primHit, &primEpsilon))
+		{
+			// Closer hits only from now on
+			ray.tMax = primHit;
+			*isec = primIsec;
+			*tHit = primHit;
+			*rayEpsilon = primEpsilon;
+			isHit = true;
+		}
+	}
+	if (isHit)
+	{
+		prototypeToWorld(isec);
+	}
+	return isHit;
+}
+
+bool Instance::intersectP(const Ray &inRay) const
+{
+	Ray ray = worldToPrototype(inRay);
+	for (auto &prim : mPrototype->getPrimitives())
+	{
+		if (prim->intersectP(ray))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Instance::getRenderBuffer(RenderBufferTrait* /*trait*/) const
+{
+	// Instances have no GPU buffer of their own
+}
+
+Ray Instance::worldToPrototype(const Ray &inRay) const
+{
+	Ray ray(inRay);
+	ray.o = mInstanceToWorld.invXform(inRay.o);
+	ray.d = mInstanceToWorld.invXform(inRay.d);
+	return ray;
+}
+
+void Instance::prototypeToWorld(Intersection* isec) const
+{
+	const Transform &xform = mInstanceToWorld;
+	isec->mPos = xform(isec->mPos);
+	isec->mGeomN = xform(isec->mGeomN);
+	isec->mShadingN = xform(isec->mShadingN);
+	isec->mPu = xform(isec->mPu);
+	isec->mPv = xform(isec->mPv);
+	isec->mNu = xform(isec->mNu);
+	isec->mNv = xform(isec->mNv);
+	isec->mPs = xform(isec->mPs);
+	isec->mPt = xform(isec->mPt);
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "Geometry/Geometry.h"
+
+namespace Kaguya
+{
+
+class Instance;
+
+// Group of geometries shared by any number of instances.
+// The tracer builds it once as its own acceleration structure.
+class InstancePrototype
+{
+public:
+	InstancePrototype(const std::vector<std::shared_ptr<Geometry>> &prims);
+
+	const std::vector<std::shared_ptr<Geometry>> &getPrimitives() const
+	{
+		return mPrims;
+	}
+	const Geometry* getPrimitive(uint32_t index) const
+	{
+		return mPrims[index].get();
+	}
+
+	// Bounds in prototype space
+	const Bounds3f &getBounds() const { return mBounds; }
+	// Levels of instancing below this prototype, 0 if it holds no instance
+	uint32_t getInstanceDepth() const { return mInstanceDepth; }
+
+private:
+	std::vector<std::shared_ptr<Geometry>> mPrims;
+	Bounds3f                               mBounds;
+	uint32_t                               mInstanceDepth;
+};
+
+// Placement of a prototype in its parent space, prototypes can hold
+// instances themselves for multi-level instancing
+class Instance : public Geometry
+{
+public:
+	Instance(std::shared_ptr<InstancePrototype> prototype,
+			 const Transform &instanceToWorld);
+
+	void bounding() override;
+
+	bool intersect(const Ray &inRay,
+				   Intersection* isec,
+				   Float* tHit,
+				   Float* rayEpsilon) const override;
+	bool intersectP(const Ray &inRay) const override;
+
+	// Instance hits are resolved through Scene, which knows the hit prototype
+	// primitive, see worldToPrototype and prototypeToWorld
+	void postIntersect(const Ray &/*inRay*/, Intersection* /*isec*/) const override
+	{
+	}
+
+	GeometryType primitiveType() const override
+	{
+		return GeometryType::INSTANCE;
+	}
+
+	void getRenderBuffer(RenderBufferTrait* trait) const override;
+
+	const InstancePrototype* getPrototype() const
+	{
+		return mPrototype.get();
+	}
+	const Transform &getInstanceToWorld() const
+	{
+		return mInstanceToWorld;
+	}
+	void setInstanceToWorld(const Transform &instanceToWorld);
+
+	// Levels of instancing including this one
+	uint32_t getInstanceDepth() const
+	{
+		return mPrototype->getInstanceDepth() + 1;
+	}
+
+	// Direction is not renormalized, hit distances stay the same
+	Ray worldToPrototype(const Ray &inRay) const;
+	void prototypeToWorld(Intersection* isec) const;
+
+private:
+	std::shared_ptr<InstancePrototype> mPrototype;
+	Transform                          mInstanceToWorld;
+};
+
+}
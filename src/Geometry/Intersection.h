@@ -51,6 +51,9 @@ public:
 	Vector3f        mPs, mPt;
 	// dNds, dNdt
 	Normal3f        mNs, mNt;
+
+	// Index of the area light in Scene::getLights, -1 for plain surfaces
+	uint32_t        mLightID = (uint32_t)(-1);
 };
 
 }
@@ -11,6 +11,22 @@ enum class MeshType
 	SUBDIVISION_MESH,
 };
 
+// Mesh vertex positions are single precision in every build, it is the
+// only vertex format Embree reads. Double builds convert on access.
+using MeshVertex = Point3<float>;
+
+inline Point3f toPoint3f(const MeshVertex &v)
+{
+	return Point3f(v.x, v.y, v.z);
+}
+
+inline MeshVertex toMeshVertex(const Point3f &p)
+{
+	return MeshVertex(static_cast<float>(p.x),
+					  static_cast<float>(p.y),
+					  static_cast<float>(p.z));
+}
+
 class Mesh : public Geometry
 {
 public:
@@ -18,8 +34,10 @@ public:
 	virtual ~Mesh() = 0;
 };
 
+// Polygonal meshes are read from and saved to cacheFile unless it is empty
 std::shared_ptr<Mesh> createMesh(const std::string &filename,
-								 MeshType meshType = MeshType::POLYGONAL_MESH);
+								 MeshType meshType = MeshType::POLYGONAL_MESH,
+								 const std::string &cacheFile = "");
 
 namespace objFileParser
 {
@@ -34,14 +52,14 @@ enum index_t : uint8_t
 	VTN = V | UV | NORM
 };
 
-bool parse(const char*            filename,
-		   std::vector<Point3f>  &verts,
-		   std::vector<Point2f>  &uvs,
-		   std::vector<Normal3f> &norms,
-		   std::vector<uint32_t> &faceId,
-		   std::vector<uint32_t> &texcoordId,
-		   std::vector<uint32_t> &normId,
-		   std::vector<uint32_t> &faceCount);
+bool parse(const char*             filename,
+		   std::vector<MeshVertex> &verts,
+		   std::vector<Point2f>    &uvs,
+		   std::vector<Normal3f>   &norms,
+		   std::vector<uint32_t>   &faceId,
+		   std::vector<uint32_t>   &texcoordId,
+		   std::vector<uint32_t>   &normId,
+		   std::vector<uint32_t>   &faceCount);
 
 inline index_t facetype(const char* str, int32_t* val)
 {
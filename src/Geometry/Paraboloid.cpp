@@ -1,4 +1,5 @@
 #include "Paraboloid.h"
+#include "Math/MathUtil.h"
 #include "Tracer/Ray.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Shader.h"
@@ -16,14 +17,19 @@ geoParaboloid::geoParaboloid()
 	sb = 1;
 	sc = 1;
 	pbType = ELLIPTIC_PARABOLOID;
+	hh = 2;
+	bounding();
 }
-geoParaboloid::geoParaboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, PARABOLOID_TYPE newType)
+geoParaboloid::geoParaboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, PARABOLOID_TYPE newType,
+							 Float halfHeight)
 {
 	c = pos;
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
 	pbType = newType;
+	hh = halfHeight;
+	bounding();
 }
 geoParaboloid::~geoParaboloid()
 {
@@ -31,67 +37,90 @@ geoParaboloid::~geoParaboloid()
 void geoParaboloid::setCenter(const Point3f &pos)
 {
 	c = pos;
+	bounding();
 }
 void geoParaboloid::setSemiAxes(Float semiA, Float semiB, Float semiC)
 {
 	sa = semiA;
 	sb = semiB;
 	sc = semiC;
+	bounding();
 }
 void geoParaboloid::setParaboloidType(PARABOLOID_TYPE newType)
 {
 	pbType = newType;
+	bounding();
 }
-bool geoParaboloid::intersect(const Ray &inRay, Intersection* /*isec*/, Float* /*tHit*/, Float* /*rayEpsilon*/) const
+void geoParaboloid::setHalfHeight(Float halfHeight)
 {
-	Point3f rp = inRay.o;
-	Vector3f rd = inRay.d;// Ray postion and ray direction.	
-	Float coeA = (rd.x / sa) * (rd.x / sa) + pbType * (rd.z / sc) * (rd.z / sc);
-	Float coeB = (c.x - rp.x) * rd.x / (sa * sa) + pbType * (c.z - rp.z) * rd.z / (sc * sc) + rd.y * 0.5 / sb;
-	Float coeC = (rp.x - c.x) * (rp.x - c.x) / (sa * sa) + pbType * (rp.z - c.z) * (rp.z - c.z) / (sc * sc) + (c.y - rp.y) / sb;
-	Float delta = coeB * coeB - coeA * coeC;
-	if (coeA == 0)
+	hh = halfHeight;
+	bounding();
+}
+void geoParaboloid::bounding()
+{
+	Float scale = clipScale();
+	// The elliptic one only rises above its center
+	Float yMin = pbType == ELLIPTIC_PARABOLOID ? 0 : -hh;
+	mObjBound = Bounds3f(c + Vector3f(-sa * scale, yMin, -sc * scale),
+						 c + Vector3f(sa * scale, hh, sc * scale));
+}
+bool geoParaboloid::intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const
+{
+	Ray ray = objectRay(inRay);
+	// (x/a)^2 + type * (z/c)^2 = y/b
+	Vector3f o = ray.o - c;
+	const Vector3f &d = ray.d;
+	Float coeA = sqr(d.x / sa) + pbType * sqr(d.z / sc);
+	Float coeB = 2 * (o.x * d.x / sqr(sa) + pbType * o.z * d.z / sqr(sc)) - d.y / sb;
+	Float coeC = sqr(o.x / sa) + pbType * sqr(o.z / sc) - o.y / sb;
+	Float t[2];
+	if (!quadratic(coeA, coeB, coeC, t[0], t[1]))
 	{
-		inRay.setT(coeC * 0.5 / coeB, coeC * 0.5 / coeB);
-		return true;
+		return false;
 	}
-	else
+
+	// Nearest root inside the ray range and the clipping box,
+	// a ray along y has one finite root and NaN fails every test
+	Float scale = clipScale();
+	for (Float tHitLoc : t)
 	{
-		if (delta < 0)
+		if (!(tHitLoc > ray.tMin && tHitLoc < ray.tMax))
 		{
-
-			inRay.setT(NAN, NAN);
-			//std::cout << "No Intersection!" << std::endl;
-			return false;
+			continue;
 		}
-		else//delta > 0
+		Point3f pHit = ray(tHitLoc);
+		if (std::abs(pHit.y - c.y) > hh
+			|| std::abs(pHit.x - c.x) > sa * scale
+			|| std::abs(pHit.z - c.z) > sc * scale)
 		{
-			Float t1 = (coeB - std::sqrt(delta)) / coeA;
-			Float t2 = 2 * coeB / coeA - t1;
-			// 		t1 /= coeA;
-			// 		t2 /= coeA;
-			inRay.setT(t1, t2);
-
-			if (t1 > 0 && t2 > 0)
-			{
-				return true;
-			}
-			else
-			{
-				return false;
-			}
+			continue;
 		}
+		*tHit = tHitLoc;
+		*rayEpsilon = reCE * *tHit;
+		fillIntersection(pHit, isec);
+		return true;
 	}
+	return false;
+}
+void geoParaboloid::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	Ray ray = objectRay(inRay);
+	fillIntersection(ray(ray.tMax), isec);
 }
-/*
-Vector3D geoParaboloid::getNormal(const Point3f &pos) const
+void geoParaboloid::fillIntersection(const Point3f &pHit, Intersection* isec) const
 {
-// 2(x-c.x) / sa^2, -1/sb, 2* type *(z - c.z) / sb^2
-return Normalize(Vector3D(
-2 * (pos.x - c.x) / (sa * sa),
--1 / sb,
-pbType * 2 * (pos.z - c.z) / (sc * sc)));
-}*/
+	// Height field over the clipped xz square
+	Vector3f p = pHit - c;
+	Float scale = clipScale();
+	Point2f uv((p.x / (sa * scale) + 1) * 0.5,
+			   (p.z / (sc * scale) + 1) * 0.5);
+
+	// 2(x-c.x) / sa^2, -1/sb, 2* type *(z - c.z) / sc^2
+	Normal3f n(2 * p.x / sqr(sa), -1 / sb, pbType * 2 * p.z / sqr(sc));
+	Vector3f dpdu = 2 * sa * scale * Vector3f(1, 2 * sb * p.x / sqr(sa), 0);
+	Vector3f dpdv = 2 * sc * scale * Vector3f(0, pbType * 2 * sb * p.z / sqr(sc), 1);
+	makeIntersection(pHit, n, dpdu, dpdv, uv, isec);
+}
 bool geoParaboloid::isInside(const Point3f &/*pPos*/) const
 {
 	return 0;
@@ -12,26 +12,38 @@ enum PARABOLOID_TYPE
 	ELLIPTIC_PARABOLOID = 1,
 	HYPERBOLIC_PARABOLOID = -1
 };
+// Height along the y axis, clipped to |y - c.y| <= hh so it has finite bounds.
+// The saddle is clipped in x and z to the same extent as the elliptic one
 class geoParaboloid : public ParametricGeomtry
 {
 public:
 	geoParaboloid();
-	geoParaboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, PARABOLOID_TYPE newType);
+	geoParaboloid(const Point3f &pos, Float semiA, Float semiB, Float semiC, PARABOLOID_TYPE newType,
+				  Float halfHeight = 2);
 	~geoParaboloid();
 
 	void setCenter(const Point3f &pos);
 	void setSemiAxes(Float semiA, Float semiB, Float semiC);
 	void setParaboloidType(PARABOLOID_TYPE newType);
+	void setHalfHeight(Float halfHeight);
 
-	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const;
-	//Vector3D getNormal(const Point3f &pos) const;
+	void bounding() override;
+	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
 
-	bool isInside(const Point3f &pPos) const;
+	bool isInside(const Point3f &pPos) const override;
+
+private:
+	// Half extent in x and z over sa and sc
+	Float clipScale() const { return std::sqrt(hh / sb); }
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Intersection* isec) const;
 
 public:
 	Point3f c;//center
 	Float sa, sb, sc;//semi-principal axes of length a, b, c
 	PARABOLOID_TYPE pbType;
+	Float hh;//half height
 };
 
 }
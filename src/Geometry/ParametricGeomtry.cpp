@@ -1,5 +1,7 @@
 #include "ParametricGeomtry.h"
 #include "Geometry/PolyMesh.h"
+#include "Geometry/Intersection.h"
+#include "Tracer/Ray.h"
 
 namespace Kaguya
 {
@@ -9,4 +11,42 @@ void ParametricGeomtry::getRenderBuffer(RenderBufferTrait* trait) const
 	mProxyMesh->getRenderBuffer(trait);
 }
 
+bool ParametricGeomtry::intersectP(const Ray &inRay) const
+{
+	Intersection isec;
+	Float tHit, rayEpsilon;
+	return intersect(inRay, &isec, &tHit, &rayEpsilon);
+}
+
+Bounds3f ParametricGeomtry::worldBound() const
+{
+	return mObjectToWorld ? (*mObjectToWorld)(mObjBound) : mObjBound;
+}
+
+Ray ParametricGeomtry::objectRay(const Ray &inRay) const
+{
+	if (mObjectToWorld == nullptr)
+	{
+		return inRay;
+	}
+	Ray ray = mObjectToWorld->getInvMat()(inRay);
+	ray.d = mObjectToWorld->getInvMat()(inRay.d);
+	return ray;
+}
+
+void ParametricGeomtry::makeIntersection(const Point3f &pHit, const Normal3f &n,
+										 const Vector3f &dpdu, const Vector3f &dpdv,
+										 const Point2f &uv, Intersection* isec) const
+{
+	if (mObjectToWorld == nullptr)
+	{
+		*isec = Intersection(pHit, normalize(n), dpdu, dpdv,
+							 Normal3f(), Normal3f(), uv, this);
+		return;
+	}
+	const Transform &o2w = *mObjectToWorld;
+	*isec = Intersection(o2w(pHit), normalize(o2w(n)), o2w(dpdu), o2w(dpdv),
+						 Normal3f(), Normal3f(), uv, this);
+}
+
 }
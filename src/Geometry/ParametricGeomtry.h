@@ -20,6 +20,21 @@ public:
 
 	void getRenderBuffer(RenderBufferTrait* trait) const override;
 
+	// Any hit test through the analytic intersection routine
+	bool intersectP(const Ray &inRay) const override;
+
+	// Object bounds transformed to world space, used by the Embree user geometry
+	Bounds3f worldBound() const;
+
+protected:
+	// Ray in object space, the direction is left unnormalized so hit
+	// distances are the same as along the world space ray
+	Ray objectRay(const Ray &inRay) const;
+	// Object space differential geometry to a world space hit record
+	void makeIntersection(const Point3f &pHit, const Normal3f &n,
+						  const Vector3f &dpdu, const Vector3f &dpdv,
+						  const Point2f &uv, Intersection* isec) const;
+
 protected:
 	std::shared_ptr<PolyMesh> mProxyMesh;
 };
@@ -12,48 +12,67 @@ namespace Kaguya
 /************************************************************************/
 geoPlane::geoPlane()
 	: n(0, 1, 0)
+	, width(sMaxSize), height(sMaxSize)
 {
 	bounding();
 }
 geoPlane::geoPlane(const Point3f &pos, const Normal3f &norm,
 				   Float w, Float h)
-	: p(pos), n(norm)
-	, width(w), height(h)
+	: p(pos), n(normalize(norm))
+	, width(std::min(w, sMaxSize)), height(std::min(h, sMaxSize))
 {
 	bounding();
 }
 
-bool geoPlane::intersect(const Ray &inRay, Intersection* /*isec*/, Float* tHit, Float* rayEpsilon) const
+bool geoPlane::intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const
 {
-	Float t = dot(this->n, inRay.d);
-	if (t >= 0)
+	Ray ray = objectRay(inRay);
+	Float cosTheta = dot(n, ray.d);
+	if (cosTheta == 0)
 	{
-		//std::cout << "Ray parallels to the plane or in the plane." << std::endl;
+		// Ray parallels to the plane or in the plane
 		return false;
 	}
-	else
+	Float tHitLoc = dot(n, p - ray.o) / cosTheta;
+	if (tHitLoc <= ray.tMin || tHitLoc >= ray.tMax)
 	{
-		t = dot(n, (p - inRay.o)) / t;
-		if (t > 0 && t > inRay.tMin && t < inRay.tMax)
-		{
-
-			//inRay.setT(t, INFINITY);
-			*tHit = t;
-			*rayEpsilon = reCE * *tHit;
-			return true;
-		}
-		else
-		{
-			return false;
-		}
+		return false;
+	}
+	Point3f pHit = ray(tHitLoc);
+	Vector3f offset = pHit - p;
+	if (std::abs(dot(offset, s)) > width * 0.5
+		|| std::abs(dot(offset, t)) > height * 0.5)
+	{
+		return false;
 	}
+
+	*tHit = tHitLoc;
+	*rayEpsilon = reCE * *tHit;
+	fillIntersection(pHit, isec);
+	return true;
+}
+
+void geoPlane::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	Ray ray = objectRay(inRay);
+	fillIntersection(ray(ray.tMax), isec);
+}
+
+void geoPlane::fillIntersection(const Point3f &pHit, Intersection* isec) const
+{
+	Vector3f offset = pHit - p;
+	Point2f uv(dot(offset, s) / width + 0.5, dot(offset, t) / height + 0.5);
+	makeIntersection(pHit, n, s * width, t * height, uv, isec);
 }
 
 void geoPlane::bounding()
 {
-	// TODO: Plane bouding method
-	mObjBound = Bounds3f(Point3f(-sNumInfinity, -sNumInfinity, -sNumInfinity),
-						 Point3f(sNumInfinity, sNumInfinity, sNumInfinity));
+	coordinateSystem(Vector3f(n), &s, &t);
+	Vector3f halfW = s * (width * 0.5);
+	Vector3f halfH = t * (height * 0.5);
+	mObjBound = Bounds3f(p - halfW - halfH, p + halfW + halfH);
+	mObjBound.Union(p - halfW + halfH);
+	mObjBound.Union(p + halfW - halfH);
 }
 
 }
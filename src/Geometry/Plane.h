@@ -7,6 +7,8 @@ namespace Kaguya
 /************************************************************************/
 /* Plane Function Definition                                            */
 /************************************************************************/
+// Rectangle of width x height centered at p. Infinite sizes are clipped
+// to sMaxSize, Embree needs finite bounds
 class geoPlane : public ParametricGeomtry
 {
 public:
@@ -14,16 +16,25 @@ public:
 	geoPlane(const Point3f &pos, const Normal3f &norm,
 			 Float w = INFINITY, Float h = INFINITY);
 
-	void bounding();
+	void bounding() override;
 
-	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const;
+	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
 
 	//bool isInside(const Point3f &pPos) const;
 
+	static constexpr Float sMaxSize = 1e5;
+
+private:
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Intersection* isec) const;
+
 public:
 	Point3f p;
 	Normal3f n;
 	Float width, height;
+	// Directions of width and height on the plane
+	Vector3f s, t;
 };
 
 }
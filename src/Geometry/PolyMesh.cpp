@@ -5,8 +5,8 @@
 namespace Kaguya
 {
 
-PolyMesh::PolyMesh(std::vector<Point3f>              vertexBuffer,
-				   std::vector<uint32_t>             indexBuffer,
+PolyMesh::PolyMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+				   SharedBuffer<uint32_t>            indexBuffer,
 				   size_t                            vertexCount,
 				   size_t                            faceCount,
 				   std::shared_ptr<TextureAttribute> texAttri,
@@ -24,6 +24,130 @@ PolyMesh::~PolyMesh()
 {
 }
 
+void PolyMesh::bounding()
+{
+	if (mVertexBuffer.empty())
+	{
+		return;
+	}
+	mObjBound = Bounds3f(toPoint3f(mVertexBuffer.front()));
+	for (auto &v : mVertexBuffer)
+	{
+		mObjBound.Union(toPoint3f(v));
+	}
+	for (auto &motionVertexBuffer : mMotionVertexBuffers)
+	{
+		for (auto &v : motionVertexBuffer)
+		{
+			mObjBound.Union(toPoint3f(v));
+		}
+	}
+}
+
+void PolyMesh::transform(const Transform &xform)
+{
+	for (auto &v : mVertexBuffer.vector())
+	{
+		v = toMeshVertex(xform(toPoint3f(v)));
+	}
+	for (auto &motionVertexBuffer : mMotionVertexBuffers)
+	{
+		for (auto &v : motionVertexBuffer)
+		{
+			v = toMeshVertex(xform(toPoint3f(v)));
+		}
+	}
+	if (mNormalAttibute)
+	{
+		for (auto &n : mNormalAttibute->mValueBuffer)
+		{
+			n = normalize(xform(n));
+		}
+	}
+	if (mCompactNormal)
+	{
+		mCompactNormal->transformValues([&xform](const Normal3f &n)
+		{
+			return normalize(xform(n));
+		});
+	}
+	bounding();
+}
+
+void PolyMesh::cornerPositions(const uint32_t* vIDs, size_t count,
+							   Float time, Point3f* p) const
+{
+	if (mMotionVertexBuffers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			p[i] = toPoint3f(mVertexBuffer[vIDs[i]]);
+		}
+		return;
+	}
+	size_t segmentCount = mMotionVertexBuffers.size();
+	Float t = clamp(time, Float(0), Float(1)) * segmentCount;
+	size_t step = std::min(static_cast<size_t>(t), segmentCount - 1);
+	Float frac = t - step;
+	const MeshVertex* v0 = step == 0
+		? mVertexBuffer.data() : mMotionVertexBuffers[step - 1].data();
+	const MeshVertex* v1 = mMotionVertexBuffers[step].data();
+	for (size_t i = 0; i < count; i++)
+	{
+		p[i] = toPoint3f(v0[vIDs[i]]) * (1 - frac) + toPoint3f(v1[vIDs[i]]) * frac;
+	}
+}
+
+void PolyMesh::compressAttributes()
+{
+	if (mTextureAttribute)
+	{
+		mCompactTexture = std::make_unique<CompactTextureAttribute>(*mTextureAttribute);
+		mTextureAttribute.reset();
+	}
+	if (mNormalAttibute)
+	{
+		mCompactNormal = std::make_unique<CompactNormalAttribute>(*mNormalAttibute);
+		mNormalAttibute.reset();
+	}
+}
+
+bool PolyMesh::cornerTexcoords(uint32_t primID, size_t faceSize,
+							   const uint32_t* vIDs, Point2f* uv) const
+{
+	if (mCompactTexture)
+	{
+		return mCompactTexture->getCornerValues(primID, faceSize, vIDs, uv);
+	}
+	return mTextureAttribute
+		&& mTextureAttribute->getCornerValues(primID, faceSize, vIDs, uv);
+}
+
+bool PolyMesh::cornerNormals(uint32_t primID, size_t faceSize,
+							 const uint32_t* vIDs, Normal3f* n) const
+{
+	if (mCompactNormal)
+	{
+		return mCompactNormal->getCornerValues(primID, faceSize, vIDs, n);
+	}
+	return mNormalAttibute
+		&& mNormalAttibute->getCornerValues(primID, faceSize, vIDs, n);
+}
+
+bool PolyMesh::setMotionVertexBuffers(std::vector<std::vector<MeshVertex>> motionVertexBuffers)
+{
+	for (auto &motionVertexBuffer : motionVertexBuffers)
+	{
+		if (motionVertexBuffer.size() != mVertexBuffer.size())
+		{
+			return false;
+		}
+	}
+	mMotionVertexBuffers = std::move(motionVertexBuffers);
+	bounding();
+	return true;
+}
+
 void PolyMesh::getRenderBuffer(RenderBufferTrait* trait) const
 {
 	switch (polyMeshType())
@@ -40,9 +164,9 @@ void PolyMesh::getRenderBuffer(RenderBufferTrait* trait) const
 	// attach vertex buffer
 	trait->vertex.data = (void*)(mVertexBuffer.data());
 	trait->vertex.count = mVertexBuffer.size();
-	trait->vertex.size = sizeof(Point3f) * trait->vertex.count;
+	trait->vertex.size = sizeof(MeshVertex) * trait->vertex.count;
 	trait->vertex.offset = 0;
-	trait->vertex.stride = sizeof(Point3f);
+	trait->vertex.stride = sizeof(MeshVertex);
 
 	// attach index buffer
 	trait->index.data = (void*)(mIndexBuffer.data());
@@ -52,7 +176,7 @@ void PolyMesh::getRenderBuffer(RenderBufferTrait* trait) const
 	trait->index.stride = sizeof(uint32_t);
 
 	// Extract TextureCoordinates to Texture Buffer
-	switch (mTextureAttribute->mType)
+	switch (mTextureAttribute ? mTextureAttribute->mType : AttributeType::UNDEFINED)
 	{
 	case AttributeType::VERTEX_VARYING:
 	{
@@ -74,7 +198,7 @@ void PolyMesh::getRenderBuffer(RenderBufferTrait* trait) const
 		break;
 	}
 	// Extract Shading Normal to Texture Buffer
-	switch (mNormalAttibute->mType)
+	switch (mNormalAttibute ? mNormalAttibute->mType : AttributeType::UNDEFINED)
 	{
 	case AttributeType::VERTEX_VARYING:
 	{
@@ -122,8 +246,27 @@ size_t PolyMesh::tessellatedCount(const std::vector<uint32_t> &faceSizeBuffer, s
 	}
 }
 
-std::shared_ptr<PolyMesh> PolyMesh::createPolyMesh(std::vector<Point3f>              vertexBuffer,
-												   std::vector<uint32_t>             indexBuffer,
+void PolyMesh::faceOffsets(const std::vector<uint32_t> &faceSizeBuffer, size_t faceSize,
+						   std::vector<size_t> &srcOffsets,
+						   std::vector<size_t> &dstOffsets)
+{
+	srcOffsets.resize(faceSizeBuffer.size());
+	dstOffsets.resize(faceSizeBuffer.size());
+	size_t srcPos = 0;
+	size_t dstPos = 0;
+	for (size_t i = 0; i < faceSizeBuffer.size(); i++)
+	{
+		srcOffsets[i] = srcPos;
+		dstOffsets[i] = dstPos;
+		srcPos += faceSizeBuffer[i];
+		dstPos += faceSize * (faceSize == 3
+							  ? faceSizeBuffer[i] - 2
+							  : (faceSizeBuffer[i] - 1) >> 1);
+	}
+}
+
+std::shared_ptr<PolyMesh> PolyMesh::createPolyMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+												   SharedBuffer<uint32_t>            indexBuffer,
 												   const std::vector<uint32_t>      &faceSizeBuffer,
 												   std::shared_ptr<TextureAttribute> texAttri,
 												   std::shared_ptr<NormalAttribute>  normAttri)
@@ -153,8 +296,8 @@ std::shared_ptr<PolyMesh> PolyMesh::createPolyMesh(std::vector<Point3f>
 	}
 }
 
-std::shared_ptr<TriangleMesh> PolyMesh::createTriMesh(std::vector<Point3f>              vertexBuffer,
-													  std::vector<uint32_t>             indexBuffer,
+std::shared_ptr<TriangleMesh> PolyMesh::createTriMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+													  SharedBuffer<uint32_t>            indexBuffer,
 													  const std::vector<uint32_t>      &faceSizeBuffer,
 													  std::shared_ptr<TextureAttribute> texAttri,
 													  std::shared_ptr<NormalAttribute>  normAttri)
@@ -9,6 +9,8 @@
 #pragma once
 #include "Geometry/Mesh.h"
 #include "Geometry/PrimitiveAttribute.h"
+#include "Geometry/CompactAttribute.h"
+#include "Core/MappedFile.h"
 
 namespace Kaguya
 {
@@ -41,8 +43,8 @@ class PolyMesh : public Mesh
 {
 public:
 	PolyMesh() {}
-	PolyMesh(std::vector<Point3f>              vertexBuffer,
-			 std::vector<uint32_t>             indexBuffer,
+	PolyMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+			 SharedBuffer<uint32_t>            indexBuffer,
 			 size_t                            vertexCount,
 			 size_t                            faceCount,
 			 std::shared_ptr<TextureAttribute> texAttri,
@@ -56,37 +58,87 @@ public:
 
 	virtual PolyMeshType polyMeshType() const = 0;
 
+	// Bounds over every time step
+	void bounding() override;
+
+	// Vertex positions at later time steps, evenly spaced over the shutter
+	// interval after mVertexBuffer. Every step has the same vertex count.
+	bool setMotionVertexBuffers(std::vector<std::vector<MeshVertex>> motionVertexBuffers);
+	size_t getTimeStepCount() const { return mMotionVertexBuffers.size() + 1; }
+
+	// Move vertices (all time steps) and normals in place, buffers shared
+	// with the tracer need to be updated afterwards
+	void transform(const Transform &xform);
+
 	virtual void getTessellated(TessBuffer &trait) const = 0;
 
 	void getRenderBuffer(RenderBufferTrait* trait) const override;
 
+	// Tessellated buffers, possibly viewing a mesh cache mapping
+	const SharedBuffer<MeshVertex> &getVertexBuffer() const { return mVertexBuffer; }
+	const SharedBuffer<uint32_t> &getIndexBuffer() const { return mIndexBuffer; }
+
+	const TextureAttribute* getTextureAttribute() const { return mTextureAttribute.get(); }
+	const NormalAttribute* getNormalAttribute() const { return mNormalAttibute.get(); }
+
+	// Replace texture coordinates and normals by quantized copies
+	// (16 bit UVs, octahedral normals, 16 bit indices when possible).
+	// Full precision attributes are released, so the GPU preview no
+	// longer gets them.
+	void compressAttributes();
+	bool isCompressed() const { return mCompactTexture || mCompactNormal; }
+
 	static size_t tessellatedCount(const std::vector<uint32_t> &faceSizeBuffer, size_t faceSize);
 
-	static std::shared_ptr<PolyMesh> createPolyMesh(std::vector<Point3f>              vertexBuffer,
-													std::vector<uint32_t>             indexBuffer,
+	static std::shared_ptr<PolyMesh> createPolyMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+													SharedBuffer<uint32_t>            indexBuffer,
 													const std::vector<uint32_t>      &faceSizeBuffer,
 													std::shared_ptr<TextureAttribute> texAttri,
 													std::shared_ptr<NormalAttribute>  normAttri);
 
-	static std::shared_ptr<TriangleMesh> createTriMesh(std::vector<Point3f>              vertexBuffer,
-													   std::vector<uint32_t>             indexBuffer,
+	static std::shared_ptr<TriangleMesh> createTriMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+													   SharedBuffer<uint32_t>            indexBuffer,
 													   const std::vector<uint32_t>      &faceSizeBuffer,
 													   std::shared_ptr<TextureAttribute> texAttri,
 													   std::shared_ptr<NormalAttribute>  normAttri);
 
 protected:
+	// Corner positions at the given shutter time, motion steps are
+	// interpolated linearly like Embree does
+	void cornerPositions(const uint32_t* vIDs, size_t count,
+						 Float time, Point3f* p) const;
+
+	// Per corner attributes from either storage, false when absent
+	bool cornerTexcoords(uint32_t primID, size_t faceSize,
+						 const uint32_t* vIDs, Point2f* uv) const;
+	bool cornerNormals(uint32_t primID, size_t faceSize,
+					   const uint32_t* vIDs, Normal3f* n) const;
+
+	// Where each face starts in the source index buffer and in the
+	// tessellated one, so faces can be split independently
+	static void faceOffsets(const std::vector<uint32_t> &faceSizeBuffer, size_t faceSize,
+							std::vector<size_t> &srcOffsets,
+							std::vector<size_t> &dstOffsets);
+
+	// Faces per task when tessellating in parallel
+	static const size_t sTessellateGrainSize = 16384;
+
 	virtual void tessellate(std::vector<uint32_t> &indexBuffer,
 							const std::vector<uint32_t> &faceSizeBuffer,
 							size_t                 tessellatedCount) = 0;
 
 protected:
-	std::vector<Point3f>              mVertexBuffer;
-	std::vector<uint32_t>             mIndexBuffer;
-	size_t                            mVertexCount;
-	size_t                            mFaceCount;
+	SharedBuffer<MeshVertex>                 mVertexBuffer;
+	std::vector<std::vector<MeshVertex>>     mMotionVertexBuffers;
+	SharedBuffer<uint32_t>                   mIndexBuffer;
+	size_t                                   mVertexCount;
+	size_t                                   mFaceCount;
+
+	std::shared_ptr<TextureAttribute>        mTextureAttribute;
+	std::shared_ptr<NormalAttribute>         mNormalAttibute;
 
-	std::shared_ptr<TextureAttribute> mTextureAttribute;
-	std::shared_ptr<NormalAttribute>  mNormalAttibute;
+	std::unique_ptr<CompactTextureAttribute> mCompactTexture;
+	std::unique_ptr<CompactNormalAttribute>  mCompactNormal;
 };
 
 }
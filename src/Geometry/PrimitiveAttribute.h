@@ -73,6 +73,53 @@ public:
 		}
 	}
 
+	// Values at each corner of a primitive whatever the rate,
+	// false when nothing is stored
+	bool getCornerValues(uint32_t primID, size_t primSize,
+						 const uint32_t* vIDs, T* targ) const
+	{
+		if (mValueBuffer.empty())
+		{
+			return false;
+		}
+		switch (mType)
+		{
+		case AttributeType::VERTEX_VARYING:
+		{
+			for (size_t i = 0; i < primSize; i++)
+			{
+				targ[i] = mValueBuffer[vIDs[i]];
+			}
+			return true;
+		}
+		case AttributeType::FACE_VARYING:
+		{
+			const uint32_t* ids = mIndexBuffer.data() + primID * primSize;
+			for (size_t i = 0; i < primSize; i++)
+			{
+				targ[i] = mValueBuffer[ids[i]];
+			}
+			return true;
+		}
+		case AttributeType::UNIFORM:
+		{
+			if (primID >= mValueBuffer.size())
+			{
+				return false;
+			}
+			std::fill(targ, targ + primSize, mValueBuffer[primID]);
+			return true;
+		}
+		case AttributeType::CONSTANT:
+		{
+			std::fill(targ, targ + primSize, mValueBuffer.front());
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
 	void* getValuePtr() const
 	{
 		return (void*)mValueBuffer.data();
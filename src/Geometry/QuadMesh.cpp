@@ -1,17 +1,19 @@
 #include "QuadMesh.h"
 
 #include "Geometry/PolyMesh.h"
+#include "Geometry/TriangleMesh.h"
 #include "Tracer/Ray.h"
 #include "Geometry/Intersection.h"
 #include "Shading/Shader.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Texture.h"
+#include "Core/ThreadPool.h"
 
 namespace Kaguya
 {
 
-QuadMesh::QuadMesh(std::vector<Point3f>              vertexBuffer,
-				   std::vector<uint32_t>             indexBuffer,
+QuadMesh::QuadMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+				   SharedBuffer<uint32_t>            indexBuffer,
 				   const std::vector<uint32_t>      &faceSizeBuffer,
 				   size_t                            totalPrimCount,
 				   std::shared_ptr<TextureAttribute> texAttri,
@@ -23,7 +25,7 @@ QuadMesh::QuadMesh(std::vector<Point3f>              vertexBuffer,
 {
 	if (!isTessellated)
 	{
-		tessellate(mIndexBuffer, faceSizeBuffer, totalPrimCount);
+		tessellate(mIndexBuffer.vector(), faceSizeBuffer, totalPrimCount);
 		if (mTextureAttribute->isFaceVarying())
 		{
 			tessellate(mTextureAttribute->mIndexBuffer,
@@ -37,20 +39,13 @@ QuadMesh::QuadMesh(std::vector<Point3f>              vertexBuffer,
 					   totalPrimCount);
 		}
 	}
+	bounding();
 }
 
 QuadMesh::~QuadMesh()
 {
 }
 
-void QuadMesh::bounding()
-{
-	for (auto &v : mVertexBuffer)
-	{
-		mObjBound.Union(v);
-	}
-}
-
 void QuadMesh::printInfo(const std::string &msg) const
 {
 	if (!msg.empty())
@@ -74,16 +69,50 @@ bool QuadMesh::intersect(const Ray &/*inRay*/, Intersection* /*isec*/,
 	return false;
 }
 
-void QuadMesh::postIntersect(const Ray &/*inRay*/, Intersection* /*isec*/) const
+void QuadMesh::postIntersect(const Ray &inRay, Intersection* isec) const
 {
-	// TODO: Implement post-intersection method
+	uint32_t primID = inRay.primID;
+	const uint32_t* vIDs = mIndexBuffer.data() + primID * sQuadFaceSize;
+
+	Point3f p[sQuadFaceSize];
+	cornerPositions(vIDs, sQuadFaceSize, inRay.time, p);
+
+	Point2f uv[sQuadFaceSize];
+	bool hasUV = cornerTexcoords(primID, sQuadFaceSize, vIDs, uv);
+	Normal3f n[sQuadFaceSize];
+	bool hasNormal = cornerNormals(primID, sQuadFaceSize, vIDs, n);
+
+	// Embree splits a quad into Triangle(0,1,3) and Triangle(2,3,1),
+	// u, v of the second one are mirrored to cover the whole quad
+	const int firstTri[3] = { 0, 1, 3 };
+	const int secondTri[3] = { 2, 3, 1 };
+	bool isFirst = inRay.u + inRay.v <= 1;
+	const int* corners = isFirst ? firstTri : secondTri;
+	Float b1 = isFirst ? inRay.u : 1 - inRay.u;
+	Float b2 = isFirst ? inRay.v : 1 - inRay.v;
+
+	Point3f triP[3];
+	Point2f triUV[3];
+	Normal3f triN[3];
+	for (int i = 0; i < 3; i++)
+	{
+		triP[i] = p[corners[i]];
+		triUV[i] = uv[corners[i]];
+		triN[i] = n[corners[i]];
+	}
+
+	isec->mGeomN = normalize(inRay.Ng);
+	isec->mUV = { inRay.u, inRay.v };
+	TriangleUtils::postIntersect(triP,
+								 hasUV ? triUV : nullptr,
+								 hasNormal ? triN : nullptr,
+								 b1, b2, isec);
 }
 
 void QuadMesh::getTessellated(TessBuffer &trait) const
 {
-	// TODO: Implementation check required
 	// Setup time step
-	size_t timestep = 1;
+	size_t timestep = getTimeStepCount();
 	trait.nTimeStep = timestep;
 	trait.nGeomId = getGeomID();
 
@@ -91,15 +120,15 @@ void QuadMesh::getTessellated(TessBuffer &trait) const
 	trait.nVertices = mVertexBuffer.size();
 	trait.vertTraits.resize(timestep);
 	trait.vertTraits[0].byteOffset = 0;
-	trait.vertTraits[0].byteStride = sizeof(Point3f);
+	trait.vertTraits[0].byteStride = sizeof(MeshVertex);
 	trait.vertTraits[0].data = (void*)(mVertexBuffer.data());
 
 	// Setup buffers for Motion Blur
 	for (size_t i = 1; i < timestep; i++)
 	{
 		trait.vertTraits[i].byteOffset = 0;
-		trait.vertTraits[i].byteStride = sizeof(Point3f);
-		trait.vertTraits[i].data = (void*)(mVertexBuffer.data());
+		trait.vertTraits[i].byteStride = sizeof(MeshVertex);
+		trait.vertTraits[i].data = (void*)(mMotionVertexBuffers[i - 1].data());
 	}
 
 	// Setup index buffer
@@ -113,47 +142,66 @@ void QuadMesh::tessellate(std::vector<uint32_t> &indexBuffer,
 						  const std::vector<uint32_t> &faceSizeBuffer,
 						  size_t                 tessellatedCount)
 {
-	size_t nCurrentPosition = indexBuffer.size();
-	size_t nLastPosition = tessellatedCount * sQuadFaceSize;
-	indexBuffer.resize(nLastPosition);
+	std::vector<size_t> srcOffsets, dstOffsets;
+	faceOffsets(faceSizeBuffer, sQuadFaceSize, srcOffsets, dstOffsets);
 
-	for (int i = faceSizeBuffer.size() - 1; i >= 0; i--)
+	std::vector<uint32_t> tessellated(tessellatedCount * sQuadFaceSize);
+	auto splitFaces = [&](size_t faceBegin, size_t faceEnd)
 	{
-		uint32_t curFaceSize = faceSizeBuffer[i];
-		uint32_t lastIndex = indexBuffer[nCurrentPosition - 1];
-		nCurrentPosition -= curFaceSize;
-
-		// Quad will be rotated in order to match Embree's indexing order
-		// eg. Quad(0,1,2,3) is treated as Triangle(0,1,3) and Triangle(2,3,1) in Embree,
-		//     while split into Triangle(0,1,2) and Triangle(0,2,3) in most modeling tools
-		//     simply rotate quad to Quad(3,0,1,2) will solve this conflict.
-		// For triangles, duplicating last index and rotate will ends with infinite small triangle
-		// eg. If follow the rule above, Triangle(0,1,2) will be Quad(2,0,1,2)
-		//     and eventually into Triangle1(2,0,2), which might cause intersection failure,
-		//     and Triangle2(1,2,0), which is tested after Triangle1.
-		//     To avoid it, triangles are treated differently by add last index to the end.
-		if (curFaceSize == 3)
-		{
-			indexBuffer[--nLastPosition] = lastIndex;
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + 2];
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + 1];
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition];
-		}
-		else
+		for (size_t i = faceBegin; i < faceEnd; i++)
 		{
-			if (curFaceSize & 1)
+			uint32_t curFaceSize = faceSizeBuffer[i];
+			const uint32_t* src = indexBuffer.data() + srcOffsets[i];
+			uint32_t* dst = tessellated.data() + dstOffsets[i];
+			uint32_t lastIndex = src[curFaceSize - 1];
+
+			// Quad will be rotated in order to match Embree's indexing order
+			// eg. Quad(0,1,2,3) is treated as Triangle(0,1,3) and Triangle(2,3,1) in Embree,
+			//     while split into Triangle(0,1,2) and Triangle(0,2,3) in most modeling tools
+			//     simply rotate quad to Quad(3,0,1,2) will solve this conflict.
+			// For triangles, duplicating last index and rotate will ends with infinite small triangle
+			// eg. If follow the rule above, Triangle(0,1,2) will be Quad(2,0,1,2)
+			//     and eventually into Triangle1(2,0,2), which might cause intersection failure,
+			//     and Triangle2(1,2,0), which is tested after Triangle1.
+			//     To avoid it, triangles are treated differently by add last index to the end.
+			if (curFaceSize == 3)
 			{
-				curFaceSize++;
+				*dst++ = src[0];
+				*dst++ = src[1];
+				*dst++ = src[2];
+				*dst++ = lastIndex;
 			}
-			for (size_t j = curFaceSize; j >= sQuadFaceSize; j -= 2)
+			else
 			{
-				indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + j - 2];
-				indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + j - 3];
-				indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + j - 4];
-				indexBuffer[--nLastPosition] = lastIndex;
+				if (curFaceSize & 1)
+				{
+					curFaceSize++;
+				}
+				for (size_t j = sQuadFaceSize; j <= curFaceSize; j += 2)
+				{
+					*dst++ = lastIndex;
+					*dst++ = src[j - 4];
+					*dst++ = src[j - 3];
+					*dst++ = src[j - 2];
+				}
 			}
 		}
+	};
+	size_t faceCount = faceSizeBuffer.size();
+	if (faceCount <= sTessellateGrainSize)
+	{
+		splitFaces(0, faceCount);
+	}
+	else
+	{
+		size_t chunkCount = (faceCount + sTessellateGrainSize - 1) / sTessellateGrainSize;
+		parallelFor(0, chunkCount, [&](size_t chunk)
+		{
+			splitFaces(chunk * sTessellateGrainSize,
+					   std::min(faceCount, (chunk + 1) * sTessellateGrainSize));
+		});
 	}
+	indexBuffer.swap(tessellated);
 }
 
 }
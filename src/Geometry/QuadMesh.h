@@ -8,8 +8,8 @@ namespace Kaguya
 class QuadMesh : public PolyMesh
 {
 public:
-	QuadMesh(std::vector<Point3f>              vertexBuffer,
-			 std::vector<uint32_t>             indexBuffer,
+	QuadMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+			 SharedBuffer<uint32_t>            indexBuffer,
 			 const std::vector<uint32_t>      &faceSizeBuffer,
 			 size_t                            totalPrimCount,
 			 std::shared_ptr<TextureAttribute> texAttri,
@@ -17,8 +17,6 @@ public:
 			 bool                              isTessellated = true);
 	~QuadMesh();
 
-	void bounding() override;
-
 	void printInfo(const std::string &msg) const override;
 
 	bool intersect(const Ray &inRay,
@@ -13,30 +13,28 @@ geoSphere::geoSphere(const Transform* o2w,
 	, r(radius), phiMax(phi)
 	, thetaMin(th0), thetaMax(th1)
 {
-	zMin = clamp(cos(thetaMax), -radius, radius);
-	zMax = clamp(cos(thetaMin), -radius, radius);
+	zMin = clamp(radius * std::cos(thetaMax), -radius, radius);
+	zMax = clamp(radius * std::cos(thetaMin), -radius, radius);
 
 	bounding();
 }
 void geoSphere::bounding()
 {
-	mObjBound = Bounds3f();
-	mObjBound.expand(r);
-	//return false;
+	mObjBound = Bounds3f(Point3f(-r, -r, zMin), Point3f(r, r, zMax));
 }
 
 Bounds3f geoSphere::getWorldBounding() const
 {
-	Bounds3f ret;
-	ret.expand(r);
-	return ret;
+	return worldBound();
 }
 bool geoSphere::intersect(const Ray &inRay,
 						  Intersection* isec, Float* tHit, Float* rayEpsilon) const
 {
-	Float phi, theta;
+	Float phi;
 	Point3f pHit;
 	Ray ray = mObjectToWorld->getInvMat()(inRay);
+	// Keep the direction unnormalized so t is shared with the world space ray
+	ray.d = mObjectToWorld->getInvMat()(inRay.d);
 	// (ox + t*dx)^2 + (oy + t*dy)^2 + (oz + t*dz)^2 = r^2
 	// A * t^2 + 2B * t + C = 0
 	// A = dx^2 + dy^2 + dz^2
@@ -93,8 +91,29 @@ bool geoSphere::intersect(const Ray &inRay,
 		}
 	}
 
+	*tHit = tHitLoc;
+	*rayEpsilon = reCE * *tHit;
+
+	fillIntersection(pHit, phi, isec);
+	return true;
+}
+
+void geoSphere::postIntersect(const Ray &inRay,
+							  Intersection* isec) const
+{
+	Point3f pHit = mObjectToWorld->getInvMat()(inRay(inRay.tMax));
+	if (pHit.x == 0 && pHit.y == 0) pHit.x = 1e-5f * r;
+	Float phi = atan2(pHit.y, pHit.x);
+	if (phi < 0) phi += M_TWOPI;
+
+	fillIntersection(pHit, phi, isec);
+}
+
+void geoSphere::fillIntersection(const Point3f &pHit, Float phi,
+								 Intersection* isec) const
+{
 	// Compute parametric representation
-	theta = acos(clamp(pHit.z / r, (Float)-1, (Float)1));
+	Float theta = acos(clamp(pHit.z / r, (Float)-1, (Float)1));
 	Point2f uv(phi / phiMax,
 		(theta - thetaMin) / (thetaMax - thetaMin));
 
@@ -108,22 +127,12 @@ bool geoSphere::intersect(const Ray &inRay,
 	Vector3f dpdv = (thetaMax - thetaMin)
 		* Vector3f(pHit.z * cosPhi, pHit.z * sinPhi, -xyRadius);
 
-	*tHit = tHitLoc;
-	*rayEpsilon = reCE * *tHit;
-
 	const Transform &o2w = *mObjectToWorld;
 	*isec = Intersection(o2w(pHit),
-						 o2w(Normal3f()),
+						 normalize(o2w(Normal3f(pHit.x, pHit.y, pHit.z))),
 						 o2w(dpdu), o2w(dpdv),
 						 o2w(Normal3f()), o2w(Normal3f()),
 						 uv, this);
-	return true;
-}
-
-void geoSphere::postIntersect(const Ray &/*inRay*/,
-							  Intersection* /*isec*/) const
-{
-	// TODO: Move post intersection from intersect
 }
 
 bool geoSphere::isInside(const Point3f &p) const
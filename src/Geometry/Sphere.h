@@ -22,6 +22,10 @@ public:
 					   Intersection* isec) const;
 	bool isInside(const Point3f &pPos) const;
 
+private:
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Float phi, Intersection* isec) const;
+
 private:
 	Float r;//radius
 	Float phiMax;
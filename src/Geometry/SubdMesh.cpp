@@ -1,14 +1,133 @@
 #include "SubdMesh.h"
+#include "Tracer/Ray.h"
+#include "Geometry/Intersection.h"
 
 namespace Kaguya
 {
 
-SubdMesh::SubdMesh()
+SubdMesh::SubdMesh(std::vector<MeshVertex>           vertexBuffer,
+				   std::vector<uint32_t>             indexBuffer,
+				   std::vector<uint32_t>             faceSizeBuffer,
+				   std::shared_ptr<TextureAttribute> texAttri,
+				   std::shared_ptr<NormalAttribute>  normAttri)
+	: mVertexBuffer(std::move(vertexBuffer))
+	, mIndexBuffer(std::move(indexBuffer))
+	, mFaceSizeBuffer(std::move(faceSizeBuffer))
+	, mTessellationRate(4)
+	, mTextureAttribute(texAttri)
+	, mNormalAttibute(normAttri)
 {
+	// Embree reads vertices with 16 byte loads, keep the last one readable
+	mVertexBuffer.reserve(mVertexBuffer.size() + 1);
+
+	uint32_t faceOffset = 0;
+	for (auto faceSize : mFaceSizeBuffer)
+	{
+		for (uint32_t i = 2; i < faceSize; i++)
+		{
+			mCageTriIndices.push_back(mIndexBuffer[faceOffset]);
+			mCageTriIndices.push_back(mIndexBuffer[faceOffset + i - 1]);
+			mCageTriIndices.push_back(mIndexBuffer[faceOffset + i]);
+		}
+		faceOffset += faceSize;
+	}
+
+	bounding();
 }
 
 SubdMesh::~SubdMesh()
 {
 }
 
+void SubdMesh::bounding()
+{
+	if (mVertexBuffer.empty())
+	{
+		return;
+	}
+	// The limit surface lies inside the convex hull of the cage
+	mObjBound = Bounds3f(toPoint3f(mVertexBuffer.front()));
+	for (auto &v : mVertexBuffer)
+	{
+		mObjBound.Union(toPoint3f(v));
+	}
+}
+
+bool SubdMesh::intersect(const Ray &/*inRay*/,
+						 Intersection* /*isec*/,
+						 Float* /*tHit*/,
+						 Float* /*rayEpsilon*/) const
+{
+	return false;
+}
+
+void SubdMesh::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	// u, v are the local coordinates of the hit patch
+	isec->mPos = inRay(inRay.tMax);
+	isec->mGeomN = inRay.Ng;
+	isec->mUV = { inRay.u, inRay.v };
+}
+
+void SubdMesh::getRenderBuffer(RenderBufferTrait* trait) const
+{
+	trait->renderType = GPURenderType::TRIANGLE;
+
+	trait->vertex.data = (void*)(mVertexBuffer.data());
+	trait->vertex.count = mVertexBuffer.size();
+	trait->vertex.size = sizeof(MeshVertex) * trait->vertex.count;
+	trait->vertex.offset = 0;
+	trait->vertex.stride = sizeof(MeshVertex);
+
+	trait->index.data = (void*)(mCageTriIndices.data());
+	trait->index.count = mCageTriIndices.size();
+	trait->index.size = sizeof(uint32_t) * trait->index.count;
+	trait->index.offset = 0;
+	trait->index.stride = sizeof(uint32_t);
+}
+
+void SubdMesh::setEdgeCreases(std::vector<uint32_t> edgeIndices,
+							  std::vector<float>    weights)
+{
+	mEdgeCreaseIndices = std::move(edgeIndices);
+	mEdgeCreaseWeights = std::move(weights);
+	mEdgeCreaseWeights.resize(mEdgeCreaseIndices.size() / 2,
+							  std::numeric_limits<float>::infinity());
+}
+
+void SubdMesh::setVertexCreases(std::vector<uint32_t> vertexIndices,
+								std::vector<float>    weights)
+{
+	mVertexCreaseIndices = std::move(vertexIndices);
+	mVertexCreaseWeights = std::move(weights);
+	mVertexCreaseWeights.resize(mVertexCreaseIndices.size(),
+								std::numeric_limits<float>::infinity());
+}
+
+void SubdMesh::computeEdgeLevels(const Point3f &eye, Float pixelAngle, Float edgeLength,
+								 std::vector<float> &levels) const
+{
+	levels.resize(mIndexBuffer.size());
+	uint32_t faceOffset = 0;
+	for (auto faceSize : mFaceSizeBuffer)
+	{
+		for (uint32_t i = 0; i < faceSize; i++)
+		{
+			// Edge from the i-th vertex of the face to the next one
+			Point3f p0 = toPoint3f(mVertexBuffer[mIndexBuffer[faceOffset + i]]);
+			Point3f p1 = toPoint3f(mVertexBuffer[mIndexBuffer[faceOffset + (i + 1) % faceSize]]);
+
+			// Project onto a sphere around the eye, distance to the closer vertex
+			// keeps edges shared by two faces at the same level
+			Float dist = std::max(std::min((p0 - eye).length(), (p1 - eye).length()),
+								  static_cast<Float>(1e-4));
+			Float pixels = (p1 - p0).length() / (dist * pixelAngle);
+			levels[faceOffset + i] = static_cast<float>(
+				clamp(pixels / edgeLength, static_cast<Float>(1),
+					  static_cast<Float>(sMaxTessellationRate)));
+		}
+		faceOffset += faceSize;
+	}
+}
+
 }
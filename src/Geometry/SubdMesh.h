@@ -1,19 +1,81 @@
 #pragma once
 #include "Geometry/Mesh.h"
+#include "Geometry/PrimitiveAttribute.h"
 
 namespace Kaguya
 {
 
+// Catmull-Clark control cage, refined by the ray tracing kernel
 class SubdMesh : public Mesh
 {
 public:
-	SubdMesh();
+	SubdMesh(std::vector<MeshVertex>           vertexBuffer,
+			 std::vector<uint32_t>             indexBuffer,
+			 std::vector<uint32_t>             faceSizeBuffer,
+			 std::shared_ptr<TextureAttribute> texAttri,
+			 std::shared_ptr<NormalAttribute>  normAttri);
 	~SubdMesh();
 
 	GeometryType primitiveType() const override
 	{
 		return GeometryType::SUBDIVISION_MESH;
 	}
+
+	void bounding() override;
+
+	// Subdivision surfaces are only traced through Embree
+	bool intersect(const Ray &inRay,
+				   Intersection* isec,
+				   Float* tHit,
+				   Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
+
+	// Control cage, fan triangulated
+	void getRenderBuffer(RenderBufferTrait* trait) const override;
+
+	// Edges are pairs of vertex indices, weights are the crease sharpness
+	// in subdivision levels (inf for an infinitely sharp crease)
+	void setEdgeCreases(std::vector<uint32_t> edgeIndices,
+						std::vector<float>    weights);
+	void setVertexCreases(std::vector<uint32_t> vertexIndices,
+						  std::vector<float>    weights);
+
+	// Uniform number of segments per edge, used without adaptive tessellation
+	void setTessellationRate(Float rate) { mTessellationRate = rate; }
+	Float getTessellationRate() const { return mTessellationRate; }
+
+	// Segments of every face edge (one level per index) so that a segment
+	// covers about edgeLength pixels seen from eye, pixelAngle is the angle
+	// covered by a single pixel
+	void computeEdgeLevels(const Point3f &eye, Float pixelAngle, Float edgeLength,
+						   std::vector<float> &levels) const;
+
+	const std::vector<MeshVertex> &getVertexBuffer() const { return mVertexBuffer; }
+	const std::vector<uint32_t> &getIndexBuffer() const { return mIndexBuffer; }
+	const std::vector<uint32_t> &getFaceSizeBuffer() const { return mFaceSizeBuffer; }
+	const std::vector<uint32_t> &getEdgeCreaseIndices() const { return mEdgeCreaseIndices; }
+	const std::vector<float> &getEdgeCreaseWeights() const { return mEdgeCreaseWeights; }
+	const std::vector<uint32_t> &getVertexCreaseIndices() const { return mVertexCreaseIndices; }
+	const std::vector<float> &getVertexCreaseWeights() const { return mVertexCreaseWeights; }
+
+	static const uint32_t sMaxTessellationRate = 64;
+
+private:
+	std::vector<MeshVertex>           mVertexBuffer;
+	std::vector<uint32_t>             mIndexBuffer;
+	std::vector<uint32_t>             mFaceSizeBuffer;
+	// Fan triangulated cage for the viewer
+	std::vector<uint32_t>             mCageTriIndices;
+
+	std::vector<uint32_t>             mEdgeCreaseIndices;
+	std::vector<float>                mEdgeCreaseWeights;
+	std::vector<uint32_t>             mVertexCreaseIndices;
+	std::vector<float>                mVertexCreaseWeights;
+
+	Float                             mTessellationRate;
+
+	std::shared_ptr<TextureAttribute> mTextureAttribute;
+	std::shared_ptr<NormalAttribute>  mNormalAttibute;
 };
 
 }
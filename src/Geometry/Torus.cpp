@@ -1,4 +1,5 @@
 #include "Torus.h"
+#include "Math/MathUtil.h"
 #include "Tracer/Ray.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Shader.h"
@@ -10,47 +11,90 @@ namespace Kaguya
 /************************************************************************/
 /* Torus Fuction Definition                                             */
 /************************************************************************/
+geoTorus::geoTorus()
+{
+	bounding();
+}
 geoTorus::geoTorus(const Point3f &pos, Float radius, Float secRadius)
 {
 	c = pos;
 	r = radius;
 	sr = secRadius;
+	bounding();
 }
 
-bool geoTorus::intersect(const Ray &inRay, Intersection* /*isec*/, Float* /*tHit*/, Float* /*rayEpsilon*/) const
+void geoTorus::bounding()
 {
-	//Float coeA = inRay.d * inRay.d;//len == 1
-	Float coeB = dot(inRay.d, (inRay.o - c));
-	Float coeC = (inRay.o - c).lengthSquared() - r * r;
-	//Float delta = coeB * coeB - 4 * coeA * coeB;
-	Float delta = coeB * coeB - coeC;
-	if (delta < 0)
-	{
-		//std::cout << "No Intersection!" << std::endl;
-		return false;
-	}
-	else if (delta == 0)
+	Vector3f extent(r + sr, sr, r + sr);
+	mObjBound = Bounds3f(c - extent, c + extent);
+}
+
+bool geoTorus::intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const
+{
+	Ray ray = objectRay(inRay);
+	Vector3f o = ray.o - c;
+	const Vector3f &d = ray.d;
+	// (|p|^2 + r^2 - sr^2)^2 = 4 * r^2 * (px^2 + pz^2) with p = o + t * d
+	Float dd = d.lengthSquared();
+	Float od = dot(o, d);
+	Float K = o.lengthSquared() + sqr(r) - sqr(sr);
+	Float fourR2 = 4 * sqr(r);
+	Float roots[4];
+	int rootCount = quartic(sqr(dd),
+							4 * dd * od,
+							4 * sqr(od) + 2 * dd * K - fourR2 * (sqr(d.x) + sqr(d.z)),
+							4 * od * K - 2 * fourR2 * (o.x * d.x + o.z * d.z),
+							sqr(K) - fourR2 * (sqr(o.x) + sqr(o.z)),
+							roots);
+
+	// Nearest root inside the ray range
+	Float tHitLoc = ray.tMax;
+	bool isHit = false;
+	for (int i = 0; i < rootCount; i++)
 	{
-		//std::cout << "haha" << std::endl;
-		return true;
+		if (roots[i] > ray.tMin && roots[i] < tHitLoc)
+		{
+			tHitLoc = roots[i];
+			isHit = true;
+		}
 	}
-	else//delta > 0
+	if (!isHit)
 	{
-		//Float t1 = coeB - std::sqrt(delta);
-		//Float t2 = 2 * coeB - t1;
-		// 		if (t1 <= 0)
-		// 		{
-		// 			std::cout << "No!" << std::endl;
-		// 			return nullptrptr;
-		// 		}
-		// 		else
-		// 		{
-		// 			//std::cout << t1 << std::endl;
-		// 			return t1;
-		// 		}
-		return true;
+		return false;
 	}
+
+	*tHit = tHitLoc;
+	*rayEpsilon = reCE * *tHit;
+	fillIntersection(ray(tHitLoc), isec);
+	return true;
+}
+
+void geoTorus::postIntersect(const Ray &inRay, Intersection* isec) const
+{
+	Ray ray = objectRay(inRay);
+	fillIntersection(ray(ray.tMax), isec);
 }
+
+void geoTorus::fillIntersection(const Point3f &pHit, Intersection* isec) const
+{
+	Vector3f p = pHit - c;
+	Float xzRadius = std::sqrt(sqr(p.x) + sqr(p.z));
+	if (xzRadius == 0) xzRadius = 1e-5f * r;
+	Float cosPhi = p.x / xzRadius;
+	Float sinPhi = p.z / xzRadius;
+	Float phi = std::atan2(p.z, p.x);
+	if (phi < 0) phi += M_TWOPI;
+	Float theta = std::atan2(p.y, xzRadius - r);
+	if (theta < 0) theta += M_TWOPI;
+
+	// Away from the closest point on the center ring
+	Normal3f n(p.x - r * cosPhi, p.y, p.z - r * sinPhi);
+	Vector3f dpdu = M_TWOPI * Vector3f(-p.z, 0, p.x);
+	Vector3f dpdv = M_TWOPI * Vector3f(-p.y * cosPhi, xzRadius - r, -p.y * sinPhi);
+	makeIntersection(pHit, n, dpdu, dpdv,
+					 Point2f(phi * INV_TWOPI, theta * INV_TWOPI), isec);
+}
+
 bool geoTorus::isInside(const Point3f &pPos) const
 {
 	Float tmp = (pPos - c).lengthSquared() - (r * r + sr * sr);
@@ -7,14 +7,21 @@ namespace Kaguya
 /************************************************************************/
 /* Torus Fuction Definition                                             */
 /************************************************************************/
+// Ring around the y axis through the center
 class geoTorus : public ParametricGeomtry
 {
 public:
-	geoTorus() {};
+	geoTorus();
 	geoTorus(const Point3f &pos, Float radius, Float secRadius);
 
-	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const;
-	bool isInside(const Point3f &pPos) const;
+	void bounding() override;
+	bool intersect(const Ray &inRay, Intersection* isec, Float* tHit, Float* rayEpsilon) const override;
+	void postIntersect(const Ray &inRay, Intersection* isec) const override;
+	bool isInside(const Point3f &pPos) const override;
+
+private:
+	// Fill hit record from an object space hit point
+	void fillIntersection(const Point3f &pHit, Intersection* isec) const;
 
 public:
 	Point3f c;//center
@@ -4,12 +4,13 @@
 #include "Shading/Shader.h"
 #include "Shading/TextureMapping.h"
 #include "Shading/Texture.h"
+#include "Core/ThreadPool.h"
 
 namespace Kaguya
 {
 
-TriangleMesh::TriangleMesh(std::vector<Point3f>              vertexBuffer,
-						   std::vector<uint32_t>             indexBuffer,
+TriangleMesh::TriangleMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+						   SharedBuffer<uint32_t>            indexBuffer,
 						   const std::vector<uint32_t>      &faceSizeBuffer,
 						   size_t                            totalPrimCount,
 						   std::shared_ptr<TextureAttribute> texAttri,
@@ -21,7 +22,7 @@ TriangleMesh::TriangleMesh(std::vector<Point3f>              vertexBuffer,
 {
 	if (!isTessellated)
 	{
-		tessellate(mIndexBuffer, faceSizeBuffer, totalPrimCount);
+		tessellate(mIndexBuffer.vector(), faceSizeBuffer, totalPrimCount);
 		if (mTextureAttribute->isFaceVarying())
 		{
 			tessellate(mTextureAttribute->mIndexBuffer,
@@ -35,20 +36,13 @@ TriangleMesh::TriangleMesh(std::vector<Point3f>              vertexBuffer,
 					   totalPrimCount);
 		}
 	}
+	bounding();
 }
 
 TriangleMesh::~TriangleMesh()
 {
 }
 
-void TriangleMesh::bounding()
-{
-	for (auto &v : mVertexBuffer)
-	{
-		mObjBound.Union(v);
-	}
-}
-
 void TriangleMesh::printInfo(const std::string &/*msg*/) const
 {
 	/* if (!msg.empty())
@@ -82,27 +76,29 @@ bool TriangleMesh::intersect(const Ray &/*inRay*/, Intersection* /*isec*/,
 
 void TriangleMesh::postIntersect(const Ray &inRay, Intersection* isec) const
 {
-	// TODO: Implement post-intersection method
 	uint32_t primID = inRay.primID;
-	uint32_t id1 = mIndexBuffer[primID * sTriFaceSize];
-	uint32_t id2 = mIndexBuffer[primID * sTriFaceSize + 1];
-	uint32_t id3 = mIndexBuffer[primID * sTriFaceSize + 2];
+	const uint32_t* vIDs = mIndexBuffer.data() + primID * sTriFaceSize;
+
+	Point3f p[sTriFaceSize];
+	cornerPositions(vIDs, sTriFaceSize, inRay.time, p);
 
-	isec->mGeomN = inRay.Ng;
+	Point2f uv[sTriFaceSize];
+	bool hasUV = cornerTexcoords(primID, sTriFaceSize, vIDs, uv);
+	Normal3f n[sTriFaceSize];
+	bool hasNormal = cornerNormals(primID, sTriFaceSize, vIDs, n);
+
+	isec->mGeomN = normalize(inRay.Ng);
 	isec->mUV = { inRay.u, inRay.v };
-	Float s = isec->mUV.x;
-	Float t = isec->mUV.y;
-	Float w = 1.0 - s - t;
-	isec->mPos = mVertexBuffer[id1] * w
-		+ mVertexBuffer[id2] * s
-		+ mVertexBuffer[id3] * t;
+	TriangleUtils::postIntersect(p,
+								 hasUV ? uv : nullptr,
+								 hasNormal ? n : nullptr,
+								 inRay.u, inRay.v, isec);
 }
 
 void TriangleMesh::getTessellated(TessBuffer &trait) const
 {
-	// TODO: Implementation check required
 	// Setup time step
-	size_t timestep = 1;
+	size_t timestep = getTimeStepCount();
 	trait.nTimeStep = timestep;
 	trait.nGeomId = getGeomID();
 
@@ -110,15 +106,15 @@ void TriangleMesh::getTessellated(TessBuffer &trait) const
 	trait.nVertices = mVertexCount;
 	trait.vertTraits.resize(timestep);
 	trait.vertTraits[0].byteOffset = 0;
-	trait.vertTraits[0].byteStride = sizeof(Point3f);
+	trait.vertTraits[0].byteStride = sizeof(MeshVertex);
 	trait.vertTraits[0].data = (void*)(mVertexBuffer.data());
 
 	// Setup buffers for Motion Blur
 	for (size_t i = 1; i < timestep; i++)
 	{
 		trait.vertTraits[i].byteOffset = 0;
-		trait.vertTraits[i].byteStride = sizeof(Point3f);
-		trait.vertTraits[i].data = (void*)(mVertexBuffer.data());
+		trait.vertTraits[i].byteStride = sizeof(MeshVertex);
+		trait.vertTraits[i].data = (void*)(mMotionVertexBuffers[i - 1].data());
 	}
 
 	// Setup index buffer
@@ -132,21 +128,40 @@ void TriangleMesh::tessellate(std::vector<uint32_t> &indexBuffer,
 							  const std::vector<uint32_t> &faceSizeBuffer,
 							  size_t tessellatedCount)
 {
-	size_t nCurrentPosition = indexBuffer.size();
-	size_t nLastPosition = tessellatedCount * sTriFaceSize;
-	indexBuffer.resize(nLastPosition);
+	std::vector<size_t> srcOffsets, dstOffsets;
+	faceOffsets(faceSizeBuffer, sTriFaceSize, srcOffsets, dstOffsets);
 
-	for (int i = faceSizeBuffer.size() - 1; i >= 0; i--)
+	// Fan triangulation, written out of place so faces are independent
+	std::vector<uint32_t> tessellated(tessellatedCount * sTriFaceSize);
+	auto splitFaces = [&](size_t faceBegin, size_t faceEnd)
 	{
-		nCurrentPosition -= faceSizeBuffer[i];
-
-		for (int j = faceSizeBuffer[i] - 2; j > 0; j--)
+		for (size_t i = faceBegin; i < faceEnd; i++)
 		{
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + j + 1];
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition + j];
-			indexBuffer[--nLastPosition] = indexBuffer[nCurrentPosition];
+			const uint32_t* src = indexBuffer.data() + srcOffsets[i];
+			uint32_t* dst = tessellated.data() + dstOffsets[i];
+			for (uint32_t j = 1; j + 1 < faceSizeBuffer[i]; j++)
+			{
+				*dst++ = src[0];
+				*dst++ = src[j];
+				*dst++ = src[j + 1];
+			}
 		}
+	};
+	size_t faceCount = faceSizeBuffer.size();
+	if (faceCount <= sTessellateGrainSize)
+	{
+		splitFaces(0, faceCount);
+	}
+	else
+	{
+		size_t chunkCount = (faceCount + sTessellateGrainSize - 1) / sTessellateGrainSize;
+		parallelFor(0, chunkCount, [&](size_t chunk)
+		{
+			splitFaces(chunk * sTessellateGrainSize,
+					   std::min(faceCount, (chunk + 1) * sTessellateGrainSize));
+		});
 	}
+	indexBuffer.swap(tessellated);
 }
 
 /************************************************************************/
@@ -248,41 +263,67 @@ bool TriangleUtils::intersectWatertight(const Point3f &p0,
 	return true;
 }
 
-void TriangleUtils::postIntersect(const Point3f &p0,
-								  const Point3f &p1,
-								  const Point3f &p2,
-								  const Ray &/*inRay*/,
-								  Intersection* /*isec*/)
+void TriangleUtils::postIntersect(const Point3f* p,
+								  const Point2f* uv,
+								  const Normal3f* n,
+								  Float b1, Float b2,
+								  Intersection* isec)
 {
-	Vector3f v1 __attribute__((unused)) = p1 - p0;
-	Vector3f v2 __attribute__((unused)) = p2 - p0;
+	Float b0 = 1 - b1 - b2;
+	isec->mPos = p[0] * b0 + p[1] * b1 + p[2] * b2;
+
+	// Without texture coordinates, use the default triangle parameterization
+	const Point2f defaultUV[3] = { Point2f(0, 0), Point2f(1, 0), Point2f(1, 1) };
+	if (uv == nullptr)
+	{
+		uv = defaultUV;
+	}
 
 	// Compute dpdu, dpdv
-	//
-#if 0
-	Vector3f dpdu, dpdv;
-	Float du1 = uv[1]->x - uv[0]->x;
-	Float dv1 = uv[1]->y - uv[0]->y;
-	Float du2 = uv[2]->x - uv[0]->x;
-	Float dv2 = uv[2]->y - uv[0]->y;
-	Float detUV = du1 * dv2 - dv1 * du2;
-	if (detUV == 0.0)
+	Vector3f dp02 = p[0] - p[2];
+	Vector3f dp12 = p[1] - p[2];
+	Float du02 = uv[0].x - uv[2].x;
+	Float dv02 = uv[0].y - uv[2].y;
+	Float du12 = uv[1].x - uv[2].x;
+	Float dv12 = uv[1].y - uv[2].y;
+	Float detUV = du02 * dv12 - dv02 * du12;
+	bool degenerateUV = std::abs(detUV) < 1e-12;
+	Float invDetUV = degenerateUV ? 0 : 1 / detUV;
+	if (degenerateUV)
 	{
-		coordinateSystem(Vector3f(isec->Ng), &isec->dPdu, &isec->dPdv);
+		coordinateSystem(Vector3f(isec->mGeomN), &isec->mPu, &isec->mPv);
 	}
 	else
 	{
-		Float invDetUV = 1. / detUV;
-		isec->dPdu = (v1 * dv2 - v2 * dv1) * invDetUV;
-		isec->dPdv = (v2 * du1 - v1 * du2) * invDetUV;
+		isec->mPu = (dp02 * dv12 - dp12 * dv02) * invDetUV;
+		isec->mPv = (dp12 * du02 - dp02 * du12) * invDetUV;
 	}
 
 	// Interpolate Texture Coordinates
-	Float s = isec->UV.x;
-	Float t = isec->UV.y;
-	Float w = 1.0 - s - t;
-	isec->shading.ST = *uv[0] * w + *uv[1] * s + *uv[2] * t;
-#endif
+	isec->mST = uv[0] * b0 + uv[1] * b1 + uv[2] * b2;
+	isec->mPs = isec->mPu;
+	isec->mPt = isec->mPv;
+
+	// Shading normal and its derivatives
+	isec->mNu = isec->mNv = Normal3f();
+	isec->mShadingN = isec->mGeomN;
+	if (n != nullptr)
+	{
+		Normal3f ns = n[0] * b0 + n[1] * b1 + n[2] * b2;
+		if (ns.lengthSquared() > 0)
+		{
+			isec->mShadingN = normalize(ns);
+		}
+		if (!degenerateUV)
+		{
+			Normal3f dn02 = n[0] - n[2];
+			Normal3f dn12 = n[1] - n[2];
+			isec->mNu = (dn02 * dv12 - dn12 * dv02) * invDetUV;
+			isec->mNv = (dn12 * du02 - dn02 * du12) * invDetUV;
+		}
+	}
+	isec->mNs = isec->mNu;
+	isec->mNt = isec->mNv;
 }
 
 }
@@ -7,8 +7,8 @@ namespace Kaguya
 class TriangleMesh : public PolyMesh
 {
 public:
-	TriangleMesh(std::vector<Point3f>              vertexBuffer,
-				 std::vector<uint32_t>             indexBuffer,
+	TriangleMesh(SharedBuffer<MeshVertex>          vertexBuffer,
+				 SharedBuffer<uint32_t>            indexBuffer,
 				 const std::vector<uint32_t>      &faceSizeBuffer,
 				 size_t                            totalPrimCount,
 				 std::shared_ptr<TextureAttribute> texAttri,
@@ -16,8 +16,6 @@ public:
 				 bool                              isTessellated = true);
 	~TriangleMesh();
 
-	void bounding() override;
-
 	void printInfo(const std::string &msg) const override;
 
 	bool intersect(const Ray &inRay,
@@ -56,10 +54,13 @@ bool intersectWatertight(const Point3f &p0,
 						 const Point3f &p2,
 						 Ray &inRay, Float* tHit, Float* rayEpsilon);
 
-void postIntersect(const Point3f &p0,
-				   const Point3f &p1,
-				   const Point3f &p2,
-				   const Ray &inRay, Intersection* isec);
+// Position, derivatives, texture coordinates and shading normal at
+// barycentric (b1, b2), isec->mGeomN must be set. uv and n may be null.
+void postIntersect(const Point3f* p,
+				   const Point2f* uv,
+				   const Normal3f* n,
+				   Float b1, Float b2,
+				   Intersection* isec);
 
 }
 
@@ -0,0 +1,225 @@
+#include "IO/MeshCache.h"
+#include "Geometry/TriangleMesh.h"
+#include "Geometry/QuadMesh.h"
+#include "Core/MappedFile.h"
+
+#include <filesystem>
+
+namespace Kaguya
+{
+
+namespace MeshCache
+{
+
+// Blocks keep 16 bytes of slack so Embree may read past the last element
+static size_t blockSize(size_t byteSize)
+{
+	return (byteSize + 16 + 63) & ~size_t(63);
+}
+
+static bool sourceStamp(const std::string &sourceFilename,
+						uint64_t &sourceSize, int64_t &sourceTime)
+{
+	std::error_code err;
+	sourceSize = std::filesystem::file_size(sourceFilename, err);
+	if (err)
+	{
+		return false;
+	}
+	auto writeTime = std::filesystem::last_write_time(sourceFilename, err);
+	sourceTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+	return !err;
+}
+
+static bool writeBlock(std::FILE* fp, const void* data, size_t byteSize)
+{
+	static const char sZeros[64 + 16] = {};
+	size_t padding = blockSize(byteSize) - byteSize;
+	return (byteSize == 0 || std::fwrite(data, 1, byteSize, fp) == byteSize)
+		&& std::fwrite(sZeros, 1, padding, fp) == padding;
+}
+
+// Size of the file the header describes
+static size_t fileSize(const MeshCacheHeader &header)
+{
+	return sizeof(MeshCacheHeader)
+		+ blockSize(sizeof(MeshVertex) * header.vertexCount)
+		+ blockSize(sizeof(uint32_t) * header.indexCount)
+		+ blockSize(sizeof(Point2f) * header.uvCount)
+		+ blockSize(sizeof(uint32_t) * header.uvIndexCount)
+		+ blockSize(sizeof(Normal3f) * header.normalCount)
+		+ blockSize(sizeof(uint32_t) * header.normalIndexCount);
+}
+
+static bool isValidHeader(const MeshCacheHeader &header,
+						  const std::string &sourceFilename)
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	return std::memcmp(header.magic, "KGYMESH", 8) == 0
+		&& header.version == sVersion
+		&& header.floatSize == sizeof(Float)
+		&& (header.faceSize == TriangleMesh::getFaceSize()
+			|| header.faceSize == QuadMesh::getFaceSize())
+		&& header.indexCount % header.faceSize == 0
+		&& sourceStamp(sourceFilename, sourceSize, sourceTime)
+		&& header.sourceSize == sourceSize
+		&& header.sourceTime == sourceTime;
+}
+
+template <typename T>
+static std::shared_ptr<AttributeRate<T>> readAttribute(const char* &ptr,
+													   uint32_t attriType,
+													   size_t valueCount,
+													   size_t indexCount)
+{
+	const T* values = reinterpret_cast<const T*>(ptr);
+	ptr += blockSize(sizeof(T) * valueCount);
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(ptr);
+	ptr += blockSize(sizeof(uint32_t) * indexCount);
+	if (attriType == static_cast<uint32_t>(AttributeType::UNDEFINED))
+	{
+		return nullptr;
+	}
+	auto attri = std::make_shared<AttributeRate<T>>(static_cast<AttributeType>(attriType));
+	attri->mValueBuffer.assign(values, values + valueCount);
+	attri->mIndexBuffer.assign(indices, indices + indexCount);
+	return attri;
+}
+
+bool write(const std::string &filename,
+		   const std::string &sourceFilename,
+		   const PolyMesh &mesh)
+{
+	const TextureAttribute* texAttri = mesh.getTextureAttribute();
+	const NormalAttribute* normAttri = mesh.getNormalAttribute();
+
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, "KGYMESH", 8);
+	header.version = sVersion;
+	header.faceSize = static_cast<uint32_t>(mesh.polyMeshType() == PolyMeshType::TRIANGLE
+		? TriangleMesh::getFaceSize() : QuadMesh::getFaceSize());
+	header.floatSize = sizeof(Float);
+	header.textureType = static_cast<uint32_t>(texAttri ? texAttri->mType : AttributeType::UNDEFINED);
+	header.normalType = static_cast<uint32_t>(normAttri ? normAttri->mType : AttributeType::UNDEFINED);
+	if (!sourceStamp(sourceFilename, header.sourceSize, header.sourceTime))
+	{
+		return false;
+	}
+	header.vertexCount = mesh.getVertexBuffer().size();
+	header.indexCount = mesh.getIndexBuffer().size();
+	header.uvCount = texAttri ? texAttri->getValueCount() : 0;
+	header.uvIndexCount = texAttri ? texAttri->getIndexCount() : 0;
+	header.normalCount = normAttri ? normAttri->getValueCount() : 0;
+	header.normalIndexCount = normAttri ? normAttri->getIndexCount() : 0;
+	const Bounds3f &bounds = mesh.getWorldBounding();
+	for (int i = 0; i < 3; i++)
+	{
+		header.bounds[i] = static_cast<float>(bounds.pMin[i]);
+		header.bounds[i + 3] = static_cast<float>(bounds.pMax[i]);
+	}
+
+	// Write aside and rename, readers never see a partial file. Meshes
+	// load concurrently, so writers of one cache get their own file.
+	static std::atomic<uint32_t> sWriteCount(0);
+	std::string tmpFilename = filename + "." + std::to_string(sWriteCount++) + ".tmp";
+	std::FILE* fp = std::fopen(tmpFilename.c_str(), "wb");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	bool isWritten = std::fwrite(&header, sizeof(MeshCacheHeader), 1, fp) == 1
+		&& writeBlock(fp, mesh.getVertexBuffer().data(), sizeof(MeshVertex) * header.vertexCount)
+		&& writeBlock(fp, mesh.getIndexBuffer().data(), sizeof(uint32_t) * header.indexCount)
+		&& writeBlock(fp, texAttri ? texAttri->getValuePtr() : nullptr,
+					  sizeof(Point2f) * header.uvCount)
+		&& writeBlock(fp, texAttri ? texAttri->getIndexPtr() : nullptr,
+					  sizeof(uint32_t) * header.uvIndexCount)
+		&& writeBlock(fp, normAttri ? normAttri->getValuePtr() : nullptr,
+					  sizeof(Normal3f) * header.normalCount)
+		&& writeBlock(fp, normAttri ? normAttri->getIndexPtr() : nullptr,
+					  sizeof(uint32_t) * header.normalIndexCount);
+	isWritten = (std::fclose(fp) == 0) && isWritten;
+	if (!isWritten)
+	{
+		std::remove(tmpFilename.c_str());
+		return false;
+	}
+	std::remove(filename.c_str());
+	return std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+std::shared_ptr<PolyMesh> read(const std::string &filename,
+							   const std::string &sourceFilename)
+{
+	auto file = std::make_shared<const MappedFile>(filename);
+	if (!file->isValid() || file->size() < sizeof(MeshCacheHeader))
+	{
+		return nullptr;
+	}
+	MeshCacheHeader header;
+	std::memcpy(&header, file->data(), sizeof(MeshCacheHeader));
+	if (!isValidHeader(header, sourceFilename) || file->size() != fileSize(header))
+	{
+		return nullptr;
+	}
+
+	// Vertices and indices stay in the mapping, which the buffers keep open
+	const char* ptr = file->data() + sizeof(MeshCacheHeader);
+	SharedBuffer<MeshVertex> vertexBuffer(file, reinterpret_cast<const MeshVertex*>(ptr),
+										  header.vertexCount);
+	ptr += blockSize(sizeof(MeshVertex) * header.vertexCount);
+	SharedBuffer<uint32_t> indexBuffer(file, reinterpret_cast<const uint32_t*>(ptr),
+									   header.indexCount);
+	ptr += blockSize(sizeof(uint32_t) * header.indexCount);
+	auto texAttri = readAttribute<Point2f>(ptr, header.textureType,
+										   header.uvCount, header.uvIndexCount);
+	auto normAttri = readAttribute<Normal3f>(ptr, header.normalType,
+											 header.normalCount, header.normalIndexCount);
+
+	size_t primCount = header.indexCount / header.faceSize;
+	if (header.faceSize == TriangleMesh::getFaceSize())
+	{
+		return std::make_shared<TriangleMesh>(std::move(vertexBuffer),
+											  std::move(indexBuffer),
+											  std::vector<uint32_t>(),
+											  primCount,
+											  texAttri,
+											  normAttri,
+											  true);
+	}
+	return std::make_shared<QuadMesh>(std::move(vertexBuffer),
+									  std::move(indexBuffer),
+									  std::vector<uint32_t>(),
+									  primCount,
+									  texAttri,
+									  normAttri,
+									  true);
+}
+
+bool readBounds(const std::string &filename,
+				const std::string &sourceFilename,
+				Bounds3f &bounds)
+{
+	std::FILE* fp = std::fopen(filename.c_str(), "rb");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+	MeshCacheHeader header;
+	bool isRead = std::fread(&header, sizeof(MeshCacheHeader), 1, fp) == 1
+		&& std::fseek(fp, 0, SEEK_END) == 0
+		&& static_cast<size_t>(std::ftell(fp)) == fileSize(header);
+	std::fclose(fp);
+	if (!isRead || !isValidHeader(header, sourceFilename))
+	{
+		return false;
+	}
+	bounds = Bounds3f(Point3f(header.bounds[0], header.bounds[1], header.bounds[2]),
+					  Point3f(header.bounds[3], header.bounds[4], header.bounds[5]));
+	return true;
+}
+
+}
+
+}
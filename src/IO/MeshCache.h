@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Geometry/PolyMesh.h"
+
+namespace Kaguya
+{
+
+// Binary cache of tessellated polygonal meshes.
+// Layout: MeshCacheHeader, then vertex, index, uv, uv index, normal and
+// normal index blocks, each starting on a 64 byte boundary. Vertex and
+// index blocks are used in place from the mapped file.
+namespace MeshCache
+{
+
+// Bump whenever the layout or the tessellation changes
+static const uint32_t sVersion = 2;
+
+struct MeshCacheHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t faceSize;
+	uint32_t floatSize;
+	uint32_t textureType;
+	uint32_t normalType;
+	uint32_t padding0;
+	// Size and modification time of the source file
+	uint64_t sourceSize;
+	int64_t  sourceTime;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t uvCount;
+	uint64_t uvIndexCount;
+	uint64_t normalCount;
+	uint64_t normalIndexCount;
+	// Mesh bounds, min then max corner
+	float    bounds[6];
+	uint8_t  padding1[8];
+};
+static_assert(sizeof(MeshCacheHeader) == 128, "Mesh cache header is 128 bytes");
+
+bool write(const std::string &filename,
+		   const std::string &sourceFilename,
+		   const PolyMesh &mesh);
+
+// Returns nullptr on a missing, stale or foreign file
+std::shared_ptr<PolyMesh> read(const std::string &filename,
+							   const std::string &sourceFilename);
+
+// Mesh bounds from the header alone, false when read would fail
+bool readBounds(const std::string &filename,
+				const std::string &sourceFilename,
+				Bounds3f &bounds);
+
+}
+
+}
@@ -1,318 +1,433 @@
 #include "ObjLoader.h"
-#include "Geometry/Geometry.h"
-#include "Geometry/PolyMesh.h"
-#include "Geometry/TriangleMesh.h"
-#include "Core/Utils.h"
+#include "Core/MappedFile.h"
+#include "Core/ThreadPool.h"
 
 namespace Kaguya
 {
 
-ObjLoader::ObjLoader(const std::string &filename)
-	: fp(std::fopen(filename.c_str(), "r"))
-	, vertRange{}
-	, uvRange{}
-	, normRange{}
-	, vertCount(0), uvCount(0), normCount(0)
-	, mFilename(filename)
+// Geometry parsed from one line aligned piece of an OBJ file.
+// Negative (relative) indices are stored relative to the chunk start,
+// their positions are kept to fix them up once chunks are merged.
+struct ObjChunk
 {
-	if (fp != nullptr)
+	std::vector<MeshVertex> vertexBuffer;
+	std::vector<Point2f>    uvBuffer;
+	std::vector<Normal3f>   normBuffer;
+	std::vector<uint32_t>   faceIndexBuffer;
+	std::vector<uint32_t>   uvIndexBuffer;
+	std::vector<uint32_t>   normIndexBuffer;
+	std::vector<uint32_t>   faceSizeBuffer;
+	std::vector<uint32_t>   lineIndexBuffer;
+	std::vector<uint32_t>   lineSizeBuffer;
+	std::vector<uint32_t>   relativeFaceIndices;
+	std::vector<uint32_t>   relativeUVIndices;
+	std::vector<uint32_t>   relativeNormIndices;
+	std::vector<uint32_t>   relativeLineIndices;
+
+	// Element counts, used as running offsets when merging
+	size_t vertexCount = 0;
+	size_t uvCount = 0;
+	size_t normCount = 0;
+	size_t faceIndexCount = 0;
+	size_t uvIndexCount = 0;
+	size_t normIndexCount = 0;
+	size_t faceSizeCount = 0;
+	size_t lineIndexCount = 0;
+	size_t lineSizeCount = 0;
+
+	void setSizes(const ObjChunk &counts)
+	{
+		vertexCount = counts.vertexCount;
+		uvCount = counts.uvCount;
+		normCount = counts.normCount;
+		faceIndexCount = counts.faceIndexCount;
+		uvIndexCount = counts.uvIndexCount;
+		normIndexCount = counts.normIndexCount;
+		faceSizeCount = counts.faceSizeCount;
+		lineIndexCount = counts.lineIndexCount;
+		lineSizeCount = counts.lineSizeCount;
+	}
+	void addSizes(const ObjChunk &chunk)
 	{
-		parse(fp);
-		fclose(fp);
+		vertexCount += chunk.vertexBuffer.size();
+		uvCount += chunk.uvBuffer.size();
+		normCount += chunk.normBuffer.size();
+		faceIndexCount += chunk.faceIndexBuffer.size();
+		uvIndexCount += chunk.uvIndexBuffer.size();
+		normIndexCount += chunk.normIndexBuffer.size();
+		faceSizeCount += chunk.faceSizeBuffer.size();
+		lineIndexCount += chunk.lineIndexBuffer.size();
+		lineSizeCount += chunk.lineSizeBuffer.size();
 	}
+};
 
+// Bytes per parsing task
+static const size_t sObjChunkSize = 4 << 20;
+
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t';
 }
 
-ObjLoader::~ObjLoader()
+static inline bool isDigit(char c)
 {
+	return c >= '0' && c <= '9';
 }
 
-ObjLoader::index_t ObjLoader::facetype(const char* str, int32_t* val)
+static inline const char* skipBlanks(const char* ptr, const char* end)
 {
-	int argv = sscanf(str, "%d/%d/%d%*[ \t]", val, val + 1, val + 2);
-	switch (argv)
+	while (ptr < end && isBlank(*ptr))
 	{
-	case 3:// V/T/N
-		return VTN;//111
-	case 2:// V/T
-		return VT;//011
-	case 1:
-		argv = sscanf(str, "%d//%d%*[ \t]", val, val + 2);
-		if (argv == 2)// V//N
-		{
-			return VN;//101
-		}
-		return V;
-	default:// V
-		return V;;//001
+		ptr++;
 	}
+	return ptr;
 }
 
-void ObjLoader::parse(std::FILE* fp)
+static inline const char* skipLine(const char* ptr, const char* end)
 {
-	int err;
-	char buff[256] = {};
-	char lineHeader[16] = {};
-	Float val[3] = {};
-
-	while (true)
+	while (ptr < end && *ptr != '\n')
 	{
-		lineHeader[0] = lineHeader[1] = 0;
-		err = fscanf(fp, "%6s", lineHeader);
-		if (err == EOF)
-		{
-			break;
-		}
-
-		bool isBoundary = Utils::startsWith(lineHeader, "g")
-			|| Utils::startsWith(lineHeader, "o")
-			|| Utils::startsWith(lineHeader, "s")
-			|| Utils::startsWith(lineHeader, "usemtl");
-
-		if (isBoundary && !faceIndexBuffer.empty())
-		{
-			mPrims.emplace_back(finalizeMesh());
-			clearMeshBuffers();
-		}
-
+		ptr++;
+	}
+	return ptr < end ? ptr + 1 : end;
+}
 
-		// Vertex
-		if (Utils::startsWith(lineHeader, "v"))
-		{
-			fscanf(fp, "%f %f %f", val, val + 1, val + 2);
-			vertexBuffer.emplace_back(val);
-		}
-		// Texture Coordinate
-		else if (Utils::startsWith(lineHeader, "vt"))
+// Decimal or scientific notation, ptr stays put when there is no number
+static const char* parseFloat(const char* ptr, const char* end, Float &val)
+{
+	static const double sPow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+		1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+	};
+	const char* start = ptr;
+	bool isNegative = ptr < end && *ptr == '-';
+	if (ptr < end && (*ptr == '-' || *ptr == '+'))
+	{
+		ptr++;
+	}
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digitCount = 0;
+	bool hasDigits = false;
+	for (; ptr < end && isDigit(*ptr); ptr++, hasDigits = true)
+	{
+		// Digits past the precision of a double only scale the value
+		if (digitCount < 18)
 		{
-			fscanf(fp, "%f %f", val, val + 1);
-			uvBuffer.emplace_back(val);
+			mantissa = mantissa * 10 + (*ptr - '0');
+			digitCount += mantissa != 0;
 		}
-		// Vertex Normal
-		else if (Utils::startsWith(lineHeader, "vn"))
+		else
 		{
-			fscanf(fp, "%f %f %f", val, val + 1, val + 2);
-			normBuffer.emplace_back(val);
+			exponent++;
 		}
-		// Face Index
-		else if (Utils::startsWith(lineHeader, "f"))
+	}
+	if (ptr < end && *ptr == '.')
+	{
+		for (ptr++; ptr < end && isDigit(*ptr); ptr++, hasDigits = true)
 		{
-			if (faceIndexBuffer.empty())
+			if (digitCount < 18)
 			{
-				updateBufferRange();
+				mantissa = mantissa * 10 + (*ptr - '0');
+				digitCount += mantissa != 0;
+				exponent--;
 			}
-			parseFace(fp);
-		}
-		// Comment
-		else if (Utils::startsWith(lineHeader, "#"))
-		{
-			// Skip comments
-			fscanf(fp, "%[^\r\n]", buff);
 		}
-		else if (Utils::startsWith(lineHeader, "g"))
+	}
+	if (!hasDigits)
+	{
+		return start;
+	}
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+	{
+		const char* expPtr = ptr + 1;
+		bool isExpNegative = expPtr < end && *expPtr == '-';
+		if (expPtr < end && (*expPtr == '-' || *expPtr == '+'))
 		{
-			fscanf(fp, "%s", buff);
-			mFilename = std::string(buff);
+			expPtr++;
 		}
-		// Others
-		else
+		if (expPtr < end && isDigit(*expPtr))
 		{
-			// skip everything except \n or \r
-			fscanf(fp, "%[^\r\n]", buff);
+			int expVal = 0;
+			for (; expPtr < end && isDigit(*expPtr); expPtr++)
+			{
+				expVal = std::min(expVal * 10 + (*expPtr - '0'), 1000);
+			}
+			exponent += isExpNegative ? -expVal : expVal;
+			ptr = expPtr;
 		}
 	}
-	fclose(fp);
-}
 
-void ObjLoader::parseFace(std::FILE* fp)
-{
-	char buff[256] = {};
-	int32_t indices[3];
-	char endflg;
-
-	int err = fscanf(fp, "%s", buff);
-	if (err == EOF) {
-		return;
+	double result = static_cast<double>(mantissa);
+	if (exponent < 0)
+	{
+		result = -exponent <= 18
+			? result / sPow10[-exponent] : result * std::pow(10.0, exponent);
 	}
-	indices[1] = indices[2] = 0;
-	index_t ft = facetype(buff, indices);
-	auto addIndex = [] (std::vector<uint32_t> &indices, int32_t id,
-						size_t bufferSize, size_t bufferOffset) {
-		indices.push_back(id > 0 ? id - bufferOffset - 1
-						  : bufferSize + id);
-	};
-
-	addIndex(faceIndexBuffer, indices[0], vertCount, vertRange[0]);
-	int count = 1;
-	endflg = fgetc(fp);
-	switch (ft)
+	else if (exponent > 0)
 	{
-	case VTN://111
-		addIndex(uvIndexBuffer, indices[1], uvCount, uvRange[0]);
-		addIndex(normIndexBuffer, indices[2], normCount, normRange[0]);
-		while (endflg != '\n' && endflg != '\r' && endflg != EOF)
-		{
-			ungetc(endflg, fp);
-			fscanf(fp, "%d/%d/%d%*[ \t]", indices, indices + 1, indices + 2);
-			addIndex(faceIndexBuffer, indices[0], vertCount, vertRange[0]);
-			addIndex(uvIndexBuffer, indices[1], uvCount, uvRange[0]);
-			addIndex(normIndexBuffer, indices[2], normCount, normRange[0]);
-			count++;
-			endflg = fgetc(fp);
-		}
-		faceSizeBuffer.push_back(count);
-		break;
-	case VT://011
-		addIndex(uvIndexBuffer, indices[1], uvCount, uvRange[0]);
-		while (endflg != '\n' && endflg != '\r' && endflg != EOF)
-		{
-			ungetc(endflg, fp);
-			fscanf(fp, "%d/%d%*[ \t]", indices, indices + 1);
-			addIndex(faceIndexBuffer, indices[0], vertCount, vertRange[0]);
-			addIndex(uvIndexBuffer, indices[1], uvCount, uvRange[0]);
-			count++;
-			endflg = fgetc(fp);
-		}
-		faceSizeBuffer.push_back(count);
-		break;
-	case VN://101
-		addIndex(normIndexBuffer, indices[2], normCount, normRange[0]);
-		while (endflg != '\n' && endflg != '\r' && endflg != EOF)
-		{
-			ungetc(endflg, fp);
-			fscanf(fp, "%d//%d%*[ \t]", indices, indices + 2);
-			addIndex(faceIndexBuffer, indices[0], vertCount, vertRange[0]);
-			addIndex(normIndexBuffer, indices[2], normCount, normRange[0]);
-			count++;
-			endflg = fgetc(fp);
-		}
-		faceSizeBuffer.push_back(count);
-		break;
-	case V://001
-		while (endflg != '\n' && endflg != '\r' && endflg != EOF)
-		{
-			ungetc(endflg, fp);
-			fscanf(fp, "%d%*[ \t]", indices);
-			addIndex(faceIndexBuffer, indices[0], vertCount, vertRange[0]);
-			count++;
-			endflg = fgetc(fp);
-		}
-		faceSizeBuffer.push_back(count);
-		break;
-	default:
-		break;
+		result = exponent <= 18
+			? result * sPow10[exponent] : result * std::pow(10.0, exponent);
 	}
+	val = static_cast<Float>(isNegative ? -result : result);
+	return ptr;
 }
 
-void ObjLoader::updateBufferRange()
+static const char* parseInt(const char* ptr, const char* end, int64_t &val)
 {
-	if (vertRange[1] < vertexBuffer.size())
+	const char* start = ptr;
+	bool isNegative = ptr < end && *ptr == '-';
+	if (ptr < end && (*ptr == '-' || *ptr == '+'))
 	{
-		vertRange[0] = vertRange[1];
-		vertRange[1] = vertexBuffer.size();
-		vertCount = vertRange[1] - vertRange[0];
+		ptr++;
 	}
-	if (uvRange[1] < uvBuffer.size())
+	if (ptr == end || !isDigit(*ptr))
 	{
-		uvRange[0] = uvRange[1];
-		uvRange[1] = uvBuffer.size();
-		uvCount = uvRange[1] - uvRange[0];
+		return start;
 	}
-	if (normRange[1] < normBuffer.size())
+	int64_t result = 0;
+	for (; ptr < end && isDigit(*ptr); ptr++)
 	{
-		normRange[0] = normRange[1];
-		normRange[1] = normBuffer.size();
-		normCount = normRange[1] - normRange[0];
+		result = result * 10 + (*ptr - '0');
 	}
+	val = isNegative ? -result : result;
+	return ptr;
 }
 
-void ObjLoader::clearMeshBuffers()
-{
-	faceIndexBuffer.clear();
-	uvIndexBuffer.clear();
-	normIndexBuffer.clear();
-	faceSizeBuffer.clear();
-
-	texAttr.reset();
-	texAttr.reset();
-}
-
-void ObjLoader::finalizeAttributes()
+// One based indices become zero based, relative ones are counted back
+// from the elements seen so far in the chunk and recorded for fix up
+static inline void addObjIndex(int64_t id, size_t elementCount,
+							   std::vector<uint32_t> &indices,
+							   std::vector<uint32_t> &relativePos)
 {
-	// use vertexBufferFinal, fid
-	texAttr = uvIndexBuffer.size() == faceIndexBuffer.size() ?
-		std::make_shared<TextureAttribute>(
-			std::vector<Point2f>(uvBuffer.begin() + uvRange[0],
-								 uvBuffer.begin() + uvRange[1]),
-			uvIndexBuffer) :
-		std::make_shared<TextureAttribute>();
-	normAttr = normIndexBuffer.size() == faceIndexBuffer.size() ?
-		std::make_shared<NormalAttribute>(
-			std::vector<Normal3f>(normBuffer.begin() + normRange[0],
-								  normBuffer.begin() + normRange[1]),
-			normIndexBuffer) :
-		std::make_shared<NormalAttribute>();
-}
-
-std::shared_ptr<Geometry> ObjLoader::finalizeMesh()
-{
-	return PolyMesh::createPolyMesh(std::vector<Point3f>(vertexBuffer.begin() + vertRange[0],
-														 vertexBuffer.begin() + vertRange[1]),
-									faceIndexBuffer,
-									faceSizeBuffer,
-									texAttr,
-									normAttr);
-}
-
-std::shared_ptr<TriangleMesh> ObjLoader::finalizeTriangeMesh()
-{
-	return PolyMesh::createTriMesh(std::vector<Point3f>(vertexBuffer.begin() + vertRange[0],
-														vertexBuffer.begin() + vertRange[1]),
-								   faceIndexBuffer,
-								   faceSizeBuffer,
-								   texAttr,
-								   normAttr);
+	if (id < 0)
+	{
+		relativePos.push_back(static_cast<uint32_t>(indices.size()));
+		indices.push_back(static_cast<uint32_t>(static_cast<int64_t>(elementCount) + id));
+	}
+	else
+	{
+		indices.push_back(static_cast<uint32_t>(id - 1));
+	}
 }
 
-std::vector<std::shared_ptr<Geometry>> ObjLoader::load(const std::string &filename)
+static void parseObjChunk(const char* ptr, const char* end, ObjChunk &chunk)
 {
-	ObjLoader loader(filename);
-	if (!loader.faceIndexBuffer.empty())
+	Float val[3];
+	while (ptr < end)
 	{
-		loader.finalizeAttributes();
-		loader.mPrims.emplace_back(loader.finalizeMesh());
+		ptr = skipBlanks(ptr, end);
+		if (ptr + 1 >= end)
+		{
+			break;
+		}
+		if (ptr[0] == 'v' && isBlank(ptr[1]))
+		{
+			// Vertex, extra components (w or colors) are ignored
+			val[0] = val[1] = val[2] = 0;
+			ptr += 2;
+			for (int i = 0; i < 3; i++)
+			{
+				ptr = parseFloat(skipBlanks(ptr, end), end, val[i]);
+			}
+			chunk.vertexBuffer.push_back(toMeshVertex(Point3f(val[0], val[1], val[2])));
+		}
+		else if (ptr[0] == 'v' && ptr[1] == 't')
+		{
+			// Texture Coordinate
+			val[0] = val[1] = 0;
+			ptr += 2;
+			for (int i = 0; i < 2; i++)
+			{
+				ptr = parseFloat(skipBlanks(ptr, end), end, val[i]);
+			}
+			chunk.uvBuffer.emplace_back(val[0], val[1]);
+		}
+		else if (ptr[0] == 'v' && ptr[1] == 'n')
+		{
+			// Vertex Normal
+			val[0] = val[1] = val[2] = 0;
+			ptr += 2;
+			for (int i = 0; i < 3; i++)
+			{
+				ptr = parseFloat(skipBlanks(ptr, end), end, val[i]);
+			}
+			chunk.normBuffer.emplace_back(val[0], val[1], val[2]);
+		}
+		else if (ptr[0] == 'f' && isBlank(ptr[1]))
+		{
+			// Face corners as v, v/t, v/t/n or v//n
+			ptr++;
+			uint32_t count = 0;
+			while (true)
+			{
+				ptr = skipBlanks(ptr, end);
+				int64_t id = 0;
+				const char* next = parseInt(ptr, end, id);
+				if (next == ptr)
+				{
+					break;
+				}
+				ptr = next;
+				addObjIndex(id, chunk.vertexBuffer.size(),
+							chunk.faceIndexBuffer, chunk.relativeFaceIndices);
+				if (ptr < end && *ptr == '/')
+				{
+					ptr++;
+					next = parseInt(ptr, end, id);
+					if (next != ptr)
+					{
+						ptr = next;
+						addObjIndex(id, chunk.uvBuffer.size(),
+									chunk.uvIndexBuffer, chunk.relativeUVIndices);
+					}
+					if (ptr < end && *ptr == '/')
+					{
+						ptr++;
+						next = parseInt(ptr, end, id);
+						if (next != ptr)
+						{
+							ptr = next;
+							addObjIndex(id, chunk.normBuffer.size(),
+										chunk.normIndexBuffer, chunk.relativeNormIndices);
+						}
+					}
+				}
+				count++;
+			}
+			if (count > 0)
+			{
+				chunk.faceSizeBuffer.push_back(count);
+			}
+		}
+		else if (ptr[0] == 'l' && isBlank(ptr[1]))
+		{
+			// Polyline points as v or v/t, texture indices are skipped
+			ptr++;
+			uint32_t count = 0;
+			while (true)
+			{
+				ptr = skipBlanks(ptr, end);
+				int64_t id = 0;
+				const char* next = parseInt(ptr, end, id);
+				if (next == ptr)
+				{
+					break;
+				}
+				ptr = next;
+				addObjIndex(id, chunk.vertexBuffer.size(),
+							chunk.lineIndexBuffer, chunk.relativeLineIndices);
+				if (ptr < end && *ptr == '/')
+				{
+					ptr = parseInt(ptr + 1, end, id);
+				}
+				count++;
+			}
+			if (count > 0)
+			{
+				chunk.lineSizeBuffer.push_back(count);
+			}
+		}
+		// Comments, groups, materials and everything else
+		ptr = skipLine(ptr, end);
 	}
-	return loader.mPrims;
 }
 
-std::shared_ptr<TriangleMesh> ObjLoader::loadTriangleMesh(const std::string &filename)
+bool ObjLoader::loadRawBuffers(ObjBuffers &retBuffers, const std::string &filename)
 {
-	ObjLoader loader(filename);
-	if (!loader.faceIndexBuffer.empty())
+	MappedFile file(filename);
+	if (!file.isValid())
 	{
-		//updateBufferRange();
-		loader.finalizeAttributes();
-		return std::shared_ptr<TriangleMesh>(loader.finalizeTriangeMesh());
+		return false;
 	}
+	const char* data = file.data();
+	const char* fileEnd = data + file.size();
 
-	return nullptr;
-}
+	// Line aligned chunks, parsed independently
+	size_t chunkCount = std::min(
+		(file.size() + sObjChunkSize - 1) / sObjChunkSize,
+		static_cast<size_t>(ThreadPool::global().getThreadCount()) * 4 + 1);
+	std::vector<const char*> chunkBegins(chunkCount + 1, fileEnd);
+	chunkBegins[0] = data;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* ptr = std::max(chunkBegins[i - 1],
+								   data + file.size() / chunkCount * i);
+		while (ptr < fileEnd && *ptr != '\n')
+		{
+			ptr++;
+		}
+		chunkBegins[i] = ptr < fileEnd ? ptr + 1 : fileEnd;
+	}
 
-bool ObjLoader::loadRawBuffers(ObjBuffers &retBuffers, const std::string &filename)
-{
-	ObjLoader loader(filename);
+	std::vector<ObjChunk> chunks(chunkCount);
+	parallelFor(0, chunkCount, [&](size_t i)
+	{
+		parseObjChunk(chunkBegins[i], chunkBegins[i + 1], chunks[i]);
+	});
 
-	if (loader.faceIndexBuffer.empty())
+	// Offsets of every chunk in the merged buffers
+	ObjChunk total;
+	std::vector<ObjChunk> offsets(chunkCount);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		offsets[i].setSizes(total);
+		total.addSizes(chunks[i]);
+	}
+	if (total.faceSizeCount == 0 && total.lineSizeCount == 0)
 	{
 		return false;
 	}
-	retBuffers.vertexBuffer    = std::move(loader.vertexBuffer);
-	retBuffers.uvBuffer        = std::move(loader.uvBuffer);
-	retBuffers.normBuffer      = std::move(loader.normBuffer);
-	retBuffers.faceIndexBuffer = std::move(loader.faceIndexBuffer);
-	retBuffers.uvIndexBuffer   = std::move(loader.uvIndexBuffer);
-	retBuffers.normIndexBuffer = std::move(loader.normIndexBuffer);
-	retBuffers.faceSizeBuffer  = std::move(loader.faceSizeBuffer);
+	retBuffers.vertexBuffer.resize(total.vertexCount);
+	retBuffers.uvBuffer.resize(total.uvCount);
+	retBuffers.normBuffer.resize(total.normCount);
+	retBuffers.faceIndexBuffer.resize(total.faceIndexCount);
+	retBuffers.uvIndexBuffer.resize(total.uvIndexCount);
+	retBuffers.normIndexBuffer.resize(total.normIndexCount);
+	retBuffers.faceSizeBuffer.resize(total.faceSizeCount);
+	retBuffers.lineIndexBuffer.resize(total.lineIndexCount);
+	retBuffers.lineSizeBuffer.resize(total.lineSizeCount);
+
+	// Merge, then resolve relative indices now that the number of
+	// elements before each chunk is known
+	parallelFor(0, chunkCount, [&](size_t i)
+	{
+		ObjChunk &chunk = chunks[i];
+		const ObjChunk &offset = offsets[i];
+		std::copy(chunk.vertexBuffer.begin(), chunk.vertexBuffer.end(),
+				  retBuffers.vertexBuffer.begin() + offset.vertexCount);
+		std::copy(chunk.uvBuffer.begin(), chunk.uvBuffer.end(),
+				  retBuffers.uvBuffer.begin() + offset.uvCount);
+		std::copy(chunk.normBuffer.begin(), chunk.normBuffer.end(),
+				  retBuffers.normBuffer.begin() + offset.normCount);
+		std::copy(chunk.faceSizeBuffer.begin(), chunk.faceSizeBuffer.end(),
+				  retBuffers.faceSizeBuffer.begin() + offset.faceSizeCount);
+		std::copy(chunk.lineSizeBuffer.begin(), chunk.lineSizeBuffer.end(),
+				  retBuffers.lineSizeBuffer.begin() + offset.lineSizeCount);
+
+		auto mergeIndices = [](const std::vector<uint32_t> &src,
+							   const std::vector<uint32_t> &relativePos,
+							   std::vector<uint32_t> &dst,
+							   size_t dstOffset, size_t elementOffset)
+		{
+			uint32_t* out = dst.data() + dstOffset;
+			std::copy(src.begin(), src.end(), out);
+			for (auto pos : relativePos)
+			{
+				// Unsigned wrap around gives the absolute index
+				out[pos] += static_cast<uint32_t>(elementOffset);
+			}
+		};
+		mergeIndices(chunk.faceIndexBuffer, chunk.relativeFaceIndices,
+					 retBuffers.faceIndexBuffer, offset.faceIndexCount, offset.vertexCount);
+		mergeIndices(chunk.uvIndexBuffer, chunk.relativeUVIndices,
+					 retBuffers.uvIndexBuffer, offset.uvIndexCount, offset.uvCount);
+		mergeIndices(chunk.normIndexBuffer, chunk.relativeNormIndices,
+					 retBuffers.normIndexBuffer, offset.normIndexCount, offset.normCount);
+		mergeIndices(chunk.lineIndexBuffer, chunk.relativeLineIndices,
+					 retBuffers.lineIndexBuffer, offset.lineIndexCount, offset.vertexCount);
+		chunk = ObjChunk();
+	});
 
 	return true;
 }
@@ -3,28 +3,189 @@
 #include "Camera/PerspectiveCamera.h"
 #include "Camera/OrthographicCamera.h"
 #include "Geometry/Mesh.h"
+#include "Geometry/Curve.h"
+#include "Geometry/PolyMesh.h"
+#include "Geometry/SubdMesh.h"
+#include "Geometry/DeferredGeometry.h"
+#include "IO/MeshCache.h"
+
+#include "Core/ThreadPool.h"
+
+#include <rapidjson/reader.h>
+#include <rapidjson/error/en.h>
 
 namespace Kaguya
 {
 
-SceneLoader::SceneLoader(const std::string &filename)
+// SAX handler handing top level members of the scene file to a callback
+// as soon as they are parsed. Elements of "primitives" are handed one at
+// a time, so at most one entry is held as a DOM. A settings pass skips
+// the primitives, a primitives pass skips everything else.
+class SceneStreamHandler
+	: public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, SceneStreamHandler>
 {
-	if (filename.empty())
+public:
+	enum class Pass
 	{
-		return;
+		SETTINGS,
+		PRIMITIVES
+	};
+	// value only lives for the duration of the call
+	typedef std::function<void(const std::string &key, rapidjson::Value &value)> Callback;
+
+	SceneStreamHandler(Pass pass, Callback onValue)
+		: mPass(pass)
+		, mOnValue(std::move(onValue))
+		, mAllocator(sChunkSize)
+	{
+	}
+
+	bool Null() { return add(rapidjson::Value()); }
+	bool Bool(bool b) { return add(rapidjson::Value(b)); }
+	bool Int(int i) { return add(rapidjson::Value(i)); }
+	bool Uint(unsigned u) { return add(rapidjson::Value(u)); }
+	bool Int64(int64_t i) { return add(rapidjson::Value(i)); }
+	bool Uint64(uint64_t u) { return add(rapidjson::Value(u)); }
+	bool Double(double d) { return add(rapidjson::Value(d)); }
+	bool String(const char* str, rapidjson::SizeType length, bool /*copy*/)
+	{
+		return add(rapidjson::Value(str, length, mAllocator));
+	}
+
+	bool StartObject()
+	{
+		// The root object itself is never built
+		if (mDepth++ > 0 && !mIsSkipping)
+		{
+			mStack.emplace_back(rapidjson::kObjectType);
+		}
+		return true;
+	}
+	bool Key(const char* str, rapidjson::SizeType length, bool /*copy*/)
+	{
+		if (mDepth == 1)
+		{
+			mKey.assign(str, length);
+			mIsSkipping = (mKey == "primitives") != (mPass == Pass::PRIMITIVES);
+		}
+		else if (!mIsSkipping)
+		{
+			mStack.emplace_back(str, length, mAllocator);
+		}
+		return true;
+	}
+	bool EndObject(rapidjson::SizeType /*memberCount*/)
+	{
+		return --mDepth == 0 || mIsSkipping || endContainer();
+	}
+	bool StartArray()
+	{
+		if (mIsSkipping)
+		{
+			mDepth++;
+		}
+		else if (mDepth++ == 1 && mKey == "primitives")
+		{
+			mIsStreaming = true;
+		}
+		else
+		{
+			mStack.emplace_back(rapidjson::kArrayType);
+		}
+		return true;
+	}
+	bool EndArray(rapidjson::SizeType /*elementCount*/)
+	{
+		if (--mDepth == 1 && mIsStreaming)
+		{
+			mIsStreaming = false;
+			return true;
+		}
+		return mIsSkipping || endContainer();
+	}
+
+private:
+	bool endContainer()
+	{
+		rapidjson::Value value(std::move(mStack.back()));
+		mStack.pop_back();
+		return add(std::move(value));
+	}
+
+	bool add(rapidjson::Value &&value)
+	{
+		if (mIsSkipping)
+		{
+			return true;
+		}
+		if (mStack.empty())
+		{
+			// A top level member or a primitive entry is complete
+			mOnValue(mKey, value);
+			value.SetNull();
+			mAllocator.Clear();
+			return true;
+		}
+		rapidjson::Value &parent = mStack.back();
+		if (parent.IsArray())
+		{
+			parent.PushBack(value, mAllocator);
+			return true;
+		}
+		// Parent is the key of a member of the enclosing object
+		rapidjson::Value key(std::move(parent));
+		mStack.pop_back();
+		mStack.back().AddMember(key, value, mAllocator);
+		return true;
+	}
+
+	// Entries are small, the default 64KB chunks would mostly stay unused
+	static const size_t sChunkSize = 4096;
+
+	Pass                             mPass;
+	Callback                         mOnValue;
+	rapidjson::MemoryPoolAllocator<> mAllocator;
+	// Open containers and pending member keys
+	std::vector<rapidjson::Value>    mStack;
+	std::string                      mKey;
+	uint32_t                         mDepth = 0;
+	bool                             mIsStreaming = false;
+	// Set for the whole top level member the pass does not handle
+	bool                             mIsSkipping = false;
+};
+
+static bool parseSceneFile(const std::string &filename,
+						   SceneStreamHandler &handler,
+						   rapidjson::ParseResult &result)
+{
+	std::FILE* fp = std::fopen(filename.c_str(), "rb");
+	if (fp == nullptr)
+	{
+		return false;
 	}
-	/*FILE* fp = fopen(filename.c_str(), "rb");
 	char readBuffer[65536];
-	rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
-	rapidjson::Document d;
-	d.ParseStream(is);
-	fclose(fp);*/
+	rapidjson::FileReadStream stream(fp, readBuffer, sizeof(readBuffer));
+	rapidjson::Reader reader;
+	result = reader.Parse(stream, handler);
+	std::fclose(fp);
+	return true;
+}
+
+// Slot of one "primitives" entry, filled by its load task.
+// The entry has its own storage, released once it is loaded.
+struct PendingPrimitive
+{
+	PendingPrimitive() : allocator(sChunkSize) {}
 
-	std::ifstream ifs(filename, std::ifstream::in);
-	std::stringstream strStream;
-	strStream << ifs.rdbuf(); // 1
-	ifs.close();
+	static const size_t sChunkSize = 4096;
 
+	rapidjson::MemoryPoolAllocator<> allocator;
+	rapidjson::Value                 entry;
+	std::shared_ptr<Geometry>        geometry;
+};
+
+SceneLoader::SceneLoader(const std::string &filename)
+{
 	for (size_t i = 0; i < filename.size(); i++)
 	{
 		char curChar = *(filename.end() - i - 1);
@@ -35,8 +196,6 @@ SceneLoader::SceneLoader(const std::string &filename)
 			break;
 		}
 	}
-
-	mDocument.Parse(strStream.str().c_str());
 }
 
 SceneLoader::~SceneLoader()
@@ -45,38 +204,113 @@ SceneLoader::~SceneLoader()
 
 Scene* SceneLoader::load(const std::string &filename)
 {
-	SceneLoader loader(filename);
+	// Shared with deferred primitives, which load their entry later
+	auto loader = std::make_shared<SceneLoader>(filename);
 	std::shared_ptr<Camera> camPtr;
 	std::vector<std::shared_ptr<RenderPrimitive>> primArray;
 	std::vector<std::shared_ptr<Light>> lightArray;
-	if (loader.mDocument.HasMember("camera"))
+	RenderOptions options;
+
+	// Settings and prototypes come first wherever they sit in the file,
+	// the primitives array is only tokenized by this pass
+	SceneStreamHandler settingsHandler(SceneStreamHandler::Pass::SETTINGS,
+		[&](const std::string &key, rapidjson::Value &value)
 	{
-		auto &jsonCamera = loader.mDocument.FindMember("camera")->value;
-		if (jsonCamera.IsObject())
+		if (key == "renderer")
+		{
+			options = loader->loadRenderOptions(value);
+			loader->mCompactMeshes = options.compactMeshes;
+			loader->mMeshCache = options.meshCache;
+			loader->mDeferredLoading = options.deferredLoading;
+		}
+		else if (key == "camera")
 		{
-			camPtr = loader.loadCamera(jsonCamera);
+			if (value.IsObject())
+			{
+				camPtr = loader->loadCamera(value);
+			}
+			else if (value.IsArray())
+			{
+				// get all cameras
+			}
 		}
-		else if (jsonCamera.IsArray())
+		else if (key == "prototypes" && value.IsArray())
 		{
-			// get all cameras
+			// Prototypes can instance the prototypes listed before them
+			for (auto &prototype : value.GetArray())
+			{
+				loader->loadPrototype(prototype);
+			}
 		}
+	});
+	rapidjson::ParseResult result;
+	if (!parseSceneFile(filename, settingsHandler, result))
+	{
+		std::cout << "Failed to open scene file " << filename << std::endl;
+		return new Scene(camPtr, primArray, lightArray, options);
+	}
+	if (result.IsError())
+	{
+		std::cout << "Failed to parse scene file " << filename
+			<< " at offset " << result.Offset() << ": "
+			<< rapidjson::GetParseError_En(result.Code()) << std::endl;
 	}
 
-	if (loader.mDocument.HasMember("primitives"))
+	// Primitive files load on the pool while parsing goes on,
+	// results are gathered in file order afterwards
+	ThreadPool &pool = ThreadPool::global();
+	TaskGroup loadGroup;
+	std::deque<PendingPrimitive> pending;
+	// Bounds the entries held at once, parsing helps loading when reached
+	const size_t maxQueuedCount = 4 * (pool.getThreadCount() + 1);
+	size_t queuedCount = 0;
+
+	// Entries before a parse error still load
+	SceneStreamHandler primitiveHandler(SceneStreamHandler::Pass::PRIMITIVES,
+		[&](const std::string &/*key*/, rapidjson::Value &value)
 	{
-		for (auto &prim : loader.mDocument["primitives"].GetArray())
+		pending.emplace_back();
+		PendingPrimitive &slot = pending.back();
+		Bounds3f deferredBounds;
+		if (loader->getDeferredBounds(value, deferredBounds))
+		{
+			// Only deferred entries outlive the load
+			loader->mDeferredEntries.emplace_back(value, loader->mDeferredAllocator);
+			const rapidjson::Value* jsonPrim = &loader->mDeferredEntries.back();
+			slot.geometry = std::make_shared<DeferredGeometry>(deferredBounds,
+				[loader, jsonPrim]() { return loader->loadGeometry(*jsonPrim); });
+			slot.geometry->setName(value["file"].GetString());
+		}
+		else
 		{
-			std::shared_ptr<Geometry> retPrim = loader.loadGeometry(prim);
-			std::shared_ptr<Light> geomEmission;
-			if (retPrim != nullptr)
+			slot.entry.CopyFrom(value, slot.allocator);
+			pool.run(loadGroup, [&loader, &slot]()
+			{
+				slot.geometry = loader->loadGeometry(slot.entry);
+				slot.entry.SetNull();
+				slot.allocator.Clear();
+			});
+			if (++queuedCount == maxQueuedCount)
 			{
-				primArray.emplace_back(std::make_shared<RenderPrimitive>(retPrim,
-																		 geomEmission));
+				pool.wait(loadGroup);
+				queuedCount = 0;
 			}
 		}
+	});
+	parseSceneFile(filename, primitiveHandler, result);
+
+	pool.wait(loadGroup);
+	for (auto &slot : pending)
+	{
+		std::shared_ptr<Light> geomEmission;
+		if (slot.geometry != nullptr)
+		{
+			primArray.emplace_back(std::make_shared<RenderPrimitive>(slot.geometry,
+																	 geomEmission));
+		}
 	}
 
-	return new Scene(camPtr, primArray, lightArray);
+	return new Scene(camPtr, primArray, lightArray, options);
 }
 
 std::shared_ptr<Camera> SceneLoader::loadCamera(const rapidjson::Value &jsonCamera) const
@@ -169,12 +403,12 @@ std::shared_ptr<Geometry> SceneLoader::loadGeometry(const rapidjson::Value &json
 		if (!strcmp(typeStr, "mesh"))
 		{
 			MeshType meshType = MeshType::POLYGONAL_MESH;
-			uint32_t subdivLevel __attribute__((unused)) = 1;
+			uint32_t subdivLevel = 1;
 			if (jsonCamera.HasMember("is_subdiv"))
 			{
 				if (jsonCamera["is_subdiv"].GetBool())
 				{
-					meshType = MeshType::POLYGONAL_MESH;
+					meshType = MeshType::SUBDIVISION_MESH;
 					if (jsonCamera.HasMember("subdiv_level"))
 					{
 						subdivLevel = jsonCamera["subdiv_level"].GetUint();
@@ -184,16 +418,313 @@ std::shared_ptr<Geometry> SceneLoader::loadGeometry(const rapidjson::Value &json
 			if (jsonCamera.HasMember("file"))
 			{
 				const char* filename = jsonCamera["file"].GetString();
-				retPrimPtr = createMesh(mFilePath + filename, meshType);
+				bool isCached = jsonCamera.HasMember("cache")
+					? jsonCamera["cache"].GetBool() : mMeshCache;
+				retPrimPtr = createMesh(mFilePath + filename, meshType,
+										isCached ? mFilePath + filename + ".kmesh" : "");
+				if (retPrimPtr == nullptr)
+				{
+					return retPrimPtr;
+				}
 				retPrimPtr->setName(filename);
 			}
+			if (meshType == MeshType::POLYGONAL_MESH && retPrimPtr != nullptr
+				&& jsonCamera.HasMember("motion_files"))
+			{
+				loadMotionSteps(jsonCamera["motion_files"],
+								static_cast<PolyMesh*>(retPrimPtr.get()));
+			}
+			bool isCompact = jsonCamera.HasMember("compact")
+				? jsonCamera["compact"].GetBool() : mCompactMeshes;
+			if (meshType == MeshType::POLYGONAL_MESH && retPrimPtr != nullptr && isCompact)
+			{
+				static_cast<PolyMesh*>(retPrimPtr.get())->compressAttributes();
+			}
+			if (meshType == MeshType::SUBDIVISION_MESH && retPrimPtr != nullptr)
+			{
+				auto subdMesh = static_cast<SubdMesh*>(retPrimPtr.get());
+				// Each subdivision level doubles the segments of an edge
+				subdMesh->setTessellationRate(static_cast<Float>(1 << std::min(subdivLevel, 6u)));
+				loadCreases(jsonCamera, subdMesh);
+			}
 		}
 		else if (!strcmp(typeStr, "curves"))
 		{
-			// TODO
+			CurveLoadOptions options;
+			if (jsonCamera.HasMember("curve_basis"))
+			{
+				options.basis = strcmp(jsonCamera["curve_basis"].GetString(), "linear")
+					? CurveBasis::BEZIER : CurveBasis::LINEAR;
+			}
+			if (jsonCamera.HasMember("curve_thickness"))
+			{
+				options.thickness = jsonCamera["curve_thickness"].GetFloat();
+			}
+			if (jsonCamera.HasMember("curve_taper"))
+			{
+				options.taper = jsonCamera["curve_taper"].GetBool();
+			}
+			if (jsonCamera.HasMember("subsample"))
+			{
+				options.subsample = jsonCamera["subsample"].GetFloat();
+			}
+			if (jsonCamera.HasMember("file"))
+			{
+				const char* filename = jsonCamera["file"].GetString();
+				retPrimPtr = createCurves(mFilePath + filename, options);
+				if (retPrimPtr == nullptr)
+				{
+					std::cout << "Failed to load curves from " << filename << std::endl;
+					return retPrimPtr;
+				}
+				retPrimPtr->setName(filename);
+			}
+		}
+		else if (!strcmp(typeStr, "instance"))
+		{
+			const char* prototypeName = jsonCamera.HasMember("prototype")
+				? jsonCamera["prototype"].GetString() : "";
+			auto prototype = mPrototypes.find(prototypeName);
+			if (prototype == mPrototypes.end())
+			{
+				std::cout << "Instance prototype \"" << prototypeName
+					<< "\" not found." << std::endl;
+				return retPrimPtr;
+			}
+			Transform xform = jsonCamera.HasMember("transform")
+				? loadTransform(jsonCamera["transform"]) : Transform();
+			retPrimPtr = std::make_shared<Instance>(prototype->second, xform);
 		}
 	}
 	return retPrimPtr;
 }
 
+RenderOptions SceneLoader::loadRenderOptions(const rapidjson::Value &jsonRenderer) const
+{
+	RenderOptions options;
+	if (jsonRenderer.HasMember("output_file"))
+	{
+		options.outputFile = jsonRenderer["output_file"].GetString();
+	}
+	if (jsonRenderer.HasMember("spp"))
+	{
+		options.samplesPerPixel = jsonRenderer["spp"].GetUint();
+	}
+	if (jsonRenderer.HasMember("sampler"))
+	{
+		options.samplerType = jsonRenderer["sampler"].GetString();
+	}
+	if (jsonRenderer.HasMember("seed"))
+	{
+		options.seed = jsonRenderer["seed"].GetUint64();
+	}
+	if (jsonRenderer.HasMember("subdiv_edge_length"))
+	{
+		options.subdivEdgeLength = jsonRenderer["subdiv_edge_length"].GetFloat();
+	}
+	if (jsonRenderer.HasMember("compact_meshes"))
+	{
+		options.compactMeshes = jsonRenderer["compact_meshes"].GetBool();
+	}
+	if (jsonRenderer.HasMember("mesh_cache"))
+	{
+		options.meshCache = jsonRenderer["mesh_cache"].GetBool();
+	}
+	if (jsonRenderer.HasMember("deferred_loading"))
+	{
+		options.deferredLoading = jsonRenderer["deferred_loading"].GetBool();
+	}
+	if (jsonRenderer.HasMember("build_quality"))
+	{
+		// "low" for previews, "high" for final frames
+		const char* qualityStr = jsonRenderer["build_quality"].GetString();
+		if (!strcmp(qualityStr, "low"))
+		{
+			options.buildQuality = AccelBuildQuality::LOW;
+		}
+		else if (!strcmp(qualityStr, "high"))
+		{
+			options.buildQuality = AccelBuildQuality::HIGH;
+		}
+		else
+		{
+			options.buildQuality = AccelBuildQuality::MEDIUM;
+		}
+	}
+	if (jsonRenderer.HasMember("scene_flags"))
+	{
+		for (auto &jsonFlag : jsonRenderer["scene_flags"].GetArray())
+		{
+			const char* flagStr = jsonFlag.GetString();
+			if (!strcmp(flagStr, "compact"))
+			{
+				options.sceneFlags |= ACCEL_SCENE_COMPACT;
+			}
+			else if (!strcmp(flagStr, "robust"))
+			{
+				options.sceneFlags |= ACCEL_SCENE_ROBUST;
+			}
+			else if (!strcmp(flagStr, "dynamic"))
+			{
+				options.sceneFlags |= ACCEL_SCENE_DYNAMIC;
+			}
+			else
+			{
+				std::cout << "Unknown scene flag " << flagStr << std::endl;
+			}
+		}
+	}
+	if (jsonRenderer.HasMember("threads"))
+	{
+		options.threadCount = jsonRenderer["threads"].GetUint();
+	}
+	if (jsonRenderer.HasMember("isa"))
+	{
+		options.isa = jsonRenderer["isa"].GetString();
+	}
+	if (jsonRenderer.HasMember("device_config"))
+	{
+		options.deviceConfig = jsonRenderer["device_config"].GetString();
+	}
+	return options;
+}
+
+bool SceneLoader::getDeferredBounds(const rapidjson::Value &jsonPrim, Bounds3f &bounds) const
+{
+	// Polygonal mesh files only
+	if (!jsonPrim.HasMember("type") || strcmp(jsonPrim["type"].GetString(), "mesh")
+		|| !jsonPrim.HasMember("file")
+		|| (jsonPrim.HasMember("is_subdiv") && jsonPrim["is_subdiv"].GetBool()))
+	{
+		return false;
+	}
+	bool isDeferred = jsonPrim.HasMember("deferred")
+		? jsonPrim["deferred"].GetBool() : mDeferredLoading;
+	if (!isDeferred)
+	{
+		return false;
+	}
+	// "bounds": [[min x, min y, min z], [max x, max y, max z]]
+	if (jsonPrim.HasMember("bounds"))
+	{
+		auto &jsonBounds = jsonPrim["bounds"];
+		bounds = Bounds3f(Point3f(jsonBounds[0][0].GetFloat(),
+								  jsonBounds[0][1].GetFloat(),
+								  jsonBounds[0][2].GetFloat()),
+						  Point3f(jsonBounds[1][0].GetFloat(),
+								  jsonBounds[1][1].GetFloat(),
+								  jsonBounds[1][2].GetFloat()));
+		return true;
+	}
+	// Otherwise from the mesh cache, which only covers the first motion step
+	std::string filename = mFilePath + jsonPrim["file"].GetString();
+	return !jsonPrim.HasMember("motion_files")
+		&& MeshCache::readBounds(filename + ".kmesh", filename, bounds);
+}
+
+void SceneLoader::loadMotionSteps(const rapidjson::Value &jsonFiles, PolyMesh* mesh) const
+{
+	// Each file holds the same mesh at a later time step
+	std::vector<std::vector<MeshVertex>> motionVertexBuffers;
+	for (auto &jsonFile : jsonFiles.GetArray())
+	{
+		std::vector<MeshVertex> verts;
+		std::vector<Point2f> uvs;
+		std::vector<Normal3f> norms;
+		std::vector<uint32_t> faceId, texcoordId, normId, faceCount;
+		if (!objFileParser::parse((mFilePath + jsonFile.GetString()).c_str(),
+								  verts, uvs, norms, faceId, texcoordId, normId, faceCount))
+		{
+			std::cout << "Failed to load motion step " << jsonFile.GetString() << std::endl;
+			return;
+		}
+		motionVertexBuffers.push_back(std::move(verts));
+	}
+	if (!mesh->setMotionVertexBuffers(std::move(motionVertexBuffers)))
+	{
+		std::cout << "Motion steps must keep the vertex count of the mesh, "
+			"motion blur is disabled." << std::endl;
+	}
+}
+
+void SceneLoader::loadCreases(const rapidjson::Value &jsonMesh, SubdMesh* mesh) const
+{
+	// "creases": { "edges": [v0, v1, ...], "edge_weights": [...],
+	//              "vertices": [...], "vertex_weights": [...] }
+	if (!jsonMesh.HasMember("creases"))
+	{
+		return;
+	}
+	auto &jsonCreases = jsonMesh["creases"];
+	auto readUints = [&jsonCreases](const char* name)
+	{
+		std::vector<uint32_t> ret;
+		if (jsonCreases.HasMember(name))
+		{
+			for (auto &value : jsonCreases[name].GetArray())
+			{
+				ret.push_back(value.GetUint());
+			}
+		}
+		return ret;
+	};
+	auto readFloats = [&jsonCreases](const char* name)
+	{
+		std::vector<float> ret;
+		if (jsonCreases.HasMember(name))
+		{
+			for (auto &value : jsonCreases[name].GetArray())
+			{
+				ret.push_back(value.GetFloat());
+			}
+		}
+		return ret;
+	};
+	mesh->setEdgeCreases(readUints("edges"), readFloats("edge_weights"));
+	mesh->setVertexCreases(readUints("vertices"), readFloats("vertex_weights"));
+}
+
+void SceneLoader::loadPrototype(const rapidjson::Value &jsonPrototype)
+{
+	if (!jsonPrototype.HasMember("name") || !jsonPrototype.HasMember("primitives"))
+	{
+		return;
+	}
+	std::vector<std::shared_ptr<Geometry>> prims;
+	for (auto &prim : jsonPrototype["primitives"].GetArray())
+	{
+		std::shared_ptr<Geometry> retPrim = loadGeometry(prim);
+		if (retPrim != nullptr)
+		{
+			prims.push_back(retPrim);
+		}
+	}
+	mPrototypes[jsonPrototype["name"].GetString()] =
+		std::make_shared<InstancePrototype>(prims);
+}
+
+Transform SceneLoader::loadTransform(const rapidjson::Value &jsonTransform) const
+{
+	Vector3f position(0, 0, 0), rotation(0, 0, 0), scale(1, 1, 1);
+	if (jsonTransform.HasMember("position"))
+	{
+		auto &value = jsonTransform["position"];
+		position = Vector3f(value[0].GetFloat(), value[1].GetFloat(), value[2].GetFloat());
+	}
+	if (jsonTransform.HasMember("rotation"))
+	{
+		auto &value = jsonTransform["rotation"];
+		rotation = Vector3f(value[0].GetFloat(), value[1].GetFloat(), value[2].GetFloat());
+	}
+	if (jsonTransform.HasMember("scale"))
+	{
+		auto &value = jsonTransform["scale"];
+		scale = Vector3f(value[0].GetFloat(), value[1].GetFloat(), value[2].GetFloat());
+	}
+	// Scale, then rotate (degrees), then translate
+	return Transform(Matrix4x4::translate(position)
+					 * Matrix4x4::rotate(rotation.x, rotation.y, rotation.z)
+					 * Matrix4x4::scale(scale.x, scale.y, scale.z));
+}
+
 }
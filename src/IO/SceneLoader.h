@@ -1,5 +1,6 @@
 #pragma once
 #include "Core/Scene.h"
+#include "Geometry/Instance.h"
 
 #include <rapidjson/filereadstream.h>
 #include <rapidjson/document.h>
@@ -7,6 +8,9 @@
 namespace Kaguya
 {
 
+class PolyMesh;
+class SubdMesh;
+
 class SceneLoader
 {
 public:
@@ -18,10 +22,30 @@ public:
 private:
 	std::shared_ptr<Camera> loadCamera(const rapidjson::Value &jsonCamera) const;
 	std::shared_ptr<Geometry> loadGeometry(const rapidjson::Value &jsonCamera) const;
+	// Bounds of a primitive to load on first hit, false to load it now
+	bool getDeferredBounds(const rapidjson::Value &jsonPrim, Bounds3f &bounds) const;
+	RenderOptions loadRenderOptions(const rapidjson::Value &jsonRenderer) const;
+	void loadMotionSteps(const rapidjson::Value &jsonFiles, PolyMesh* mesh) const;
+	void loadCreases(const rapidjson::Value &jsonMesh, SubdMesh* mesh) const;
+	void loadPrototype(const rapidjson::Value &jsonPrototype);
+	Transform loadTransform(const rapidjson::Value &jsonTransform) const;
 
 private:
-	rapidjson::Document mDocument;
 	std::string mFilePath;
+	// Default of the per mesh "compact" flag
+	bool mCompactMeshes = false;
+	// Default of the per mesh "cache" flag
+	bool mMeshCache = false;
+	// Default of the per mesh "deferred" flag
+	bool mDeferredLoading = false;
+
+	// Named primitive groups shared by "instance" primitives
+	std::unordered_map<std::string, std::shared_ptr<InstancePrototype>> mPrototypes;
+
+	// Scene file entries of deferred primitives, the rest is dropped once
+	// parsed. Deque keeps entries in place as it grows.
+	rapidjson::MemoryPoolAllocator<>  mDeferredAllocator;
+	std::deque<rapidjson::Value>      mDeferredEntries;
 
 };
 
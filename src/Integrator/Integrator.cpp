@@ -1,35 +1,114 @@
 #include "Integrator.h"
 #include "Core/Scene.h"
+#include "Core/ThreadPool.h"
 #include "Camera/Camera.h"
+#include "Geometry/Intersection.h"
+#include "Tracer/RayBatch.h"
 
 namespace Kaguya
 {
 
 void SampleIntegrator::render(const Scene &scene)
 {
+	preprocess(scene, mSampler);
+
 	auto& camera = scene.getCamera();
-	uint32_t width = camera->getFilm().width;
-	uint32_t height = camera->getFilm().height;
+	Film& film = camera->getFilm();
+	film.resetPixels();
+
+	// Clip requested range to the film
+	Bounds2i pixelRange(Point2i(std::max(mPixelRange.pMin.x, 0),
+								std::max(mPixelRange.pMin.y, 0)),
+						Point2i(std::min(mPixelRange.pMax.x, static_cast<int32_t>(film.width)),
+								std::min(mPixelRange.pMax.y, static_cast<int32_t>(film.height))));
+	Vector2i extent = pixelRange.diagnal();
+	if (extent.x <= 0 || extent.y <= 0)
+	{
+		return;
+	}
+
+	int32_t tileCountX = (extent.x + sTileSize - 1) / sTileSize;
+	int32_t tileCountY = (extent.y + sTileSize - 1) / sTileSize;
+
+	parallelFor(0, static_cast<size_t>(tileCountX * tileCountY), [&](size_t tileIndex)
+	{
+		int32_t tileX = static_cast<int32_t>(tileIndex) % tileCountX;
+		int32_t tileY = static_cast<int32_t>(tileIndex) / tileCountX;
+		Point2i tileMin(pixelRange.pMin.x + tileX * sTileSize,
+						pixelRange.pMin.y + tileY * sTileSize);
+		Point2i tileMax(std::min(tileMin.x + sTileSize, pixelRange.pMax.x),
+						std::min(tileMin.y + sTileSize, pixelRange.pMax.y));
+
+		FilmTile tile(Bounds2i(tileMin, tileMax));
+		renderTile(scene, *camera, tile);
+		film.mergeTile(tile);
+	});
+}
+
+Spectrum SampleIntegrator::evalLi(Ray &ray, const Scene &scene, Sampler &sampler, uint32_t rayDepth)
+{
+	Intersection isec;
+	bool isHit = scene.intersect(ray, &isec);
+	return evalHitLi(ray, isHit ? &isec : nullptr, scene, sampler, rayDepth);
+}
+
+void SampleIntegrator::renderTile(const Scene &scene, const Camera &camera, FilmTile &tile)
+{
+	std::unique_ptr<Sampler> sampler = mSampler.clone();
+	uint32_t sampleCount = sampler->getSamplesPerPixel();
+	const Bounds2i &bounds = tile.mPixelBounds;
 
 	Ray ray;
-	uint32_t sampleCount = 2;
-	std::vector<Spectrum> img(width * height);
-	for (uint32_t i = 0; i < width; ++i)
+	RayBatch rays(tile.mPixels.size());
+	HitBatch hits(tile.mPixels.size());
+	for (uint32_t k = 0; k < sampleCount; ++k)
 	{
-		for (uint32_t j = 0; j < height; ++j)
+		rays.clear();
+		for (int32_t y = bounds.pMin.y; y < bounds.pMax.y; ++y)
 		{
-			for (uint32_t k = 0; k < sampleCount * sampleCount; ++k)
+			for (int32_t x = bounds.pMin.x; x < bounds.pMax.x; ++x)
 			{
-				CameraSample sample{ mSampler.generate2D(),
-									 mSampler.generate2D(),
-									 mSampler.generate1D() };
-				camera->generateRay(sample, &ray);
-				Spectrum L(0.f);
-				L = evalLi(ray, scene, mSampler, 0);
-				img[i + j * height] += L;
+				Point2i pixel(x, y);
+				sampler->startPixelSample(pixel, k);
+				camera.generateRay(generateCameraSample(*sampler, pixel), &ray);
+				rays.push(ray);
 			}
 		}
+
+		scene.intersect(rays, hits);
+		shadeBatch(scene, rays, hits, k, *sampler, tile);
+	}
+}
+
+void SampleIntegrator::shadeBatch(const Scene &scene, const RayBatch &rays, const HitBatch &hits,
+								  uint32_t sampleIndex, Sampler &sampler, FilmTile &tile)
+{
+	const Bounds2i &bounds = tile.mPixelBounds;
+	Ray ray;
+	size_t rayIndex = 0;
+	for (int32_t y = bounds.pMin.y; y < bounds.pMax.y; ++y)
+	{
+		for (int32_t x = bounds.pMin.x; x < bounds.pMax.x; ++x)
+		{
+			Point2i pixel(x, y);
+			// Replay the camera dimensions so shading continues the same sequence
+			sampler.startPixelSample(pixel, sampleIndex);
+			generateCameraSample(sampler, pixel);
+
+			Intersection isec;
+			bool isHit = scene.resolveHit(rays, hits, rayIndex++, ray, &isec);
+			Spectrum L = evalHitLi(ray, isHit ? &isec : nullptr, scene, sampler, 0);
+			tile.addSample(pixel, L);
+		}
 	}
 }
 
-}
\ No newline at end of file
+CameraSample SampleIntegrator::generateCameraSample(Sampler &sampler, const Point2i &pixel) const
+{
+	Point2f jitter = sampler.generate2D();
+	Point2f lens = sampler.generate2D();
+	Float time = sampler.generate1D();
+	return CameraSample{ Point2f(pixel.x + jitter.x, pixel.y + jitter.y), lens, time };
+}
+
+}
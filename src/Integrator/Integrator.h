@@ -10,6 +10,11 @@ namespace Kaguya
 {
 
 class Scene;
+class Camera;
+class Intersection;
+class RayBatch;
+class HitBatch;
+struct FilmTile;
 
 class Integrator
 {
@@ -26,13 +31,32 @@ public:
 		: mPixelRange(pixelRange)
 		, mSampler(sampler)
 	{}
+	// Image is split into tiles rendered in parallel,
+	// evalLi may be called concurrently from worker threads.
 	void render(const Scene &scene) override;
 	virtual void preprocess(const Scene &/*scene*/, Sampler &/*sampler*/) {}
-	virtual Spectrum evalLi(Ray &ray, const Scene &scene, const Sampler &sampler, uint32_t rayDepth = 0) = 0;
+	// Trace the ray and evaluate the radiance arriving along it
+	virtual Spectrum evalLi(Ray &ray, const Scene &scene, Sampler &sampler, uint32_t rayDepth = 0);
+	// Radiance along a ray whose closest hit is already known,
+	// isec is nullptr if the ray left the scene
+	virtual Spectrum evalHitLi(Ray &ray, const Intersection* isec,
+							   const Scene &scene, Sampler &sampler, uint32_t rayDepth) = 0;
 
 protected:
+	// Camera rays of a tile are traced as one batch per sample index
+	void renderTile(const Scene &scene, const Camera &camera, FilmTile &tile);
+	// Shade one traced batch into the tile, pixels come in the order their
+	// camera rays were generated. Calls evalHitLi on every ray by default.
+	virtual void shadeBatch(const Scene &scene, const RayBatch &rays, const HitBatch &hits,
+							uint32_t sampleIndex, Sampler &sampler, FilmTile &tile);
+	CameraSample generateCameraSample(Sampler &sampler, const Point2i &pixel) const;
+
+	// Tile edge in pixels, a 16x16 tile of Spectrum stays in L1 cache
+	static const int32_t sTileSize = 16;
+
 	Bounds2i mPixelRange;
 	// Sampler is used to sample on image plane or light.
+	// Each tile renders with its own clone of it.
 	Sampler& mSampler;
 };
 
@@ -5,11 +5,32 @@
 #include "WhittedIntegrator.h"
 #include "Core/Scene.h"
 #include "Geometry/Intersection.h"
+#include "Camera/Film.h"
+#include "Tracer/RayBatch.h"
 
 namespace Kaguya
 {
 
 
+// Direct light from one light sample, false when the light adds nothing.
+// The radiance only counts if shadowRay is unoccluded
+static bool sampleLight(const Light &light, const Intersection &isec, Float time,
+						Sampler &sampler, Ray &shadowRay, Spectrum &L)
+{
+	Vector3f wi;
+	Float lightDist;
+	Spectrum lightSpec = light.evalLi(wi, lightDist, isec, sampler.generate2D());
+	if (lightSpec.isBlack())
+	{
+		return false;
+	}
+
+	shadowRay = Ray(isec.mPos, wi, sRayEpsilon, lightDist * (1 - sRayEpsilon));
+	shadowRay.time = time;
+	L = lightSpec * std::abs(dot(wi, normalize(isec.mGeomN)));
+	return true;
+}
+
 WhittedIntegrator::WhittedIntegrator(uint32_t maxDepth,
                                      const Bounds2i &pixelRange,
                                      Sampler &sampler)
@@ -18,11 +39,10 @@ WhittedIntegrator::WhittedIntegrator(uint32_t maxDepth,
 {
 }
 
-Spectrum WhittedIntegrator::evalLi(Ray &ray, const Scene &scene, const Sampler &sampler, uint32_t rayDepth)
+Spectrum WhittedIntegrator::evalHitLi(Ray &ray, const Intersection* isec,
+									 const Scene &scene, Sampler &sampler, uint32_t rayDepth)
 {
-	Intersection isect;
-
-	if (!scene.intersect(ray, &isect))
+	if (isec == nullptr)
 	{
 		// If no intersection, get radiance directly from light
 		Spectrum lightSpec(0.f);
@@ -34,12 +54,17 @@ Spectrum WhittedIntegrator::evalLi(Ray &ray, const Scene &scene, const Sampler &
 		return lightSpec;
 	}
 
+	Spectrum L(0.f);
 	for (auto &light : scene.getLights())
 	{
-		// Test ray isect->light visibility
-
+		Ray shadowRay;
+		Spectrum lightL;
 		// accumulate radiance if visible
-		Spectrum lightSpec = light->evalLi(ray.d, isect, sampler.generate2D());
+		if (sampleLight(*light, *isec, ray.time, sampler, shadowRay, lightL)
+			&& !scene.occluded(shadowRay))
+		{
+			L += lightL;
+		}
 	}
 
 	if (rayDepth < mMaxDepth)
@@ -49,7 +74,74 @@ Spectrum WhittedIntegrator::evalLi(Ray &ray, const Scene &scene, const Sampler &
 		// If specular transmit
 		//     Trace transmission
 	}
-	return Kaguya::Spectrum();
+	return L;
+}
+
+void WhittedIntegrator::shadeBatch(const Scene &scene, const RayBatch &rays, const HitBatch &hits,
+								   uint32_t sampleIndex, Sampler &sampler, FilmTile &tile)
+{
+	const Bounds2i &bounds = tile.mPixelBounds;
+	std::vector<Spectrum> pixelL(rays.size(), Spectrum(0.f));
+	// Radiance each shadow ray adds to its pixel when unoccluded
+	size_t shadowCapacity = rays.size() * scene.getLights().size();
+	RayBatch shadowRays(shadowCapacity);
+	std::vector<Spectrum> shadowL;
+	std::vector<size_t> shadowPixels;
+	shadowL.reserve(shadowCapacity);
+	shadowPixels.reserve(shadowCapacity);
+
+	Ray ray;
+	size_t rayIndex = 0;
+	for (int32_t y = bounds.pMin.y; y < bounds.pMax.y; ++y)
+	{
+		for (int32_t x = bounds.pMin.x; x < bounds.pMax.x; ++x, ++rayIndex)
+		{
+			Point2i pixel(x, y);
+			// Replay the camera dimensions so shading continues the same sequence
+			sampler.startPixelSample(pixel, sampleIndex);
+			generateCameraSample(sampler, pixel);
+
+			Intersection isec;
+			if (!scene.resolveHit(rays, hits, rayIndex, ray, &isec))
+			{
+				pixelL[rayIndex] = evalHitLi(ray, nullptr, scene, sampler, 0);
+				continue;
+			}
+
+			for (auto &light : scene.getLights())
+			{
+				Ray shadowRay;
+				Spectrum lightL;
+				if (sampleLight(*light, isec, ray.time, sampler, shadowRay, lightL))
+				{
+					shadowRays.push(shadowRay);
+					shadowL.push_back(lightL);
+					shadowPixels.push_back(rayIndex);
+				}
+			}
+		}
+	}
+
+	if (!shadowRays.empty())
+	{
+		scene.occluded(shadowRays);
+	}
+	for (size_t i = 0; i < shadowRays.size(); ++i)
+	{
+		if (!shadowRays.isOccluded(i))
+		{
+			pixelL[shadowPixels[i]] += shadowL[i];
+		}
+	}
+
+	rayIndex = 0;
+	for (int32_t y = bounds.pMin.y; y < bounds.pMax.y; ++y)
+	{
+		for (int32_t x = bounds.pMin.x; x < bounds.pMax.x; ++x)
+		{
+			tile.addSample(Point2i(x, y), pixelL[rayIndex++]);
+		}
+	}
 }
 
 }
\ No newline at end of file
@@ -12,7 +12,15 @@ public:
 	                  const Bounds2i &pixelRange,
 	                  Sampler &sampler);
 
-	Spectrum evalLi(Ray &ray, const Scene &scene, const Sampler &sampler, uint32_t rayDepth) override;
+	Spectrum evalHitLi(Ray &ray, const Intersection* isec,
+					   const Scene &scene, Sampler &sampler, uint32_t rayDepth) override;
+
+protected:
+	// Light samples of the whole batch are taken first,
+	// then their shadow rays are traced as one stream
+	void shadeBatch(const Scene &scene, const RayBatch &rays, const HitBatch &hits,
+					uint32_t sampleIndex, Sampler &sampler, FilmTile &tile) override;
+
 private:
 	uint32_t mMaxDepth;
 };
@@ -20,6 +20,7 @@ AreaLight::~AreaLight()
 }
 
 Spectrum AreaLight::evalLi(Vector3f &/*retWi*/,
+						   Float &/*retDist*/,
 						   const Intersection &/*isec*/,
 						   const Point2f &/*u*/) const
 {
@@ -15,6 +15,7 @@ public:
 
 	// Evaluate incident radiance arriving at a given point
 	Spectrum evalLi(Vector3f &retWi,
+					Float &retDist,
 					const Intersection &isec,
 					const Point2f &u) const override;
 
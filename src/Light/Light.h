@@ -23,8 +23,10 @@ public:
 
 	bool isDeltaLight() const;
 
-	// Evaluate incident radiance arriving at a given point
+	// Evaluate incident radiance arriving at a given point,
+	// retDist is the distance to the light along retWi for shadow rays
 	virtual Spectrum evalLi(Vector3f &retWi,
+							Float &retDist,
 							const Intersection &isec,
 							const Point2f &u) const = 0;
 
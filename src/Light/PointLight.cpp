@@ -15,12 +15,14 @@ PointLight::~PointLight()
 }
 
 Spectrum PointLight::evalLi(Vector3f &retWi,
+							Float &retDist,
 							const Intersection &isec,
 							const Point2f &) const
 {
 	retWi = mPosition - isec.mPos;
 	Float dist = retWi.lengthSquared();
-	retWi /= std::sqrt(dist);
+	retDist = std::sqrt(dist);
+	retWi /= retDist;
 
 	return mIntensity / dist;
 }
@@ -11,6 +11,7 @@ public:
 	~PointLight();
 
 	Spectrum evalLi(Vector3f &retWi,
+					Float &retDist,
 					const Intersection &isec,
 					const Point2f &u) const override;
 
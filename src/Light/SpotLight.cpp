@@ -19,12 +19,14 @@ SpotLight::~SpotLight()
 }
 
 Spectrum SpotLight::evalLi(Vector3f &retWi,
+						   Float &retDist,
 						   const Intersection &isec,
 						   const Point2f &/*u*/) const
 {
 	retWi = mPosistion - isec.mPos;
 	double distSq = retWi.lengthSquared();
-	retWi /= std::sqrt(distSq);
+	retDist = std::sqrt(distSq);
+	retWi /= retDist;
 
 	return mIntensity * falloff(-retWi) / distSq;
 }
@@ -13,6 +13,7 @@ public:
 
 	// Evaluate incident radiance arriving at a given point
 	Spectrum evalLi(Vector3f &retWi,
+					Float &retDist,
 					const Intersection &isec,
 					const Point2f &u) const override;
 
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Core/Kaguya.h"
+#include "Math/RNG.h"
+
+namespace Kaguya
+{
+
+static const uint32_t sSobolDimensions = 4;
+static const uint32_t sSobolBits = 32;
+// Direction numbers of a 4D Sobol' set, most significant bit first
+extern const uint32_t sSobolMatrices[sSobolDimensions][sSobolBits];
+
+static const uint32_t sPrimeTableSize = 64;
+extern const uint32_t sPrimes[sPrimeTableSize];
+
+inline uint32_t reverseBits32(uint32_t n)
+{
+	n = (n << 16) | (n >> 16);
+	n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+	n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+	n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+	n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+	return n;
+}
+
+inline Float uint32ToUnitFloat(uint32_t v)
+{
+	return std::min(sOneMinusEpsilon, static_cast<Float>(v * 0x1p-32));
+}
+
+// Sobol' sample as 0.32 fixed point
+inline uint32_t sobolSample(uint32_t index, uint32_t dimension)
+{
+	uint32_t v = 0;
+	for (uint32_t i = 0; index != 0; index >>= 1, i++)
+	{
+		if (index & 1)
+		{
+			v ^= sSobolMatrices[dimension][i];
+		}
+	}
+	return v;
+}
+
+// Hash based base-2 Owen scrambling of a 0.32 fixed point value
+// Burley, Practical Hash-based Owen Scrambling, JCGT 2020
+inline uint32_t owenScramble(uint32_t v, uint32_t seed)
+{
+	v = reverseBits32(v);
+	// Laine-Karras permutation, each bit only depends on lower bits
+	v += seed;
+	v ^= v * 0x6c50b47cu;
+	v ^= v * 0xb82f1e52u;
+	v ^= v * 0xc7afe638u;
+	v ^= v * 0x8d22f6e6u;
+	return reverseBits32(v);
+}
+
+// i-th element of a random permutation of [0, l) selected by p
+// Kensler, Correlated Multi-Jittered Sampling, 2013
+inline uint32_t permutationElement(uint32_t i, uint32_t l, uint32_t p)
+{
+	uint32_t w = l - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do
+	{
+		i ^= p;
+		i *= 0xe170893d;
+		i ^= p >> 16;
+		i ^= (i & w) >> 4;
+		i ^= p >> 8;
+		i *= 0x0929eb3f;
+		i ^= p >> 23;
+		i ^= (i & w) >> 1;
+		i *= 1 | p >> 27;
+		i *= 0x6935fa69;
+		i ^= (i & w) >> 11;
+		i *= 0x74dcb303;
+		i ^= (i & w) >> 2;
+		i *= 0x9e501cc3;
+		i ^= (i & w) >> 2;
+		i *= 0xc860a3df;
+		i &= w;
+		i ^= i >> 5;
+	} while (i >= l);
+	return (i + p) % l;
+}
+
+// Radical inverse of index with an Owen scramble of its digits
+Float scrambledRadicalInverse(uint32_t baseIndex, uint64_t index, uint64_t seed);
+
+}
@@ -226,4 +226,82 @@ inline bool quadratic(Float A, Float B, Float C, Float &t1, Float &t2)
 	return true;
 }
 
+// Largest real root of t^3 + a * t^2 + b * t + c = 0
+inline double cubicMaxRoot(double a, double b, double c)
+{
+	double Q = (a * a - 3. * b) / 9.;
+	double R = (2. * a * a * a - 9. * a * b + 27. * c) / 54.;
+	if (R * R < Q * Q * Q)
+	{
+		// Three real roots, the first one is the largest
+		double theta = std::acos(R / std::sqrt(Q * Q * Q));
+		return -2. * std::sqrt(Q) * std::cos((theta + 2. * M_PI) / 3.) - a / 3.;
+	}
+	double S = -std::copysign(std::cbrt(std::abs(R) + std::sqrt(R * R - Q * Q * Q)), R);
+	return S + (S != 0 ? Q / S : 0) - a / 3.;
+}
+
+// Real roots of A * t^4 + B * t^3 + C * t^2 + D * t + E = 0 (Ferrari),
+// returns the root count. Roots are unsorted and polished with Newton steps
+inline int quartic(Float A, Float B, Float C, Float D, Float E, Float roots[4])
+{
+	// Depressed quartic y^4 + p * y^2 + q * y + r with t = y - a / 4
+	double a = B / A, b = C / A, c = D / A, d = E / A;
+	double aa = a * a;
+	double p = b - 0.375 * aa;
+	double q = c - 0.5 * a * b + 0.125 * aa * a;
+	double r = d - 0.25 * a * c + 0.0625 * aa * b - 0.01171875 * aa * aa;
+
+	double y[4];
+	int count = 0;
+	auto solveQuadratic = [&y, &count](double qb, double qc)
+	{
+		double discrim = qb * qb - 4. * qc;
+		if (discrim >= 0)
+		{
+			double rootDiscrim = std::sqrt(discrim);
+			y[count++] = 0.5 * (-qb - rootDiscrim);
+			y[count++] = 0.5 * (-qb + rootDiscrim);
+		}
+	};
+	if (std::abs(q) < 1e-12)
+	{
+		// Biquadratic, solve for y^2
+		double discrim = p * p - 4. * r;
+		if (discrim < 0) return 0;
+		double rootDiscrim = std::sqrt(discrim);
+		for (double z : { 0.5 * (-p - rootDiscrim), 0.5 * (-p + rootDiscrim) })
+		{
+			if (z >= 0)
+			{
+				y[count++] = -std::sqrt(z);
+				y[count++] = std::sqrt(z);
+			}
+		}
+	}
+	else
+	{
+		// Resolvent cubic, its positive root splits the quartic into two quadratics
+		double m = cubicMaxRoot(p, 0.25 * p * p - r, -0.125 * q * q);
+		if (m <= 0) return 0;
+		double s = std::sqrt(2. * m);
+		solveQuadratic(s, 0.5 * p + m - 0.5 * q / s);
+		solveQuadratic(-s, 0.5 * p + m + 0.5 * q / s);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		double t = y[i] - 0.25 * a;
+		for (int iter = 0; iter < 2; iter++)
+		{
+			double f = (((A * t + B) * t + C) * t + D) * t + E;
+			double df = ((4. * A * t + 3. * B) * t + 2. * C) * t + D;
+			if (df == 0) break;
+			t -= f / df;
+		}
+		roots[i] = static_cast<Float>(t);
+	}
+	return count;
+}
+
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Core/Kaguya.h"
+
+namespace Kaguya
+{
+
+#ifdef KAGUYA_DOUBLE_AS_FLOAT
+static const Float sOneMinusEpsilon = 0x1.fffffffffffffp-1;
+#else
+static const Float sOneMinusEpsilon = 0x1.fffffep-1f;
+#endif
+
+// 64-bit finalizer, good avalanche for seeding from small integers
+inline uint64_t mixBits(uint64_t v)
+{
+	v ^= (v >> 31);
+	v *= 0x7fb5d329728ea185ULL;
+	v ^= (v >> 27);
+	v *= 0x81dadef4bc2dd44dULL;
+	v ^= (v >> 33);
+	return v;
+}
+
+inline uint64_t hashValues(uint64_t a, uint64_t b, uint64_t c = 0)
+{
+	return mixBits(a ^ mixBits(b ^ mixBits(c)));
+}
+
+/************************************************************************/
+/* PCG32 random number generator                                        */
+/* O'Neill, PCG: A Family of Simple Fast Space-Efficient Statistically  */
+/* Good Algorithms for Random Number Generation                         */
+/************************************************************************/
+class RNG
+{
+public:
+	RNG() : mState(sDefaultState), mInc(sDefaultStream) {}
+	RNG(uint64_t seqIndex, uint64_t seed = 0)
+	{
+		setSequence(seqIndex, seed);
+	}
+
+	// Each sequence index selects an independent stream
+	void setSequence(uint64_t seqIndex, uint64_t seed = 0)
+	{
+		mState = 0u;
+		mInc = (seqIndex << 1u) | 1u;
+		uniformUInt32();
+		mState += seed;
+		uniformUInt32();
+	}
+
+	uint32_t uniformUInt32()
+	{
+		uint64_t oldState = mState;
+		mState = oldState * sMultiplier + mInc;
+		uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+		uint32_t rot = static_cast<uint32_t>(oldState >> 59u);
+		return (xorShifted >> rot) | (xorShifted << ((~rot + 1u) & 31));
+	}
+
+	// Uniform in [0, 1)
+	Float uniformFloat()
+	{
+		return std::min(sOneMinusEpsilon,
+						static_cast<Float>(uniformUInt32() * 0x1p-32));
+	}
+
+	// Jump ahead by delta steps in O(log(delta))
+	void advance(uint64_t delta)
+	{
+		uint64_t curMult = sMultiplier, curPlus = mInc;
+		uint64_t accMult = 1u, accPlus = 0u;
+		while (delta > 0)
+		{
+			if (delta & 1)
+			{
+				accMult *= curMult;
+				accPlus = accPlus * curMult + curPlus;
+			}
+			curPlus = (curMult + 1) * curPlus;
+			curMult *= curMult;
+			delta >>= 1;
+		}
+		mState = accMult * mState + accPlus;
+	}
+
+private:
+	static const uint64_t sDefaultState = 0x853c49e6748fea9bULL;
+	static const uint64_t sDefaultStream = 0xda3e39cb94b95bdbULL;
+	static const uint64_t sMultiplier = 0x5851f42d4c957f2dULL;
+
+	uint64_t mState;
+	uint64_t mInc;
+};
+
+}
@@ -48,9 +48,9 @@ Normal3f Transform::operator()(const Normal3f &n) const
 {
 	Float x = n.x, y = n.y, z = n.z;
 	return Normal3f(
-		mInv.mtx[0][0] * x + mInv.mtx[0][1] * x + mInv.mtx[0][2] * x,
-		mInv.mtx[1][0] * y + mInv.mtx[1][1] * y + mInv.mtx[1][2] * y,
-		mInv.mtx[2][0] * z + mInv.mtx[2][1] * z + mInv.mtx[2][2] * z);
+		mInv.mtx[0][0] * x + mInv.mtx[0][1] * y + mInv.mtx[0][2] * z,
+		mInv.mtx[1][0] * x + mInv.mtx[1][1] * y + mInv.mtx[1][2] * z,
+		mInv.mtx[2][0] * x + mInv.mtx[2][1] * y + mInv.mtx[2][2] * z);
 }
 
 Point3f Transform::invXform(const Point3f &p) const
@@ -66,9 +66,9 @@ Normal3f Transform::invXform(const Normal3f & n) const
 {
 	Float x = n.x, y = n.y, z = n.z;
 	return Normal3f(
-		m.mtx[0][0] * x + m.mtx[0][1] * x + m.mtx[0][2] * x,
-		m.mtx[1][0] * y + m.mtx[1][1] * y + m.mtx[1][2] * y,
-		m.mtx[2][0] * z + m.mtx[2][1] * z + m.mtx[2][2] * z);
+		m.mtx[0][0] * x + m.mtx[0][1] * y + m.mtx[0][2] * z,
+		m.mtx[1][0] * x + m.mtx[1][1] * y + m.mtx[1][2] * z,
+		m.mtx[2][0] * x + m.mtx[2][1] * y + m.mtx[2][2] * z);
 }
 
 Bounds3f Transform::invXform(const Bounds3f & bbox) const
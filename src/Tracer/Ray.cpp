@@ -13,10 +13,11 @@ Ray::Ray(const Point3f &pos, const Vector3f &dir,
 	, tMax(maxT)
 	, mask(sInvalidGeomID)
 	, mId(0)
-	, geomID(sInvalidGeomID)
+	, mFlags(0)
 	, primID(sInvalidGeomID)
-	, instID(sInvalidGeomID)
+	, geomID(sInvalidGeomID)
 {
+	std::fill(instID, instID + sMaxInstanceLevel, sInvalidGeomID);
 }
 
 Point3f Ray::operator()(Float t) const
@@ -9,9 +9,16 @@
 #include "Math/MathUtil.h"
 #include "Math/Vector.h"
 
+#include <embree3/rtcore_common.h>
+
 namespace Kaguya
 {
 
+// Offset of secondary rays from the surface they leave
+static const Float sRayEpsilon = 1e-4f;
+// Depth of the instance stack recorded per hit
+static const uint32_t sMaxInstanceLevel = RTC_MAX_INSTANCE_LEVEL_COUNT;
+
 class Ray
 {
 public:
@@ -45,12 +52,13 @@ public:
 	mutable Float u;
 	mutable Float v;
 
-	// Geometry ID
-	uint32_t geomID;
+	// Hit IDs, same order as RTCHit
 	// Primitive ID
 	uint32_t primID;
-	// Instance ID
-	uint32_t instID;
+	// Geometry ID
+	uint32_t geomID;
+	// Instance IDs from top level scene down
+	uint32_t instID[sMaxInstanceLevel];
 };
 
 }
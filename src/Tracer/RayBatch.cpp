@@ -0,0 +1,125 @@
+#include "Tracer/RayBatch.h"
+
+namespace Kaguya
+{
+
+RayBatch::RayBatch(size_t capacity)
+	: mSize(0)
+{
+	reserve(capacity);
+}
+
+void RayBatch::reserve(size_t capacity)
+{
+	for (auto buffer : { &orgX, &orgY, &orgZ, &tNear,
+						 &dirX, &dirY, &dirZ, &time, &tFar })
+	{
+		buffer->reserve(capacity);
+	}
+	for (auto buffer : { &mask, &id, &flags })
+	{
+		buffer->reserve(capacity);
+	}
+}
+
+void RayBatch::clear()
+{
+	for (auto buffer : { &orgX, &orgY, &orgZ, &tNear,
+						 &dirX, &dirY, &dirZ, &time, &tFar })
+	{
+		buffer->clear();
+	}
+	for (auto buffer : { &mask, &id, &flags })
+	{
+		buffer->clear();
+	}
+	mSize = 0;
+}
+
+size_t RayBatch::push(const Ray &ray)
+{
+	orgX.push_back(static_cast<float>(ray.o.x));
+	orgY.push_back(static_cast<float>(ray.o.y));
+	orgZ.push_back(static_cast<float>(ray.o.z));
+	tNear.push_back(static_cast<float>(ray.tMin));
+	dirX.push_back(static_cast<float>(ray.d.x));
+	dirY.push_back(static_cast<float>(ray.d.y));
+	dirZ.push_back(static_cast<float>(ray.d.z));
+	time.push_back(static_cast<float>(ray.time));
+	tFar.push_back(static_cast<float>(ray.tMax));
+	mask.push_back(ray.mask);
+	id.push_back(static_cast<uint32_t>(mSize));
+	flags.push_back(0);
+	return mSize++;
+}
+
+void RayBatch::setRay(size_t index, const Ray &ray)
+{
+	orgX[index] = static_cast<float>(ray.o.x);
+	orgY[index] = static_cast<float>(ray.o.y);
+	orgZ[index] = static_cast<float>(ray.o.z);
+	tNear[index] = static_cast<float>(ray.tMin);
+	dirX[index] = static_cast<float>(ray.d.x);
+	dirY[index] = static_cast<float>(ray.d.y);
+	dirZ[index] = static_cast<float>(ray.d.z);
+	time[index] = static_cast<float>(ray.time);
+	tFar[index] = static_cast<float>(ray.tMax);
+	mask[index] = ray.mask;
+}
+
+Ray RayBatch::getRay(size_t index) const
+{
+	Ray ray(Point3f(orgX[index], orgY[index], orgZ[index]),
+			Vector3f(dirX[index], dirY[index], dirZ[index]),
+			tNear[index], tFar[index]);
+	ray.time = time[index];
+	ray.mask = mask[index];
+	return ray;
+}
+
+HitBatch::HitBatch(size_t capacity)
+{
+	for (auto buffer : { &NgX, &NgY, &NgZ, &u, &v })
+	{
+		buffer->reserve(capacity);
+	}
+	for (auto buffer : { &primID, &geomID })
+	{
+		buffer->reserve(capacity);
+	}
+	for (auto &buffer : instID)
+	{
+		buffer.reserve(capacity);
+	}
+}
+
+void HitBatch::reset(size_t count)
+{
+	for (auto buffer : { &NgX, &NgY, &NgZ, &u, &v })
+	{
+		buffer->assign(count, 0.f);
+	}
+	for (auto buffer : { &primID, &geomID })
+	{
+		buffer->assign(count, sInvalidID);
+	}
+	for (auto &buffer : instID)
+	{
+		buffer.assign(count, sInvalidID);
+	}
+}
+
+void HitBatch::fillRay(size_t index, Ray &ray) const
+{
+	ray.Ng = Normal3f(NgX[index], NgY[index], NgZ[index]);
+	ray.u = u[index];
+	ray.v = v[index];
+	ray.geomID = geomID[index];
+	ray.primID = primID[index];
+	for (uint32_t level = 0; level < sMaxInstanceLevel; level++)
+	{
+		ray.instID[level] = instID[level][index];
+	}
+}
+
+}
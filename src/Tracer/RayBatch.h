@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Tracer/Ray.h"
+
+namespace Kaguya
+{
+
+// Structure of arrays storage for a stream of rays.
+// Always single precision, so it can be handed to Embree as is.
+class RayBatch
+{
+public:
+	RayBatch(size_t capacity = 0);
+
+	void reserve(size_t capacity);
+	void clear();
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+
+	// Append a ray and return its index in the batch
+	size_t push(const Ray &ray);
+	void setRay(size_t index, const Ray &ray);
+	Ray getRay(size_t index) const;
+
+	// Set by Scene::occluded, Embree writes -inf to tFar of blocked rays
+	bool isOccluded(size_t index) const
+	{
+		return tFar[index] < 0;
+	}
+
+public:
+	floats_t orgX, orgY, orgZ, tNear;
+	floats_t dirX, dirY, dirZ, time;
+	floats_t tFar;
+	ui32s_t  mask, id, flags;
+
+private:
+	size_t   mSize;
+};
+
+// Closest hit record of every ray in a RayBatch
+class HitBatch
+{
+public:
+	HitBatch(size_t capacity = 0);
+
+	// Resize to match the ray batch, all hits reset to invalid
+	void reset(size_t count);
+	size_t size() const { return geomID.size(); }
+
+	bool isHit(size_t index) const
+	{
+		return geomID[index] != sInvalidID;
+	}
+	// Copy hit record into the ray (Ng, u, v and ids)
+	void fillRay(size_t index, Ray &ray) const;
+
+public:
+	floats_t NgX, NgY, NgZ;
+	floats_t u, v;
+	ui32s_t  primID, geomID;
+	ui32s_t  instID[sMaxInstanceLevel];
+
+	static const uint32_t sInvalidID = (uint32_t)(-1);
+};
+
+}
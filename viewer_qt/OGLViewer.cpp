@@ -175,6 +175,10 @@ void OGLViewer::paintGL()
 
 	for (auto &rbo : mRBOs)
 	{
+		if (!rbo.visible)
+		{
+			continue;
+		}
 		rbo.vao->bind();
 		rbo.shader->bind();
 		// Apply uniform matrix
@@ -206,6 +210,37 @@ void OGLViewer::resizeGL(int w, int h)
 /* Application Functions                                                */
 /************************************************************************/
 
+void OGLViewer::transformPrimitive(uint32_t geomID, const Transform &xform)
+{
+	if (!mScene || geomID >= mRBOs.size()
+		|| !mScene->transformPrimitive(geomID, xform))
+	{
+		return;
+	}
+	mScene->commitScene();
+
+	// Mesh vertices moved in place, refresh the GPU copy
+	RenderBufferTrait trait = mScene->getRenderBuffer(geomID);
+	makeCurrent();
+	mRBOs[geomID].vbo->bind();
+	mRBOs[geomID].vbo->write(0, trait.vertex.data, trait.vertex.size);
+	mRBOs[geomID].vbo->release();
+	doneCurrent();
+	update();
+}
+
+void OGLViewer::setPrimitiveVisible(uint32_t geomID, bool visible)
+{
+	if (!mScene || geomID >= mRBOs.size())
+	{
+		return;
+	}
+	mScene->setPrimitiveEnabled(geomID, visible);
+	mScene->commitScene();
+	mRBOs[geomID].visible = visible;
+	update();
+}
+
 void OGLViewer::saveFrameBuffer()
 {
 	QString filename = QFileDialog::getSaveFileName(
@@ -229,36 +264,26 @@ void OGLViewer::renderPixels()
 	QImage retImg(default_resX, default_resY, QImage::Format_ARGB32);
 
 	Point3f lightpos(3, 10, 1);
-	Float cosVal;
 	Intersection isec;
+	RayBatch rowRays(default_resX);
+	HitBatch rowHits(default_resX);
 	mRenderBuffer->cleanBuffer();
 	for (int j = 0; j < default_resY; j++)
 	{
+		// Trace a whole scanline as one coherent ray stream
+		rowRays.clear();
 		for (int i = 0; i < default_resX; i++)
 		{
 			camsmp.mFilm = Point2f(i, j);
-
 			view_cam->generateRay(camsmp, &traceRay);
+			rowRays.push(traceRay);
+		}
+		mScene->intersect(rowRays, rowHits);
 
-			cosVal = 0;
-			Point2f n(0, 0);
-			if (mScene->intersect(traceRay, &isec))
+		for (int i = 0; i < default_resX; i++)
+		{
+			if (mScene->resolveHit(rowRays, rowHits, i, traceRay, &isec))
 			{
-				/*cosVal = tHit;
-				isec.shape->postIntersect(traceRay, &isec);
-				cosVal = (dot(normalize(lightpos - isec.P), isec.Ng) + 1) * 0.5;
-				pixmap->setBuffer(uint32_t(i), uint32_t(j), isec, tHit);
-				size_t index = (j * width() + i) << 2;
-				pixmap->beauty[index++] = cosVal;
-				pixmap->beauty[index++] = cosVal;
-				pixmap->beauty[index++] = cosVal;
-				pixmap->beauty[index++] = cosVal;
-
-				pixmap->setBuffer()
-				pixmap->empty();
-				pixmap->setBuffer(0);
-				pixmap->doSomething();
-				*/
 				mRenderBuffer->setBuffer(i, j, isec, traceRay.tMax);
 				traceRay.Ng.normalize();
 				int rgb[]{ static_cast<int>((traceRay.Ng.x*0.5f + 0.5f) * 255),
@@ -266,7 +291,6 @@ void OGLViewer::renderPixels()
 					static_cast<int>((traceRay.Ng.z*0.5f + 0.5f) * 255) };
 				retImg.setPixelColor(i, default_resY - j - 1,
 									 QColor(rgb[0], rgb[1], rgb[2]));
-
 			}
 		}
 		progBar.print(j / float(default_resY));
@@ -34,6 +34,7 @@ struct RenderBufferObject
 	std::unique_ptr<QOpenGLVertexArrayObject> vao = std::make_unique<QOpenGLVertexArrayObject>();
 	uint32_t indexCount, patchSize;
 	GLenum        primMode;
+	bool          visible = true;
 };
 
 class OGLViewer : public QOpenGLWidget, public QtGLFunctions
@@ -45,6 +46,10 @@ public:
 
 	void renderPixels();
 
+	// Edit one primitive without reloading the scene
+	void transformPrimitive(uint32_t geomID, const Transform &xform);
+	void setPrimitiveVisible(uint32_t geomID, bool visible);
+
 protected:
 	void initializeGL() override;
 	void paintGL() override;